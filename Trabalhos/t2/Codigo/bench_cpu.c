@@ -0,0 +1,171 @@
+// bench_cpu.c
+// medida da velocidade da CPU (instruções por segundo)
+// simulador de computador
+// so24b
+
+// cada programa é executado em modo usuário, sem o SO de verdade: um SO
+//   mínimo (a função de CHAMAC) responde às chamadas de leitura e escrita, e
+//   recomeça o programa do início quando ele termina (ou morre ou pede
+//   qualquer outra coisa ao SO), até completar o número de instruções pedido
+// o programa fica numa tabela de páginas que mapeia a memória inteira a partir
+//   do primeiro quadro depois do tratador de interrupção
+//
+// uso: bench_cpu [-1] [-f] n_instrucoes programa.maq ...
+//   -1  executa uma instrução por chamada (cpu_executa_1), em vez de rajadas
+//       (cpu_executa_n, como o controlador)
+//   -f  liga a fusão de instruções na CPU
+// compilado com -DBENCH_ANTIGO, usa só o que existe na versão da CPU de antes
+//   do cache de instruções (sem rajadas, sem fusão, sem aviso de escrita na
+//   memória), para comparar com ela (ver o alvo bench no Makefile)
+
+#include "cpu.h"
+#include "es.h"
+#include "irq.h"
+#include "memoria.h"
+#include "mmu.h"
+#include "programa.h"
+#include "tabpag.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MEM_TAM 2000
+// chamadas de sistema atendidas pelo SO mínimo (as mesmas de so.h)
+#define SO_LE 1
+#define SO_ESCR 2
+// valor lido pelo programa, em toda leitura
+#define DADO_LIDO '5'
+
+static mem_t *mem;
+// vezes que o programa foi recomeçado
+static long reinicios;
+
+// recomeça a execução do programa, no endereço 0 (o início da tabela de páginas)
+static void recomeca(void)
+{
+  reinicios++;
+  mem_escreve(mem, IRQ_END_PC, 0);
+  mem_escreve(mem, IRQ_END_A, 0);
+  mem_escreve(mem, IRQ_END_X, 0);
+}
+
+// o SO mínimo, chamado pela instrução CHAMAC do tratador de interrupção
+// retorna 0, para a CPU voltar a executar o programa
+static int so_minimo(void *arg, int irq)
+{
+  int a;
+  mem_le(mem, IRQ_END_A, &a);
+  if (irq == IRQ_SISTEMA && a == SO_LE) {
+    mem_escreve(mem, IRQ_END_A, DADO_LIDO);
+  } else if (irq == IRQ_SISTEMA && a == SO_ESCR) {
+    mem_escreve(mem, IRQ_END_A, 0);
+  } else if (irq == IRQ_SISTEMA || irq == IRQ_ERR_CPU) {
+    recomeca();
+  }
+  mem_escreve(mem, IRQ_END_erro, 0);
+  mem_escreve(mem, IRQ_END_modo, usuario);
+  return 0;
+}
+
+static bool carrega(char *nome, int base)
+{
+  programa_t *prog = prog_cria(nome);
+  if (prog == NULL) {
+    fprintf(stderr, "%s: não foi possível ler o programa\n", nome);
+    return false;
+  }
+  for (int end = prog_end_carga(prog); end < prog_end_carga(prog) + prog_tamanho(prog); end++) {
+    mem_escreve(mem, base + end, prog_dado(prog, end));
+  }
+  prog_destroi(prog);
+  return true;
+}
+
+// executa 'n' instruções do programa e imprime a velocidade
+static bool mede(char *nome, long n, bool uma_a_uma, bool funde)
+{
+  // o programa começa no primeiro quadro depois do tratador de interrupção
+  int primeiro_quadro = 100 / TAM_PAGINA + 1;
+  int base = primeiro_quadro * TAM_PAGINA;
+
+  mem = mem_cria(MEM_TAM);
+  mmu_t *mmu = mmu_cria(mem);
+  es_t *es = es_cria();
+  cpu_t *cpu = cpu_cria(mmu, es);
+#ifndef BENCH_ANTIGO
+  mem_define_observador(mem, cpu_invalida_decod, cpu);
+  cpu_define_fusao(cpu, funde);
+#endif
+  cpu_define_chamaC(cpu, so_minimo, NULL);
+  if (!carrega("trata_int.maq", 0) || !carrega(nome, base)) {
+    return false;
+  }
+  tabpag_t *tabpag = tabpag_cria();
+  for (int pagina = 0; primeiro_quadro + pagina < MEM_TAM / TAM_PAGINA; pagina++) {
+    tabpag_define_quadro(tabpag, pagina, primeiro_quadro + pagina);
+  }
+  mmu_define_tabpag(mmu, tabpag);
+  // a CPU foi criada com uma interrupção de reset; o tratador volta para o
+  //   programa
+  reinicios = -1;
+  recomeca();
+  mem_escreve(mem, IRQ_END_modo, usuario);
+
+  clock_t inicio = clock();
+  long executadas = 0;
+  while (executadas < n) {
+#ifdef BENCH_ANTIGO
+    (void)uma_a_uma;
+    cpu_executa_1(cpu);
+    executadas++;
+#else
+    if (uma_a_uma) {
+      cpu_executa_1(cpu);
+      executadas++;
+    } else {
+      int k = cpu_executa_n(cpu, n - executadas < 1000 ? n - executadas : 1000);
+      executadas += k > 0 ? k : 1;
+    }
+#endif
+  }
+  double segundos = (double)(clock() - inicio) / CLOCKS_PER_SEC;
+  printf("%-8s %12.0f instruções/s  (%ld reinícios)\n", nome,
+         segundos > 0 ? n / segundos : 0.0, reinicios);
+
+  cpu_destroi(cpu);
+  tabpag_destroi(tabpag);
+  es_destroi(es);
+  mmu_destroi(mmu);
+  mem_destroi(mem);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  bool uma_a_uma = false;
+  bool funde = false;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; arg++) {
+    if (strcmp(argv[arg], "-1") == 0) {
+      uma_a_uma = true;
+    } else if (strcmp(argv[arg], "-f") == 0) {
+      funde = true;
+    } else {
+      break;
+    }
+  }
+  if (argc - arg < 2 || atol(argv[arg]) <= 0) {
+    fprintf(stderr, "uso: %s [-1] [-f] n_instrucoes programa.maq ...\n", argv[0]);
+    return 1;
+  }
+  long n = atol(argv[arg]);
+  for (arg++; arg < argc; arg++) {
+    if (!mede(argv[arg], n, uma_a_uma, funde)) {
+      return 1;
+    }
+  }
+  return 0;
+}
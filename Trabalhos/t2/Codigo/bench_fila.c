@@ -0,0 +1,102 @@
+// bench_fila.c
+// medida do custo de um passo do escalonador por prioridade na fila de prontos
+// so24b
+
+// a fila começa com n processos; cada passo faz o que so_escalona_prioridade
+//   faz quando o quantum do processo corrente acaba: pega o primeiro da fila,
+//   atualiza a prioridade dele (com um tempo de execução sorteado, para as
+//   prioridades não ficarem todas iguais) e reposiciona ele na fila
+// além do tempo por passo, imprime um resumo da sequência de processos
+//   escolhidos, que tem que ser o mesmo nas duas versões da fila
+//
+// uso: bench_fila n_passos n_processos ...
+// compilado com -DBENCH_ANTIGO, usa a fila de antes do heap (ordenada a cada
+//   escalonamento), para comparar com ela (ver o alvo bench no Makefile)
+
+#include "console.h"
+#include "fila_processos.h"
+#include "processo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// o mesmo de so.c e processo.c
+#define QUANTUM_INICIAL 10
+
+// a fila e os processos falam com a console só para relatar erros
+int console_printf(char *fmt, ...)
+{
+    return 0;
+}
+
+static fila_processos_t *cria_fila(void)
+{
+#ifdef BENCH_ANTIGO
+    return fila_processos_cria();
+#else
+    return fila_processos_cria_prioridade();
+#endif
+}
+
+// um passo do escalonador: o primeiro da fila executou e volta para a fila
+static processo_t *passo(fila_processos_t *fila, int quantum_restante)
+{
+#ifdef BENCH_ANTIGO
+    fila_processos_ordena_prioridade(fila);
+    processo_t *processo = fila_processos_primeiro(fila);
+    processo_atualiza_prioridade(processo, quantum_restante);
+    fila_processos_deleta_processo(fila, processo);
+    fila_processos_insere(fila, processo);
+#else
+    processo_t *processo = fila_processos_primeiro(fila);
+    processo_atualiza_prioridade(processo, quantum_restante);
+    fila_processos_atualiza_prioridade(fila, processo);
+#endif
+    return processo;
+}
+
+static void mede(long n_passos, int n_processos)
+{
+    fila_processos_t *fila = cria_fila();
+    processo_t **processos = malloc(n_processos * sizeof(processo_t *));
+    for (int i = 0; i < n_processos; i++) {
+        processos[i] = processo_cria(i + 1, 0);
+        fila_processos_insere(fila, processos[i]);
+    }
+
+    // sempre a mesma sequência de sorteios, nas duas versões
+    srand(1);
+    unsigned long resumo = 0;
+    clock_t inicio = clock();
+    for (long i = 0; i < n_passos; i++) {
+        processo_t *processo = passo(fila, rand() % (QUANTUM_INICIAL + 1));
+        resumo = resumo * 31 + processo_get_pid(processo);
+    }
+    double segundos = (double)(clock() - inicio) / CLOCKS_PER_SEC;
+    printf("n=%-5d %10.1f ns/passo  (sequência %016lx)\n", n_processos,
+           segundos * 1e9 / n_passos, resumo);
+
+    fila_processos_destroi(fila);
+    for (int i = 0; i < n_processos; i++) {
+        processo_destroi(processos[i]);
+    }
+    free(processos);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || atol(argv[1]) <= 0) {
+        fprintf(stderr, "uso: %s n_passos n_processos ...\n", argv[0]);
+        return 1;
+    }
+    long n_passos = atol(argv[1]);
+    for (int arg = 2; arg < argc; arg++) {
+        int n_processos = atoi(argv[arg]);
+        if (n_processos <= 0) {
+            fprintf(stderr, "%s: número de processos inválido\n", argv[arg]);
+            return 1;
+        }
+        mede(n_passos, n_processos);
+    }
+    return 0;
+}
@@ -6,6 +6,8 @@
 // INCLUDES {{{1
 
 #include "console.h"
+#include "instantaneo.h"
+#include "registro.h"
 #include "tela.h"
 #include "terminal.h"
 
@@ -51,16 +53,48 @@ struct console_t
     char txt_entrada[N_COL + 1];
     char fila_de_comandos_externos[N_CMD_EXT];
     FILE *arquivo_de_log;
+    // modo lote (sem tela), com a E/S dos terminais em arquivos
+    bool sem_tela;
+    FILE *arq_entrada[N_TERM];
+    FILE *arq_saida[N_TERM];
+    // grava ou reproduz o que chega de fora (comandos e entrada dos terminais)
+    registro_t *registro;
 };
 
 // CRIAÇÃO {{{1
 
 static console_t *console_global; // gambiarra para simplificar o uso de prints na console
-console_t *console_cria(void)
+
+// abre os arquivos de entrada e saída dos terminais, para o modo sem tela
+static void abre_arquivos_dos_terminais(console_t *self)
+{
+    for (int t = 0; t < N_TERM; t++) {
+        char nome[30];
+        sprintf(nome, "terminal_%c.entrada", 'A' + t);
+        // a entrada é opcional, o terminal fica sem nada digitado se não existir
+        self->arq_entrada[t] = fopen(nome, "r");
+        sprintf(nome, "terminal_%c.saida", 'A' + t);
+        self->arq_saida[t] = fopen(nome, "w");
+        terminal_define_arq_saida(self->term[t], self->arq_saida[t]);
+    }
+}
+
+static void fecha_arquivos_dos_terminais(console_t *self)
+{
+    for (int t = 0; t < N_TERM; t++) {
+        if (self->arq_entrada[t] != NULL)
+            fclose(self->arq_entrada[t]);
+        if (self->arq_saida[t] != NULL)
+            fclose(self->arq_saida[t]);
+    }
+}
+
+console_t *console_cria(bool sem_tela)
 {
     console_t *self = malloc(sizeof(*self));
     assert(self != NULL);
     console_global = self;
+    self->sem_tela = sem_tela;
 
     for (int t = 0; t < N_TERM; t++) {
         self->term[t] = terminal_cria(N_COL);
@@ -78,8 +112,13 @@ console_t *console_cria(void)
     strcpy(self->txt_entrada, "");
     self->fila_de_comandos_externos[0] = '\0';
     self->arquivo_de_log = fopen("log_da_console", "w");
+    self->registro = NULL;
 
-    tela_init();
+    if (sem_tela) {
+        abre_arquivos_dos_terminais(self);
+    } else {
+        tela_init();
+    }
 
     return self;
 }
@@ -88,6 +127,16 @@ static void console_desenha(console_t *self);
 
 void console_destroi(console_t *self)
 {
+    if (self->sem_tela) {
+        if (self->arquivo_de_log != NULL)
+            fclose(self->arquivo_de_log);
+        fecha_arquivos_dos_terminais(self);
+        for (int t = 0; t < N_TERM; t++) {
+            terminal_destroi(self->term[t]);
+        }
+        free(self);
+        return;
+    }
     console_desenha(self);
     if (self->arquivo_de_log != NULL)
         fclose(self->arquivo_de_log);
@@ -115,10 +164,21 @@ terminal_t *console_terminal(console_t *self, char id_terminal)
     return self->term[num_terminal];
 }
 
-static void atualiza_terminais(console_t *self)
+void console_define_registro(console_t *self, registro_t *registro)
+{
+    self->registro = registro;
+}
+
+// na reprodução, o que chega de fora vem só do registro
+static bool console_reproduzindo(console_t *self)
+{
+    return self->registro != NULL && registro_reproduzindo(self->registro);
+}
+
+static void atualiza_terminais(console_t *self, int n)
 {
     for (int t = 0; t < N_TERM; t++) {
-        terminal_tictac(self->term[t]);
+        terminal_tictac_n(self->term[t], n);
     }
 }
 
@@ -130,6 +190,8 @@ static void insere_string_no_terminal(console_t *self, char id_terminal, char *s
         console_printf("Terminal '%c' inválido\n", id_terminal);
         return;
     }
+    if (self->registro != NULL)
+        registro_grava_terminal(self->registro, id_terminal, str);
     char *p = str;
     while (*p != '\0') {
         terminal_insere_char(terminal, *p);
@@ -145,6 +207,8 @@ static void limpa_saida_do_terminal(console_t *self, char id_terminal)
         console_printf("Terminal '%c' inválido\n", id_terminal);
         return;
     }
+    if (self->registro != NULL)
+        registro_grava_limpeza(self->registro, id_terminal);
     terminal_limpa_saida(terminal);
 }
 
@@ -152,6 +216,13 @@ static void limpa_saida_do_terminal(console_t *self, char id_terminal)
 
 static void insere_string_na_console(console_t *self, char *s)
 {
+    if (self->sem_tela) {
+        // sem tela, só interessa o log
+        if (self->arquivo_de_log != NULL) {
+            fprintf(self->arquivo_de_log, "%s\n", s);
+        }
+        return;
+    }
     for (int l = 0; l < N_LIN_CONSOLE - 1; l++) {
         strncpy(self->txt_console[l], self->txt_console[l + 1], N_COL);
         self->txt_console[l][N_COL] = '\0'; // quem definiu strncpy é estúpido!
@@ -207,6 +278,8 @@ static void insere_comando_externo(console_t *self, char c)
     if (n_cmd < N_CMD_EXT - 2) {
         self->fila_de_comandos_externos[n_cmd] = c;
         self->fila_de_comandos_externos[n_cmd + 1] = '\0';
+        if (self->registro != NULL)
+            registro_grava_comando(self->registro, c);
     }
 }
 
@@ -278,12 +351,46 @@ static void verifica_entrada(console_t *self)
     } // senão, ignora o caractere digitado
 }
 
+// insere o que foi gravado para chegar até o instante atual
+static void reproduz_entradas(console_t *self)
+{
+    registro_evento_t *ev;
+    while ((ev = registro_proxima_entrada(self->registro)) != NULL) {
+        switch (ev->tipo) {
+        case EV_TERMINAL:
+            insere_string_no_terminal(self, ev->id, ev->texto);
+            break;
+        case EV_LIMPA:
+            limpa_saida_do_terminal(self, ev->id);
+            break;
+        case EV_ESPERA:
+            atualiza_terminais(self, ev->valor);
+            break;
+        case EV_COMANDO:
+            insere_comando_externo(self, ev->id);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 char console_comando_externo(console_t *self)
 {
-    verifica_entrada(self);
+    if (console_reproduzindo(self))
+        reproduz_entradas(self);
+    if (!self->sem_tela)
+        verifica_entrada(self);
     return remove_comando_externo(self);
 }
 
+int console_tempo_ate_entrada(console_t *self)
+{
+    if (!console_reproduzindo(self))
+        return -1;
+    return registro_tempo_ate_entrada(self->registro);
+}
+
 // DESENHO {{{1
 
 static void desenha_linha_terminal(char *txt, int linha, int cor_txt, int cor_cursor)
@@ -346,11 +453,154 @@ static void console_desenha(console_t *self)
 }
 
 // TICTAC {{{1
+
+// no modo sem tela, insere a próxima linha do arquivo de entrada de cada
+//   terminal que já consumiu tudo que tinha sido digitado
+static void alimenta_terminais(console_t *self)
+{
+    for (int t = 0; t < N_TERM; t++) {
+        FILE *arq = self->arq_entrada[t];
+        if (arq == NULL || terminal_txt_entrada(self->term[t])[0] != '\0')
+            continue;
+        char linha[N_COL + 1];
+        if (fgets(linha, sizeof(linha), arq) == NULL) {
+            fclose(arq);
+            self->arq_entrada[t] = NULL;
+            continue;
+        }
+        linha[strcspn(linha, "\n")] = '\0';
+        insere_string_no_terminal(self, 'A' + t, linha);
+    }
+}
+
+// true se algum terminal está rolando ou limpando a saída (e o tempo muda algo)
+static bool algum_terminal_ocupado(console_t *self)
+{
+    for (int t = 0; t < N_TERM; t++) {
+        int pronto;
+        terminal_leitura(self->term[t], 3, &pronto);
+        if (!pronto)
+            return true;
+    }
+    return false;
+}
+
 void console_tictac(console_t *self)
 {
-    verifica_entrada(self);
-    atualiza_terminais(self);
-    console_desenha(self);
+    // o tempo que passa com a simulação parada depende do operador, e é
+    //   gravado para que a reprodução deixe os terminais no mesmo estado
+    if (console_reproduzindo(self)) {
+        console_tictac_n(self, 0);
+        return;
+    }
+    if (self->registro != NULL && algum_terminal_ocupado(self))
+        registro_grava_espera(self->registro);
+    console_tictac_n(self, 1);
+}
+
+// o que chega de fora é inserido depois dos tics dos terminais, tanto na
+//   gravação quanto na reprodução
+void console_tictac_n(console_t *self, int n)
+{
+    atualiza_terminais(self, n);
+    if (console_reproduzindo(self)) {
+        reproduz_entradas(self);
+    } else if (self->sem_tela) {
+        alimenta_terminais(self);
+    }
+    if (!self->sem_tela) {
+        verifica_entrada(self);
+        console_desenha(self);
+    }
+}
+
+// INSTANTÂNEO {{{1
+
+// grava o que foi copiado até agora para o arquivo de saída do terminal 't'
+//   (nada, se não tem arquivo)
+static bool salva_saida_do_terminal(console_t *self, int t, FILE *arq)
+{
+    FILE *saida = self->sem_tela ? self->arq_saida[t] : NULL;
+    if (saida == NULL || fflush(saida) != 0)
+        return inst_escreve_int(arq, 0);
+    long tam = ftell(saida);
+    char nome[30];
+    sprintf(nome, "terminal_%c.saida", 'A' + t);
+    FILE *copia = fopen(nome, "r");
+    if (tam < 0 || copia == NULL) {
+        if (copia != NULL)
+            fclose(copia);
+        return false;
+    }
+    bool ok = inst_escreve_int(arq, tam);
+    char buf[1024];
+    while (ok && tam > 0) {
+        size_t n = tam < (long)sizeof(buf) ? tam : sizeof(buf);
+        ok = inst_le(copia, buf, n) && inst_escreve(arq, buf, n);
+        tam -= n;
+    }
+    fclose(copia);
+    return ok;
+}
+
+static bool restaura_saida_do_terminal(console_t *self, int t, FILE *arq)
+{
+    FILE *saida = self->sem_tela ? self->arq_saida[t] : NULL;
+    int tam;
+    if (!inst_le_int(arq, &tam) || tam < 0)
+        return false;
+    char buf[1024];
+    while (tam > 0) {
+        size_t n = tam < (int)sizeof(buf) ? tam : sizeof(buf);
+        if (!inst_le(arq, buf, n))
+            return false;
+        if (saida != NULL && fwrite(buf, 1, n, saida) != n)
+            return false;
+        tam -= n;
+    }
+    return true;
+}
+
+bool console_salva(console_t *self, FILE *arq)
+{
+    if (!inst_escreve_marca(arq, "CONS") || !inst_escreve_int(arq, N_TERM))
+        return false;
+    for (int t = 0; t < N_TERM; t++) {
+        if (!terminal_salva(self->term[t], arq))
+            return false;
+        // no modo lote, até onde já foi lida a entrada (-1 se acabou) e o que
+        //   já saiu no arquivo de saída
+        long lido = -1;
+        if (self->sem_tela && self->arq_entrada[t] != NULL)
+            lido = ftell(self->arq_entrada[t]);
+        if (!inst_escreve(arq, &lido, sizeof(lido)))
+            return false;
+        if (!salva_saida_do_terminal(self, t, arq))
+            return false;
+    }
+    return true;
+}
+
+bool console_restaura(console_t *self, FILE *arq)
+{
+    if (!inst_confere_marca(arq, "CONS") || !inst_confere_int(arq, N_TERM))
+        return false;
+    for (int t = 0; t < N_TERM; t++) {
+        long lido;
+        if (!terminal_restaura(self->term[t], arq) || !inst_le(arq, &lido, sizeof(lido)))
+            return false;
+        if (self->sem_tela && self->arq_entrada[t] != NULL) {
+            if (lido < 0) {
+                fclose(self->arq_entrada[t]);
+                self->arq_entrada[t] = NULL;
+            } else if (fseek(self->arq_entrada[t], lido, SEEK_SET) != 0) {
+                return false;
+            }
+        }
+        if (!restaura_saida_do_terminal(self, t, arq))
+            return false;
+    }
+    return true;
 }
 
 // vim: foldmethod=marker
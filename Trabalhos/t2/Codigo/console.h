@@ -8,11 +8,18 @@
 
 #include <stdbool.h>
 #include "terminal.h"
+#include "registro.h"
 
 typedef struct console_t console_t;
 
 // cria e inicializa a console
-console_t *console_cria(void);
+// se 'sem_tela' for true, a console não usa a tela (modo lote): os comandos do
+//   operador são ignorados, a entrada de cada terminal é lida do arquivo
+//   "terminal_X.entrada" (uma linha por vez, quando a entrada do terminal
+//   estiver vazia) e a saída é copiada para "terminal_X.saida", onde X é a
+//   identificação do terminal ('A', 'B', etc); o que seria impresso na área
+//   geral vai somente para o arquivo de log
+console_t *console_cria(bool sem_tela);
 
 // destrói a console
 void console_destroi(console_t *self);
@@ -34,10 +41,39 @@ void console_print_status(console_t *self, char *txt);
 // retorna '\0' caso não tenha comando externo digitado
 char console_comando_externo(console_t *self);
 
+// retorna quanto tempo falta para a console ter algo a inserir na reprodução
+//   de um registro (ver console_define_registro), -1 se não tem; o controlador
+//   chama console_tictac_n nesse instante, para que a entrada chegue no
+//   mesmo instante da gravação
+int console_tempo_ate_entrada(console_t *self);
+
+// define o registro que grava o que chega de fora da simulação (comandos do
+//   operador, entrada dos terminais e o tempo com a simulação parada), ou que
+//   reproduz o gravado; na reprodução, a console não lê os arquivos de entrada
+//   dos terminais, e o que o operador digitar (para parar a simulação, por
+//   exemplo) faz a execução deixar de ser igual à gravada; NULL se não tem registro
+void console_define_registro(console_t *self, registro_t *registro);
+
 // retorna o terminal identificado ('A', 'B', etc)
 terminal_t *console_terminal(console_t *self, char id_terminal);
 
 // esta função deve ser chamada periodicamente para que tela funcione
+// é chamada com a simulação parada: passa uma unidade de tempo para os
+//   terminais, mas não para o relógio (e por isso é gravada no registro)
 void console_tictac(console_t *self);
 
+// equivalente a 'n' tics dos terminais, para quando se passaram 'n'
+//   unidades de tempo desde a última chamada (a tela é redesenhada uma vez)
+void console_tictac_n(console_t *self, int n);
+
+// grava no arquivo 'arq' o estado dos terminais e, no modo lote, até onde
+//   foi lido cada arquivo de entrada e o que já foi escrito em cada arquivo
+//   de saída (ver instantaneo.h)
+bool console_salva(console_t *self, FILE *arq);
+
+// recupera o estado gravado por console_salva; no modo lote, continua a
+//   leitura da entrada de onde estava e reescreve a saída anterior no
+//   arquivo de saída de cada terminal, que foi recriado vazio
+bool console_restaura(console_t *self, FILE *arq);
+
 #endif // CONSOLE_H
@@ -5,60 +5,79 @@
 
 #include "controle.h"
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 #include <assert.h>
 
+// número máximo de instruções executadas de uma vez, sem atender a console
+#define N_INSTR_POR_RAJADA 1000
+
 struct controle_t {
-  cpu_t *cpu;
+  // os núcleos, que compartilham a memória e os dispositivos; o primeiro é o
+  //   dado na criação
+  cpu_t **cpus;
+  int n_cpus;
   relogio_t *relogio;
+  disco_t *disco;
   console_t *console;
   enum { executando, passo, parado, fim } estado;
+  int parada; // instante em que o laço em modo lote para, -1 se não tem
 };
 
 // funções auxiliares
+static void controle_executa_rajada(controle_t *self);
+static void controle_executa_nucleo(cpu_t *cpu, int n);
+static bool controle_cpu_dormindo_para_sempre(controle_t *self);
 static void controle_processa_comandos_da_console(controle_t *self);
 static void controle_atualiza_estado_na_console(controle_t *self);
 
 
-controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
+controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio,
+                          disco_t *disco)
 {
   controle_t *self = malloc(sizeof(*self));
   assert(self != NULL);
 
-  self->cpu = cpu;
+  self->cpus = malloc(sizeof(*self->cpus));
+  assert(self->cpus != NULL);
+  self->cpus[0] = cpu;
+  self->n_cpus = 1;
   self->console = console;
   self->relogio = relogio;
+  self->disco = disco;
   self->estado = parado;
+  self->parada = -1;
 
   return self;
 }
 
 void controle_destroi(controle_t *self)
 {
+  free(self->cpus);
   free(self);
 }
 
+void controle_adiciona_cpu(controle_t *self, cpu_t *cpu)
+{
+  self->cpus = realloc(self->cpus, (self->n_cpus + 1) * sizeof(*self->cpus));
+  assert(self->cpus != NULL);
+  self->cpus[self->n_cpus++] = cpu;
+}
+
 void controle_laco(controle_t *self)
 {
   // executa uma instrução por vez até a console dizer que chega
   do {
     if (self->estado == passo || self->estado == executando) {
-      cpu_executa_1(self->cpu);
-      relogio_tictac(self->relogio);
+      controle_executa_rajada(self);
 
       if (self->estado == passo) self->estado = parado;
-
-      // enquanto não tem controlador de interrupção, fala direto com o relógio
-      // o dispositivo 3 do relógio contém 1 se o timer expirou
-      int tem_int;
-      relogio_leitura(self->relogio, 3, &tem_int);
-      if (tem_int != 0) {
-        cpu_interrompe(self->cpu, IRQ_RELOGIO);
-      }
+    } else {
+      console_tictac(self->console);
     }
-    console_tictac(self->console);
 
     controle_processa_comandos_da_console(self);
     controle_atualiza_estado_na_console(self);
@@ -67,7 +86,127 @@ void controle_laco(controle_t *self)
   console_printf("Fim da execução.");
   console_printf("relógio: %d\n", relogio_agora(self->relogio));
 }
- 
+
+void controle_define_parada(controle_t *self, int instante)
+{
+  self->parada = instante;
+}
+
+bool controle_laco_lote(controle_t *self)
+{
+  // não tem operador: executa direto, sem ler comandos nem mostrar estado
+  self->estado = executando;
+  clock_t inicio = clock();
+  do {
+    if (self->parada >= 0 && relogio_agora(self->relogio) >= self->parada) {
+      self->parada = -1;
+      self->estado = parado;
+      return false;
+    }
+    // só a reprodução de um registro tem comandos; sem operador, parar ou
+    //   executar passo a passo não faz diferença, só o fim da simulação
+    if (console_comando_externo(self->console) == 'F') break;
+    controle_executa_rajada(self);
+  } while (!controle_cpu_dormindo_para_sempre(self));
+  self->estado = fim;
+  double segundos = (double)(clock() - inicio) / CLOCKS_PER_SEC;
+
+  // o desempenho do simulador também interessa, para comparar versões
+  int instrucoes = relogio_agora(self->relogio);
+  console_printf("Fim da execução.");
+  console_printf("relógio: %d\n", instrucoes);
+  console_printf("tempo de CPU do simulador: %.3fs (%.0f instruções/s)\n",
+                 segundos, segundos > 0 ? instrucoes / segundos : 0.0);
+  return true;
+}
+
+// executa uma rajada de instruções e faz o relógio, o disco e a console andarem
+// o resultado é o mesmo de executar uma instrução por vez: a rajada termina
+//   antes do timer expirar ou do disco concluir uma requisição, e a CPU para
+//   sozinha em E/S e interrupções
+// com mais de um núcleo, o primeiro dá o ritmo: os outros executam, um depois
+//   do outro, o mesmo número de instruções que ele executou na rajada; eles não
+//   param em E/S, e veem o relógio do início da rajada
+static void controle_executa_rajada(controle_t *self)
+{
+  int n = N_INSTR_POR_RAJADA;
+  int t_ate_int, tem_int, t_ate_disco, tem_int_disco, t_ate_entrada;
+  relogio_leitura(self->relogio, 2, &t_ate_int);
+  relogio_leitura(self->relogio, 3, &tem_int);
+  t_ate_disco = disco_tempo_ate_conclusao(self->disco);
+  disco_leitura(self->disco, 4, &tem_int_disco);
+  // na reprodução de um registro, a rajada termina quando chega a hora de
+  //   a console inserir o que foi gravado
+  t_ate_entrada = console_tempo_ate_entrada(self->console);
+  if (t_ate_int > 0 && t_ate_int < n) n = t_ate_int;
+  if (t_ate_disco > 0 && t_ate_disco < n) n = t_ate_disco;
+  if (t_ate_entrada > 0 && t_ate_entrada < n) n = t_ate_entrada;
+  // com interrupção pendente, tenta interromper a cada instrução
+  if (tem_int != 0 || tem_int_disco != 0 || self->estado == passo) n = 1;
+  // não passa do instante de parada
+  if (self->parada >= 0 && self->parada - relogio_agora(self->relogio) < n) {
+    n = self->parada - relogio_agora(self->relogio);
+  }
+
+  int executadas = cpu_executa_n(self->cpus[0], n);
+  // com a CPU parada, o tempo passa do mesmo jeito
+  if (executadas == 0) executadas = n;
+  for (int i = 1; i < self->n_cpus; i++) {
+    controle_executa_nucleo(self->cpus[i], executadas);
+  }
+  relogio_avanca(self->relogio, executadas);
+  disco_avanca(self->disco, executadas);
+  console_tictac_n(self->console, executadas);
+
+  // enquanto não tem controlador de interrupção, fala direto com os dispositivos
+  // o dispositivo 3 do relógio contém 1 se o timer expirou, o 4 do disco
+  //   contém 1 se tem leitura concluída
+  // a CPU só aceita uma interrupção por vez; a outra continua pendente no
+  //   dispositivo e é pedida de novo nas próximas rajadas
+  // o relógio interrompe todos os núcleos que aceitarem (cada um conta o seu
+  //   tempo), o disco só o primeiro que aceitar
+  relogio_leitura(self->relogio, 3, &tem_int);
+  disco_leitura(self->disco, 4, &tem_int_disco);
+  if (tem_int != 0) {
+    for (int i = 0; i < self->n_cpus; i++) {
+      cpu_interrompe(self->cpus[i], IRQ_RELOGIO);
+    }
+  } else if (tem_int_disco != 0) {
+    for (int i = 0; i < self->n_cpus; i++) {
+      if (cpu_interrompe(self->cpus[i], IRQ_DISCO)) break;
+    }
+  }
+}
+
+// executa 'n' instruções num núcleo que não é o primeiro, a menos que ele pare
+static void controle_executa_nucleo(cpu_t *cpu, int n)
+{
+  while (n > 0) {
+    int executadas = cpu_executa_n(cpu, n);
+    if (executadas == 0) break;
+    n -= executadas;
+  }
+}
+
+// retorna true se as CPUs estão paradas e nada mais pode acordá-las
+// os dispositivos que geram interrupção são o relógio e o disco; se o timer
+//   não está programado (dispositivo 2) nem tem interrupção pendente
+//   (dispositivo 3), e o disco não tem requisição em andamento nem leitura
+//   concluída, a simulação não tem mais como avançar
+static bool controle_cpu_dormindo_para_sempre(controle_t *self)
+{
+  for (int i = 0; i < self->n_cpus; i++) {
+    if (!cpu_parada(self->cpus[i])) return false;
+  }
+  int t_ate_int, tem_int, pendentes_disco, tem_int_disco;
+  relogio_leitura(self->relogio, 2, &t_ate_int);
+  relogio_leitura(self->relogio, 3, &tem_int);
+  disco_leitura(self->disco, 2, &pendentes_disco);
+  disco_leitura(self->disco, 4, &tem_int_disco);
+  return t_ate_int == 0 && tem_int == 0
+         && pendentes_disco == 0 && tem_int_disco == 0;
+}
+
 
 static void controle_processa_comandos_da_console(controle_t *self)
 {
@@ -97,6 +236,6 @@ static void controle_atualiza_estado_na_console(controle_t *self)
     case executando: strcpy(status, "EXEC   | "); break;
     case passo:      strcpy(status, "PASSO  | "); break;
   }
-  cpu_concatena_descricao(self->cpu, status);
+  cpu_concatena_descricao(self->cpus[0], status);
   console_print_status(self->console, status);
 }
@@ -11,11 +11,31 @@ typedef struct controle_t controle_t;
 #include "cpu.h"
 #include "console.h"
 #include "relogio.h"
+#include "disco.h"
 
-controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio);
+#include <stdbool.h>
+
+controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio,
+                          disco_t *disco);
 void controle_destroi(controle_t *self);
 
+// acrescenta um núcleo, outra CPU que compartilha a memória e os dispositivos
+//   com a dada na criação; os núcleos executam em sequência, cada rajada em
+//   todos, no mesmo intervalo do relógio
+void controle_adiciona_cpu(controle_t *self, cpu_t *cpu);
+
 // o laço principal da simulação
 void controle_laco(controle_t *self);
 
+// o laço principal da simulação sem interação com o operador (modo lote)
+// executa até que a CPU esteja parada e não exista mais interrupção que
+//   possa acordá-la (o relógio não tem timer programado e o disco está parado)
+// retorna false se parou antes, no instante definido por controle_define_parada
+//   (a simulação pode continuar com outra chamada); true no fim da simulação
+bool controle_laco_lote(controle_t *self);
+
+// faz o laço em modo lote parar quando o relógio chegar em 'instante' (para
+//   gravar um instantâneo, por exemplo); vale para uma parada só
+void controle_define_parada(controle_t *self, int instante);
+
 #endif // CONTROLE_H
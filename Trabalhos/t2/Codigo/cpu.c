@@ -7,6 +7,7 @@
 #include "cpu.h"
 #include "err.h"
 #include "instrucao.h"
+#include "instantaneo.h"
 
 #include <stdbool.h>
 #include <stdlib.h>
@@ -15,6 +16,93 @@
 #include <assert.h>
 
 // DECLARAÇÃO {{{1
+
+// número de entradas no cache de instruções decodificadas (potência de 2)
+#define N_DECOD 1024
+
+// uma instrução já decodificada, identificada pelo endereço físico do opcode
+// o argumento só é decodificado junto se estiver na mesma página que o
+//   opcode; assim o conteúdo da entrada só depende da memória física (e não
+//   da tabela de páginas), e só precisa ser invalidado quando a memória for
+//   alterada no endereço do opcode ou do argumento
+typedef struct {
+  // endereço físico da instrução (-1 se a entrada estiver livre)
+  int endfis;
+  // opcode, ou N_OPCODE se não for uma instrução válida
+  int opcode;
+  // a instrução só pode ser executada em modo supervisor
+  bool privilegiada;
+  // a instrução acessa dispositivos ou chama o SO
+  bool usa_es;
+  // se o argumento está decodificado em A1
+  bool tem_A1;
+  int A1;
+} decod_t;
+
+// número de entradas no cache de blocos básicos (potência de 2)
+#define N_BLOCOS 512
+
+// número de entradas no filtro de páginas com código (potência de 2)
+#define N_PAGINAS_CODIGO 1024
+
+// tratador de uma instrução, executa com o argumento em A1 (ver pega_A1)
+typedef void (*executa_t)(cpu_t *self);
+
+// sequências de instruções que a CPU sabe executar fundidas (ver fusoes)
+typedef enum {
+  F_CARGM_SOMA_ARMM,
+  F_CARGM_SUB_ARMM,
+  F_CPXA_SUB_DESVNZ,
+  F_CPXA_RESTO_DESVNZ,
+  F_SUB_DESVNZ,
+  F_RESTO_DESVNZ,
+  F_INCX_CPXA,
+  F_CARGM_TRAX,
+  F_TRAX_ARMM,
+  F_CARGX_DESVZ,
+  N_FUSAO
+} fusao_t;
+
+// número máximo de instruções numa sequência fundida
+#define MAX_FUSAO 3
+
+// uma instrução de um bloco básico, com o tratador e o argumento já resolvidos
+typedef struct {
+  executa_t executa;
+  int A1;
+  // sequência fundida que começa nesta instrução, N_FUSAO se nenhuma
+  fusao_t fusao;
+} instr_bloco_t;
+
+// executa uma sequência fundida, a partir da instrução 'ib' de um bloco,
+//   exatamente como as instruções executadas uma a uma: cada uma altera o PC,
+//   e a execução para na que causar erro ou interrupção
+// retorna o número de instruções executadas (a que causou erro conta)
+typedef int (*funde_t)(cpu_t *self, const instr_bloco_t *ib);
+
+// um bloco básico: uma sequência de instruções executadas sempre em seguida,
+//   que termina com um desvio (DESV*, CHAMA, RET), com CHAMAS, RETI ou PARA,
+//   ou antes de uma instrução que acessa dispositivos ou o SO (LE, ESCR,
+//   CHAMAC), de uma instrução inválida ou do fim da página
+// como no cache de instruções decodificadas, é identificado pelo endereço
+//   físico do início, e como está todo na mesma página o conteúdo só depende
+//   da memória física: basta uma tradução para executá-lo inteiro, e uma
+//   página remapeada é retraduzida na entrada do bloco; é invalidado quando
+//   a memória é alterada em algum endereço dele (o disco escrevendo na página,
+//   por exemplo)
+typedef struct {
+  // endereço físico da primeira instrução (-1 se a entrada estiver livre)
+  int endfis;
+  // número de endereços ocupados pelas instruções
+  int tam;
+  // número de instruções; 0 se não tem bloco nesse endereço (a instrução é
+  //   executada uma por vez)
+  int n_instr;
+  // o bloco tem instrução que só pode ser executada em modo supervisor
+  bool privilegiada;
+  instr_bloco_t instr[TAM_PAGINA];
+} bloco_t;
+
 // uma CPU tem estado, memória, controlador de ES
 struct cpu_t {
   // registradores
@@ -33,9 +121,41 @@ struct cpu_t {
   // função e argumento para implementar instrução CHAMAC
   func_chamaC_t funcaoC;
   void *argC;
+  // instruções decodificadas, indexadas pelo endereço físico
+  decod_t decod[N_DECOD];
+  // blocos básicos, indexados pelo endereço físico do início
+  bloco_t blocos[N_BLOCOS];
+  // páginas físicas (pelo número, módulo N_PAGINAS_CODIGO) de onde algo foi
+  //   decodificado desde que os caches foram esvaziados; uma escrita numa página
+  //   que não está marcada não tem o que invalidar
+  bool paginas_codigo[N_PAGINAS_CODIGO];
+  // os blocos são montados com as sequências fundidas
+  bool funde;
+  // número de execuções de cada sequência fundida
+  long fusoes_executadas[N_FUSAO];
+  // argumento da instrução em execução, se já foi obtido na decodificação
+  bool tem_A1;
+  int A1;
+  // uma interrupção foi aceita durante a execução da instrução
+  bool interrompida;
+  // endereço da área onde o estado é salvo na interrupção (ver IRQ_END_AREA)
+  int end_area;
 };
 
 // CRIAÇÃO {{{1
+
+// esvazia os caches de instruções decodificadas e de blocos básicos
+static void esvazia_caches(cpu_t *self)
+{
+  for (int i = 0; i < N_DECOD; i++) {
+    self->decod[i].endfis = -1;
+  }
+  for (int i = 0; i < N_BLOCOS; i++) {
+    self->blocos[i].endfis = -1;
+  }
+  memset(self->paginas_codigo, 0, sizeof(self->paginas_codigo));
+}
+
 cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
 {
   cpu_t *self;
@@ -59,6 +179,13 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
   self->privilegiadas[ESCR] = true;
   self->privilegiadas[RETI] = true;
   self->privilegiadas[CHAMAC] = true;
+  // inicializa o cache de instruções decodificadas, vazio
+  esvazia_caches(self);
+  self->funde = false;
+  memset(self->fusoes_executadas, 0, sizeof(self->fusoes_executadas));
+  self->tem_A1 = false;
+  self->interrompida = false;
+  self->end_area = 0;
   // gera uma interrupção de reset, para o SO poder executar
   cpu_interrompe(self, IRQ_RESET);
 
@@ -77,6 +204,25 @@ void cpu_define_chamaC(cpu_t *self, func_chamaC_t funcaoC, void *argC)
   self->argC = argC;
 }
 
+void cpu_define_area_irq(cpu_t *self, int endereco)
+{
+  self->end_area = endereco;
+}
+
+void cpu_define_fusao(cpu_t *self, bool funde)
+{
+  self->funde = funde;
+  // os blocos já montados foram montados com a opção anterior
+  for (int i = 0; i < N_BLOCOS; i++) {
+    self->blocos[i].endfis = -1;
+  }
+}
+
+bool cpu_parada(cpu_t *self)
+{
+  return self->erro == ERR_CPU_PARADA;
+}
+
 // IMPRESSÃO {{{1
 static void imprime_registradores(cpu_t *self, char *str)
 {
@@ -141,23 +287,14 @@ static bool pega_mem(cpu_t *self, int endereco, int *pval)
   return false;
 }
 
-// lê o opcode da instrução no PC
-// retorna true se ele pode ser executado, ou põe em erro o motivo de não poder
-static bool pega_opcode(cpu_t *self, int *popc)
-{
-  // não tem que testar endereços, é tarefa da mmu
-  // não pode executar se houver erro na leitura da memória
-  if (!pega_mem(self, self->PC, popc)) return false;
-  // pode executar se tiver privilégio para isso
-  if (self->modo == supervisor || !self->privilegiadas[*popc]) return true;
-  // não pode executar instrução privilegiada em modo usuário
-  self->erro = ERR_INSTR_PRIV;
-  return false;
-}
-
 // lê o argumento 1 da instrução no PC
 static bool pega_A1(cpu_t *self, int *pA1)
 {
+  // se foi decodificado junto com a instrução, não precisa ler de novo
+  if (self->tem_A1) {
+    *pA1 = self->A1;
+    return true;
+  }
   return pega_mem(self, self->PC + 1, pA1);
 }
 
@@ -422,53 +559,418 @@ static void op_CHAMAS(cpu_t *self) // chamada de sistema
 
 }
 
-// EXECUTA UMA INSTRUÇÃO {{{1
+static void op_invalida(cpu_t *self) // opcode desconhecido
+{
+  self->erro = ERR_INSTR_INV;
+}
+
+// tratador de cada instrução, para os blocos básicos
+static const executa_t tratadores[N_OPCODE] = {
+  [NOP]    = op_NOP,
+  [PARA]   = op_PARA,
+  [CARGI]  = op_CARGI,
+  [CARGM]  = op_CARGM,
+  [CARGX]  = op_CARGX,
+  [ARMM]   = op_ARMM,
+  [ARMX]   = op_ARMX,
+  [TRAX]   = op_TRAX,
+  [CPXA]   = op_CPXA,
+  [INCX]   = op_INCX,
+  [SOMA]   = op_SOMA,
+  [SUB]    = op_SUB,
+  [MULT]   = op_MULT,
+  [DIV]    = op_DIV,
+  [RESTO]  = op_RESTO,
+  [NEG]    = op_NEG,
+  [DESV]   = op_DESV,
+  [DESVZ]  = op_DESVZ,
+  [DESVNZ] = op_DESVNZ,
+  [DESVN]  = op_DESVN,
+  [DESVP]  = op_DESVP,
+  [CHAMA]  = op_CHAMA,
+  [RET]    = op_RET,
+  [LE]     = op_LE,
+  [ESCR]   = op_ESCR,
+  [RETI]   = op_RETI,
+  [CHAMAC] = op_CHAMAC,
+  [CHAMAS] = op_CHAMAS,
+};
+
+// FUSÃO DE INSTRUÇÕES {{{1
+
+// executa a instrução 'i' de uma sequência fundida, com o argumento decodificado
+//   no bloco, e retorna se ela causou erro ou interrupção
+#define PASSO(i, op)                                                   \
+  do {                                                                 \
+    self->A1 = ib[i].A1;                                               \
+    op_##op(self);                                                     \
+    if (self->erro != ERR_OK || self->interrompida) return i + 1;      \
+  } while (0)
+
+#define FUNDE_2(a, b)                                                  \
+  static int funde_##a##_##b(cpu_t *self, const instr_bloco_t *ib)     \
+  {                                                                    \
+    PASSO(0, a);                                                       \
+    PASSO(1, b);                                                       \
+    return 2;                                                          \
+  }
+
+#define FUNDE_3(a, b, c)                                               \
+  static int funde_##a##_##b##_##c(cpu_t *self, const instr_bloco_t *ib) \
+  {                                                                    \
+    PASSO(0, a);                                                       \
+    PASSO(1, b);                                                       \
+    PASSO(2, c);                                                       \
+    return 3;                                                          \
+  }
+
+FUNDE_3(CARGM, SOMA, ARMM)
+FUNDE_3(CARGM, SUB, ARMM)
+FUNDE_3(CPXA, SUB, DESVNZ)
+FUNDE_3(CPXA, RESTO, DESVNZ)
+FUNDE_2(SUB, DESVNZ)
+FUNDE_2(RESTO, DESVNZ)
+FUNDE_2(INCX, CPXA)
+FUNDE_2(CARGM, TRAX)
+FUNDE_2(TRAX, ARMM)
+FUNDE_2(CARGX, DESVZ)
+
+#undef FUNDE_3
+#undef FUNDE_2
+#undef PASSO
+
+// as sequências fundidas, escolhidas entre as mais executadas pelos programas
+//   de exemplo (laços de teste de divisibilidade, acesso a variáveis)
+// uma instrução que escreve na memória (ARMM, ARMX, CHAMA) ou desvia só pode
+//   ser a última da sequência: a escrita pode alterar o próprio bloco, e o
+//   bloco é abandonado nesse caso, mas só entre uma execução e outra
+// são procuradas na ordem da tabela, as mais longas primeiro
+static const struct {
+  char *nome;
+  int n_instr;
+  int opcode[MAX_FUSAO];
+  funde_t funde;
+} fusoes[N_FUSAO] = {
+  [F_CARGM_SOMA_ARMM]   = { "CARGM SOMA ARMM",   3, { CARGM, SOMA, ARMM },    funde_CARGM_SOMA_ARMM },
+  [F_CARGM_SUB_ARMM]    = { "CARGM SUB ARMM",    3, { CARGM, SUB, ARMM },     funde_CARGM_SUB_ARMM },
+  [F_CPXA_SUB_DESVNZ]   = { "CPXA SUB DESVNZ",   3, { CPXA, SUB, DESVNZ },    funde_CPXA_SUB_DESVNZ },
+  [F_CPXA_RESTO_DESVNZ] = { "CPXA RESTO DESVNZ", 3, { CPXA, RESTO, DESVNZ },  funde_CPXA_RESTO_DESVNZ },
+  [F_SUB_DESVNZ]        = { "SUB DESVNZ",        2, { SUB, DESVNZ },          funde_SUB_DESVNZ },
+  [F_RESTO_DESVNZ]      = { "RESTO DESVNZ",      2, { RESTO, DESVNZ },        funde_RESTO_DESVNZ },
+  [F_INCX_CPXA]         = { "INCX CPXA",         2, { INCX, CPXA },           funde_INCX_CPXA },
+  [F_CARGM_TRAX]        = { "CARGM TRAX",        2, { CARGM, TRAX },          funde_CARGM_TRAX },
+  [F_TRAX_ARMM]         = { "TRAX ARMM",         2, { TRAX, ARMM },           funde_TRAX_ARMM },
+  [F_CARGX_DESVZ]       = { "CARGX DESVZ",       2, { CARGX, DESVZ },         funde_CARGX_DESVZ },
+};
+
+int cpu_n_fusoes(void)
+{
+  return N_FUSAO;
+}
+
+char *cpu_fusao_nome(int fusao)
+{
+  if (fusao < 0 || fusao >= N_FUSAO) return "???";
+  return fusoes[fusao].nome;
+}
 
-static void executa_a_instrucao(cpu_t *self, int opcode)
+long cpu_fusao_execucoes(cpu_t *self, int fusao)
+{
+  if (fusao < 0 || fusao >= N_FUSAO) return 0;
+  return self->fusoes_executadas[fusao];
+}
+
+// procura uma sequência fundida no início das 'n' instruções com os opcodes
+//   em 'opcode'; retorna N_FUSAO se não encontrar
+static fusao_t procura_fusao(int *opcode, int n)
+{
+  for (fusao_t f = 0; f < N_FUSAO; f++) {
+    if (fusoes[f].n_instr > n) continue;
+    int i;
+    for (i = 0; i < fusoes[f].n_instr; i++) {
+      if (opcode[i] != fusoes[f].opcode[i]) break;
+    }
+    if (i == fusoes[f].n_instr) return f;
+  }
+  return N_FUSAO;
+}
+
+// EXECUTA INSTRUÇÕES {{{1
+
+// decodifica a instrução que está no endereço físico 'endfis', colocando-a
+//   na entrada 'd' do cache
+static void decodifica(cpu_t *self, decod_t *d, int endfis)
+{
+  int opcode;
+  // o endereço do opcode foi validado pela tradução; o das instruções
+  //   seguintes de um bloco pode estar além do fim da memória, se ela não
+  //   tiver um número inteiro de páginas
+  if (mmu_le(self->mmu, endfis, &opcode, supervisor) != ERR_OK) opcode = -1;
+  self->paginas_codigo[PAGINA_DO_END(endfis) & (N_PAGINAS_CODIGO - 1)] = true;
+  d->endfis = endfis;
+  d->tem_A1 = false;
+  // as pseudo-instruções (a partir de VALOR) não são executáveis
+  if (opcode < 0 || opcode >= VALOR) {
+    d->opcode = N_OPCODE;
+    d->privilegiada = false;
+    d->usa_es = false;
+    return;
+  }
+  d->opcode = opcode;
+  d->privilegiada = self->privilegiadas[opcode];
+  d->usa_es = opcode == LE || opcode == ESCR || opcode == CHAMAC;
+  // o argumento só é decodificado se estiver na mesma página
+  if (instrucao_num_args(opcode) == 1 && DESLOC_DO_END(endfis) != TAM_PAGINA - 1) {
+    d->tem_A1 = mmu_le(self->mmu, endfis + 1, &d->A1, supervisor) == ERR_OK;
+  }
+}
+
+// traduz o PC para o endereço físico da instrução
+// retorna false (e põe em erro o motivo) se não for possível
+static bool traduz_PC(cpu_t *self, int *pendfis)
+{
+  // não tem que testar endereços, é tarefa da mmu
+  self->erro = mmu_traduz(self->mmu, self->PC, pendfis, self->modo);
+  if (self->erro == ERR_OK) return true;
+  self->complemento = self->PC;
+  return false;
+}
+
+// obtém a instrução no endereço físico 'endfis', decodificada
+static decod_t *pega_instrucao(cpu_t *self, int endfis)
+{
+  decod_t *d = &self->decod[endfis & (N_DECOD - 1)];
+  if (d->endfis != endfis) {
+    decodifica(self, d, endfis);
+  }
+  return d;
+}
+
+// a instrução termina um bloco básico (a seguinte não é necessariamente
+//   executada depois dela)
+static bool termina_bloco(int opcode)
 {
   switch (opcode) {
-    case NOP:    op_NOP(self);    break;
-    case PARA:   op_PARA(self);   break;
-    case CARGI:  op_CARGI(self);  break;
-    case CARGM:  op_CARGM(self);  break;
-    case CARGX:  op_CARGX(self);  break;
-    case ARMM:   op_ARMM(self);   break;
-    case ARMX:   op_ARMX(self);   break;
-    case TRAX:   op_TRAX(self);   break;
-    case CPXA:   op_CPXA(self);   break;
-    case INCX:   op_INCX(self);   break;
-    case SOMA:   op_SOMA(self);   break;
-    case SUB:    op_SUB(self);    break;
-    case MULT:   op_MULT(self);   break;
-    case DIV:    op_DIV(self);    break;
-    case RESTO:  op_RESTO(self);  break;
-    case NEG:    op_NEG(self);    break;
-    case DESV:   op_DESV(self);   break;
-    case DESVZ:  op_DESVZ(self);  break;
-    case DESVNZ: op_DESVNZ(self); break;
-    case DESVN:  op_DESVN(self);  break;
-    case DESVP:  op_DESVP(self);  break;
-    case CHAMA:  op_CHAMA(self);  break;
-    case RET:    op_RET(self);    break;
-    case LE:     op_LE(self);     break;
-    case ESCR:   op_ESCR(self);   break;
-    case RETI:   op_RETI(self);   break;
-    case CHAMAC: op_CHAMAC(self); break;
-    case CHAMAS: op_CHAMAS(self); break;
-    default:     self->erro = ERR_INSTR_INV;
+    case DESV: case DESVZ: case DESVNZ: case DESVN: case DESVP:
+    case CHAMA: case RET: case CHAMAS: case RETI: case PARA:
+      return true;
+    default:
+      return false;
   }
 }
 
-void cpu_executa_1(cpu_t *self)
+// monta o bloco básico que começa no endereço físico 'endfis', na entrada 'b'
+// se a primeira instrução não pode estar num bloco, a entrada fica com 0
+//   instruções (e cobrindo o endereço do opcode, para ser invalidada se ele
+//   for alterado)
+static void monta_bloco(cpu_t *self, bloco_t *b, int endfis)
 {
-  // não executa se CPU já estiver em erro
-  if (self->erro != ERR_OK) return;
+  int fim_pagina = endfis - DESLOC_DO_END(endfis) + TAM_PAGINA;
+  int end = endfis;
+  b->endfis = endfis;
+  b->n_instr = 0;
+  b->privilegiada = false;
+  int opcode[TAM_PAGINA];
+  while (end < fim_pagina) {
+    decod_t d;
+    decodifica(self, &d, end);
+    // a E/S tem que ser a primeira instrução de uma rajada, e o argumento
+    //   na página seguinte depende da tabela de páginas
+    if (d.opcode == N_OPCODE || d.usa_es) break;
+    if (instrucao_num_args(d.opcode) == 1 && !d.tem_A1) break;
+    opcode[b->n_instr] = d.opcode;
+    b->instr[b->n_instr].executa = tratadores[d.opcode];
+    b->instr[b->n_instr].A1 = d.A1;
+    b->instr[b->n_instr].fusao = N_FUSAO;
+    b->n_instr++;
+    b->privilegiada = b->privilegiada || d.privilegiada;
+    end += 1 + instrucao_num_args(d.opcode);
+    if (termina_bloco(d.opcode)) break;
+  }
+  b->tam = b->n_instr > 0 ? end - endfis : 1;
+  // marca as sequências fundidas, sem sobreposição
+  if (!self->funde) return;
+  for (int i = 0; i < b->n_instr; ) {
+    fusao_t f = procura_fusao(&opcode[i], b->n_instr - i);
+    if (f == N_FUSAO) {
+      i++;
+    } else {
+      b->instr[i].fusao = f;
+      i += fusoes[f].n_instr;
+    }
+  }
+}
 
-  int opcode;
-  if (pega_opcode(self, &opcode)) {
-    executa_a_instrucao(self, opcode);
+// obtém o bloco básico que começa no endereço físico 'endfis'
+static bloco_t *pega_bloco(cpu_t *self, int endfis)
+{
+  bloco_t *b = &self->blocos[endfis & (N_BLOCOS - 1)];
+  if (b->endfis != endfis) {
+    monta_bloco(self, b, endfis);
+  }
+  return b;
+}
+
+void cpu_invalida_decod(void *cpu, int endfis)
+{
+  cpu_t *self = cpu;
+  if (!self->paginas_codigo[PAGINA_DO_END(endfis) & (N_PAGINAS_CODIGO - 1)]) return;
+  // a alteração pode ser no opcode de uma instrução ou no argumento da
+  //   instrução do endereço anterior
+  decod_t *d = &self->decod[endfis & (N_DECOD - 1)];
+  if (d->endfis == endfis) d->endfis = -1;
+  d = &self->decod[(endfis - 1) & (N_DECOD - 1)];
+  if (d->endfis == endfis - 1) d->endfis = -1;
+  // e em qualquer endereço de um bloco que começa antes, na mesma página
+  for (int inicio = endfis - DESLOC_DO_END(endfis); inicio <= endfis; inicio++) {
+    bloco_t *b = &self->blocos[inicio & (N_BLOCOS - 1)];
+    if (b->endfis == inicio && inicio + b->tam > endfis) b->endfis = -1;
   }
+}
 
+void cpu_executa_1(cpu_t *self)
+{
+  cpu_executa_n(self, 1);
+}
+
+int cpu_executa_n(cpu_t *self, int n)
+{
+  // endereço do código que executa cada instrução (despacho direto, com
+  //   goto calculado); os opcodes inválidos foram decodificados como N_OPCODE
+  static void *const rotulo[N_OPCODE + 1] = {
+    [NOP]    = &&i_NOP,
+    [PARA]   = &&i_PARA,
+    [CARGI]  = &&i_CARGI,
+    [CARGM]  = &&i_CARGM,
+    [CARGX]  = &&i_CARGX,
+    [ARMM]   = &&i_ARMM,
+    [ARMX]   = &&i_ARMX,
+    [TRAX]   = &&i_TRAX,
+    [CPXA]   = &&i_CPXA,
+    [INCX]   = &&i_INCX,
+    [SOMA]   = &&i_SOMA,
+    [SUB]    = &&i_SUB,
+    [MULT]   = &&i_MULT,
+    [DIV]    = &&i_DIV,
+    [RESTO]  = &&i_RESTO,
+    [NEG]    = &&i_NEG,
+    [DESV]   = &&i_DESV,
+    [DESVZ]  = &&i_DESVZ,
+    [DESVNZ] = &&i_DESVNZ,
+    [DESVN]  = &&i_DESVN,
+    [DESVP]  = &&i_DESVP,
+    [CHAMA]  = &&i_CHAMA,
+    [RET]    = &&i_RET,
+    [LE]     = &&i_LE,
+    [ESCR]   = &&i_ESCR,
+    [RETI]   = &&i_RETI,
+    [CHAMAC] = &&i_CHAMAC,
+    [CHAMAS] = &&i_CHAMAS,
+    [N_OPCODE] = &&i_invalida,
+  };
+  int executadas = 0;
+  int endfis;
+  decod_t *instr;
+  bloco_t *bloco;
+
+  // não executa se CPU já estiver em erro
+  if (self->erro != ERR_OK) return 0;
+  self->interrompida = false;
+
+  // termina a instrução em execução e despacha a próxima, se for o caso
+  // para depois de um erro, de uma interrupção ou de E/S; a E/S (e a chamada
+  //   ao SO) só é executada no início de uma rajada, para que tudo que foi
+  //   executado antes já tenha sido contabilizado no relógio
+  // a entrada do cache pode ser invalidada durante a execução (se a
+  //   instrução alterar a memória), o argumento é copiado antes
+  // se no PC começa um bloco básico que pode ser executado, executa o bloco
+  //   inteiro (ou até completar n instruções) sem voltar ao despacho; cada
+  //   instrução conta como uma no relógio, e o bloco é abandonado se uma
+  //   instrução dele alterar o próprio bloco
+#define PROXIMA()                                                     \
+  do {                                                                \
+    self->tem_A1 = false;                                             \
+    if (self->erro != ERR_OK || self->interrompida) goto fim;         \
+    if (executadas == n) goto fim;                                    \
+    if (!traduz_PC(self, &endfis)) goto falha;                        \
+    if (n - executadas > 1) {                                         \
+      bloco = pega_bloco(self, endfis);                               \
+      if (bloco->n_instr > 0                                          \
+          && (!bloco->privilegiada || self->modo == supervisor)) {    \
+        goto executa_bloco;                                           \
+      }                                                               \
+    }                                                                 \
+    instr = pega_instrucao(self, endfis);                             \
+    if (instr->privilegiada && self->modo != supervisor) goto priv;   \
+    if (instr->usa_es && executadas > 0) goto fim;                    \
+    self->tem_A1 = instr->tem_A1;                                     \
+    self->A1 = instr->A1;                                             \
+    executadas++;                                                     \
+    goto *rotulo[instr->opcode];                                      \
+  } while (0)
+
+  PROXIMA();
+
+executa_bloco:
+  // uma sequência fundida só é executada se couber inteira no limite de
+  //   instruções, senão as instruções são executadas uma a uma
+  self->tem_A1 = true;
+  for (instr_bloco_t *ib = bloco->instr; ib < bloco->instr + bloco->n_instr; ) {
+    fusao_t f = ib->fusao;
+    if (f != N_FUSAO && n - executadas >= fusoes[f].n_instr) {
+      int k = fusoes[f].funde(self, ib);
+      self->fusoes_executadas[f]++;
+      executadas += k;
+      ib += k;
+    } else {
+      executadas++;
+      self->A1 = ib->A1;
+      ib->executa(self);
+      ib++;
+    }
+    if (self->erro != ERR_OK || self->interrompida || executadas == n) break;
+    if (bloco->endfis != endfis) break;
+  }
+  PROXIMA();
+
+i_NOP:      op_NOP(self);      PROXIMA();
+i_PARA:     op_PARA(self);     PROXIMA();
+i_CARGI:    op_CARGI(self);    PROXIMA();
+i_CARGM:    op_CARGM(self);    PROXIMA();
+i_CARGX:    op_CARGX(self);    PROXIMA();
+i_ARMM:     op_ARMM(self);     PROXIMA();
+i_ARMX:     op_ARMX(self);     PROXIMA();
+i_TRAX:     op_TRAX(self);     PROXIMA();
+i_CPXA:     op_CPXA(self);     PROXIMA();
+i_INCX:     op_INCX(self);     PROXIMA();
+i_SOMA:     op_SOMA(self);     PROXIMA();
+i_SUB:      op_SUB(self);      PROXIMA();
+i_MULT:     op_MULT(self);     PROXIMA();
+i_DIV:      op_DIV(self);      PROXIMA();
+i_RESTO:    op_RESTO(self);    PROXIMA();
+i_NEG:      op_NEG(self);      PROXIMA();
+i_DESV:     op_DESV(self);     PROXIMA();
+i_DESVZ:    op_DESVZ(self);    PROXIMA();
+i_DESVNZ:   op_DESVNZ(self);   PROXIMA();
+i_DESVN:    op_DESVN(self);    PROXIMA();
+i_DESVP:    op_DESVP(self);    PROXIMA();
+i_CHAMA:    op_CHAMA(self);    PROXIMA();
+i_RET:      op_RET(self);      PROXIMA();
+i_LE:       op_LE(self);       PROXIMA();
+i_ESCR:     op_ESCR(self);     PROXIMA();
+i_RETI:     op_RETI(self);     PROXIMA();
+i_CHAMAC:   op_CHAMAC(self);   PROXIMA();
+i_CHAMAS:   op_CHAMAS(self);   PROXIMA();
+i_invalida: op_invalida(self); PROXIMA();
+#undef PROXIMA
+
+priv:
+  // não pode executar instrução privilegiada em modo usuário
+  self->erro = ERR_INSTR_PRIV;
+falha:
+  // a tentativa de execução conta como uma instrução
+  executadas++;
+fim:
   // se a CPU entrou em erro, causa uma interrupção
   // a menos que a CPU tenha parado, porque a única forma de a CPU entrar nesse
   //   estado é pela execução da instrução PARA em modo supervisor, e é a forma de
@@ -478,6 +980,7 @@ void cpu_executa_1(cpu_t *self)
     // se a interrupção não é aceita nesse ponto, temos um problema grave...
     assert(cpu_interrompe(self, IRQ_ERR_CPU));
   }
+  return executadas;
 }
 
 // INTERRUPÇÃO {{{1
@@ -494,15 +997,16 @@ bool cpu_interrompe(cpu_t *self, irq_t irq)
   self->modo = supervisor;
 
   // esta é uma CPU boazinha, salva todo o estado interno da CPU no início da memória
+  //   (ou na área do seu núcleo, se tiver mais de um)
   // self->erro é alterado por poe_mem, copia antes!
   int erro = self->erro;
   int complemento = self->complemento;
-  poe_mem(self, IRQ_END_PC,          self->PC);
-  poe_mem(self, IRQ_END_A,           self->A);
-  poe_mem(self, IRQ_END_X,           self->X);
-  poe_mem(self, IRQ_END_erro,        erro);
-  poe_mem(self, IRQ_END_complemento, complemento);
-  poe_mem(self, IRQ_END_modo,        usuario);
+  poe_mem(self, self->end_area + IRQ_END_PC,          self->PC);
+  poe_mem(self, self->end_area + IRQ_END_A,           self->A);
+  poe_mem(self, self->end_area + IRQ_END_X,           self->X);
+  poe_mem(self, self->end_area + IRQ_END_erro,        erro);
+  poe_mem(self, self->end_area + IRQ_END_complemento, complemento);
+  poe_mem(self, self->end_area + IRQ_END_modo,        usuario);
 
   // altera o estado da CPU para ela poder executar o tratador de interrupção
   // vai iniciar o tratamento da interrupção no endereço IRQ_END_TRATADOR,
@@ -512,6 +1016,7 @@ bool cpu_interrompe(cpu_t *self, irq_t irq)
   self->PC = IRQ_END_TRATADOR;
   self->A = irq;
   self->erro = ERR_OK;
+  self->interrompida = true;
 
   return true;
 }
@@ -524,17 +1029,53 @@ static void cpu_desinterrompe(cpu_t *self)
   
   // tem que estar em modo supervisor para ler nesses endereços
   self->modo = supervisor;
-  pega_mem(self, IRQ_END_PC,          &self->PC);
-  pega_mem(self, IRQ_END_A,           &self->A);
-  pega_mem(self, IRQ_END_X,           &self->X);
+  pega_mem(self, self->end_area + IRQ_END_PC,          &self->PC);
+  pega_mem(self, self->end_area + IRQ_END_A,           &self->A);
+  pega_mem(self, self->end_area + IRQ_END_X,           &self->X);
   // não dá para pegar o erro nem o modo diretamente porque eles não são int
   int erro, modo;
-  pega_mem(self, IRQ_END_erro,        &erro);
-  pega_mem(self, IRQ_END_complemento, &self->complemento);
-  pega_mem(self, IRQ_END_modo,        &modo);
+  pega_mem(self, self->end_area + IRQ_END_erro,        &erro);
+  pega_mem(self, self->end_area + IRQ_END_complemento, &self->complemento);
+  pega_mem(self, self->end_area + IRQ_END_modo,        &modo);
   self->modo = modo;
   // coloca o erro por último, porque pode ser alterado por pega_mem
   self->erro = erro;
 }
 
+// INSTANTÂNEO {{{1
+
+bool cpu_salva(cpu_t *self, FILE *arq)
+{
+  return inst_escreve_marca(arq, "CPU ")
+         && inst_escreve_int(arq, self->PC)
+         && inst_escreve_int(arq, self->A)
+         && inst_escreve_int(arq, self->X)
+         && inst_escreve_int(arq, self->erro)
+         && inst_escreve_int(arq, self->complemento)
+         && inst_escreve_int(arq, self->modo)
+         && inst_escreve(arq, self->fusoes_executadas, sizeof(self->fusoes_executadas));
+}
+
+bool cpu_restaura(cpu_t *self, FILE *arq)
+{
+  int erro, modo;
+  if (!inst_confere_marca(arq, "CPU ")
+      || !inst_le_int(arq, &self->PC)
+      || !inst_le_int(arq, &self->A)
+      || !inst_le_int(arq, &self->X)
+      || !inst_le_int(arq, &erro)
+      || !inst_le_int(arq, &self->complemento)
+      || !inst_le_int(arq, &modo)
+      || !inst_le(arq, self->fusoes_executadas, sizeof(self->fusoes_executadas))) {
+    return false;
+  }
+  self->erro = erro;
+  self->modo = modo;
+  self->tem_A1 = false;
+  self->interrompida = false;
+  // o que foi decodificado é da memória de antes da restauração
+  esvazia_caches(self);
+  return true;
+}
+
 // vim: foldmethod=marker
@@ -15,6 +15,7 @@ typedef enum { supervisor, usuario } cpu_modo_t;
 #include "err.h"
 #include "irq.h"
 #include "mmu.h"
+#include <stdio.h>
 
 // tipo da função a ser chamada quando executar a instrução CHAMAC
 typedef int (*func_chamaC_t)(void *argC, int reg_A);
@@ -33,6 +34,22 @@ void cpu_destroi(cpu_t *self);
 //     e causa uma interrupção
 void cpu_executa_1(cpu_t *self);
 
+// executa até 'n' instruções a partir do PC, como 'n' chamadas a cpu_executa_1
+// para antes se a CPU parar ou entrar em erro (que causa interrupção como em
+//   cpu_executa_1), se uma interrupção for aceita, ou depois de uma instrução
+//   que acessa dispositivos ou o SO (LE, ESCR, CHAMAC) -- essas instruções são
+//   executadas somente como primeira instrução de uma chamada, para que quem
+//   controla o relógio tenha contabilizado as instruções anteriores
+// retorna o número de instruções executadas (as que causaram erro contam),
+//   ou 0 se a CPU estava parada
+int cpu_executa_n(cpu_t *self, int n);
+
+// avisa a CPU que a memória física foi alterada no endereço 'endfis', para
+//   que ela descarte o que tiver decodificado a partir desse endereço
+// o primeiro argumento é a CPU; segue o protocolo de mem_f_observa_t, para
+//   poder ser registrada com mem_define_observador
+void cpu_invalida_decod(void *cpu, int endfis);
+
 // implementa uma interrupção
 // passa para modo supervisor, salva o estado da CPU no início da memória,
 //   altera A para identificar a requisição de interrupção, altera PC para
@@ -40,10 +57,41 @@ void cpu_executa_1(cpu_t *self);
 // retorna true se interrupção foi aceita ou false caso contrário
 bool cpu_interrompe(cpu_t *self, irq_t irq);
 
+// define o endereço da área da memória onde a CPU salva o estado na interrupção
+//   (IRQ_END_AREA do seu núcleo, ver irq.h); 0 quando a CPU é criada
+// a interrupção de reset, pedida na criação, já foi salva no endereço 0
+void cpu_define_area_irq(cpu_t *self, int endereco);
+
 // define a função a chamar quando executar a instrução CHAMAC
 // e o argumento a passar para ela (normalmente, um ponteiro para o SO)
 void cpu_define_chamaC(cpu_t *self, func_chamaC_t func, void *argC);
 
+// liga ou desliga a fusão de instruções (desligada quando a CPU é criada)
+// com a fusão, algumas sequências comuns de instruções (como CARGM SOMA ARMM)
+//   são marcadas quando a CPU traduz o código e executadas como uma operação
+//   só, com o mesmo efeito que teriam uma a uma: cada instrução conta no
+//   limite de cpu_executa_n, e um erro deixa o PC na instrução que o causou
+void cpu_define_fusao(cpu_t *self, bool funde);
+
+// número de sequências de instruções que a CPU sabe fundir, nome de cada uma
+//   (os mnemônicos separados por espaço) e quantas vezes foi executada fundida
+int cpu_n_fusoes(void);
+char *cpu_fusao_nome(int fusao);
+long cpu_fusao_execucoes(cpu_t *self, int fusao);
+
+// retorna true se a CPU está com a execução suspensa (executou PARA e
+//   está esperando uma interrupção)
+bool cpu_parada(cpu_t *self);
+
+// grava no arquivo 'arq' os registradores e o estado interno da CPU (ver
+//   instantaneo.h); não grava a função de CHAMAC nem a opção de fusão, que
+//   são definidas por quem usa a CPU
+bool cpu_salva(cpu_t *self, FILE *arq);
+
+// recupera o estado gravado por cpu_salva; esvazia o que a CPU tinha
+//   decodificado, por isso deve ser chamada depois de restaurar a memória
+bool cpu_restaura(cpu_t *self, FILE *arq);
+
 // concatena a descrição do estado da CPU no final de str
 void cpu_concatena_descricao(cpu_t *self, char *str);
 
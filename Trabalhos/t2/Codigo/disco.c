@@ -0,0 +1,382 @@
+// disco.c
+// dispositivo de E/S que transfere páginas entre a memória secundária e a principal
+// simulador de computador
+// so24b
+
+#include "disco.h"
+#include "mmu.h"
+#include "instantaneo.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+typedef struct {
+  disco_operacao_t operacao;
+  int pagina; // na memória secundária
+  int quadro; // na memória principal
+} requisicao_t;
+
+struct disco_t {
+  mem_t *mem_sec;
+  mem_t *mem_princ;
+  disco_escalonamento_t escalonamento;
+
+  // registradores da próxima requisição
+  int pagina;
+  int quadro;
+
+  // requisições esperando atendimento, em ordem de chegada
+  requisicao_t *pendentes;
+  int n_pendentes;
+  int cap_pendentes;
+
+  // requisição em atendimento
+  bool ocupado;
+  requisicao_t atual;
+  int t_ate_conclusao;
+
+  // posição da cabeça, e direção em que anda no escalonamento elevador
+  int trilha;
+  bool subindo;
+  // última página acessada (a seguinte está logo depois da cabeça)
+  int ultima_pagina;
+
+  // quadros das leituras concluídas, em ordem de conclusão
+  int *concluidas;
+  int n_concluidas;
+  int cap_concluidas;
+
+  // estatísticas
+  int atendidas;
+  int trilhas_percorridas;
+};
+
+static char *nomes_escalonamento[N_DISCO_ESCALONAMENTO] = {
+  [DISCO_FCFS] =     "fcfs",
+  [DISCO_SSTF] =     "sstf",
+  [DISCO_ELEVADOR] = "elevador",
+};
+
+disco_t *disco_cria(mem_t *mem_sec, mem_t *mem_princ)
+{
+  disco_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+
+  self->mem_sec = mem_sec;
+  self->mem_princ = mem_princ;
+  self->escalonamento = DISCO_FCFS;
+  self->pagina = 0;
+  self->quadro = 0;
+
+  self->cap_pendentes = 8;
+  self->pendentes = malloc(self->cap_pendentes * sizeof(*self->pendentes));
+  assert(self->pendentes != NULL);
+  self->n_pendentes = 0;
+
+  self->ocupado = false;
+  self->t_ate_conclusao = 0;
+  self->trilha = 0;
+  self->subindo = true;
+  self->ultima_pagina = -1;
+
+  self->cap_concluidas = 8;
+  self->concluidas = malloc(self->cap_concluidas * sizeof(*self->concluidas));
+  assert(self->concluidas != NULL);
+  self->n_concluidas = 0;
+
+  self->atendidas = 0;
+  self->trilhas_percorridas = 0;
+
+  return self;
+}
+
+void disco_destroi(disco_t *self)
+{
+  free(self->pendentes);
+  free(self->concluidas);
+  free(self);
+}
+
+void disco_define_escalonamento(disco_t *self, disco_escalonamento_t escalonamento)
+{
+  self->escalonamento = escalonamento;
+}
+
+disco_escalonamento_t disco_escalonamento(char *nome)
+{
+  for (int e = 0; e < N_DISCO_ESCALONAMENTO; e++) {
+    if (strcmp(nome, nomes_escalonamento[e]) == 0) return e;
+  }
+  return N_DISCO_ESCALONAMENTO;
+}
+
+// ESCALONAMENTO {{{1
+
+static int trilha_da_pagina(int pagina)
+{
+  return pagina / DISCO_PAGINAS_POR_TRILHA;
+}
+
+// retorna o índice da pendente mais próxima da cabeça; se 'sentido' não for 0,
+//   só considera as que estão nesse sentido (ou na trilha atual); -1 se não tem
+// no empate fica a que chegou antes
+static int mais_proxima(disco_t *self, int sentido)
+{
+  int escolhida = -1;
+  int menor_dist = 0;
+  for (int i = 0; i < self->n_pendentes; i++) {
+    int delta = trilha_da_pagina(self->pendentes[i].pagina) - self->trilha;
+    if (delta * sentido < 0) continue;
+    int dist = abs(delta);
+    if (escolhida == -1 || dist < menor_dist) {
+      escolhida = i;
+      menor_dist = dist;
+    }
+  }
+  return escolhida;
+}
+
+// retorna o índice da próxima requisição pendente a atender
+static int escolhe_proxima(disco_t *self)
+{
+  switch (self->escalonamento) {
+    case DISCO_SSTF:
+      return mais_proxima(self, 0);
+    case DISCO_ELEVADOR: {
+      int i = mais_proxima(self, self->subindo ? 1 : -1);
+      if (i != -1) return i;
+      self->subindo = !self->subindo;
+      return mais_proxima(self, self->subindo ? 1 : -1);
+    }
+    default:
+      return 0;
+  }
+}
+
+// ATENDIMENTO {{{1
+
+// começa a atender a próxima requisição pendente, se tiver; 'em_seguida' diz se
+//   o disco acabou de terminar outra (senão estava parado, girando)
+static void inicia_proxima(disco_t *self, bool em_seguida)
+{
+  if (self->ocupado || self->n_pendentes == 0) return;
+
+  int i = escolhe_proxima(self);
+  self->atual = self->pendentes[i];
+  self->n_pendentes--;
+  memmove(&self->pendentes[i], &self->pendentes[i + 1],
+          (self->n_pendentes - i) * sizeof(*self->pendentes));
+
+  int destino = trilha_da_pagina(self->atual.pagina);
+  int dist = abs(destino - self->trilha);
+  self->trilhas_percorridas += dist;
+  self->trilha = destino;
+  self->t_ate_conclusao = dist * DISCO_TEMPO_POR_TRILHA + DISCO_TEMPO_TRANSFERENCIA;
+  // a página seguinte à última acessada, na mesma trilha, passa sob a cabeça
+  //   logo em seguida, sem esperar a rotação
+  if (!em_seguida || dist != 0 || self->atual.pagina != self->ultima_pagina + 1) {
+    self->t_ate_conclusao += DISCO_TEMPO_LATENCIA;
+  }
+  self->ultima_pagina = self->atual.pagina;
+  self->ocupado = true;
+}
+
+// termina a requisição em atendimento; uma leitura tem a página copiada para
+//   o quadro e vai para a lista de concluídas
+static void conclui_atual(disco_t *self)
+{
+  self->ocupado = false;
+  self->atendidas++;
+  if (self->atual.operacao != DISCO_LE) return;
+
+  // os endereços foram validados na chegada da requisição
+  mem_copia(self->mem_princ, END_DA_PAGINA(self->atual.quadro),
+            self->mem_sec, END_DA_PAGINA(self->atual.pagina), TAM_PAGINA);
+  if (self->n_concluidas == self->cap_concluidas) {
+    self->cap_concluidas *= 2;
+    self->concluidas = realloc(self->concluidas,
+                               self->cap_concluidas * sizeof(*self->concluidas));
+    assert(self->concluidas != NULL);
+  }
+  self->concluidas[self->n_concluidas++] = self->atual.quadro;
+}
+
+void disco_avanca(disco_t *self, int n)
+{
+  // pode concluir mais de uma requisição nesses n tics
+  while (self->ocupado && n > 0) {
+    if (self->t_ate_conclusao > n) {
+      self->t_ate_conclusao -= n;
+      break;
+    }
+    n -= self->t_ate_conclusao;
+    conclui_atual(self);
+    inicia_proxima(self, true);
+  }
+}
+
+int disco_tempo_ate_conclusao(disco_t *self)
+{
+  return self->ocupado ? self->t_ate_conclusao : 0;
+}
+
+// coloca na fila uma requisição com os registradores de página e quadro
+static err_t disco_requisita(disco_t *self, int operacao)
+{
+  if (operacao != DISCO_LE && operacao != DISCO_ESCREVE) return ERR_OP_INV;
+  int end_sec = END_DA_PAGINA(self->pagina);
+  int end_princ = END_DA_PAGINA(self->quadro);
+  if (self->pagina < 0 || end_sec + TAM_PAGINA > mem_tam(self->mem_sec)
+      || self->quadro < 0 || end_princ + TAM_PAGINA > mem_tam(self->mem_princ)) {
+    return ERR_END_INV;
+  }
+
+  // a escrita copia o quadro na chegada (ver disco.h)
+  if (operacao == DISCO_ESCREVE) {
+    mem_copia(self->mem_sec, end_sec, self->mem_princ, end_princ, TAM_PAGINA);
+  }
+
+  if (self->n_pendentes == self->cap_pendentes) {
+    self->cap_pendentes *= 2;
+    self->pendentes = realloc(self->pendentes,
+                              self->cap_pendentes * sizeof(*self->pendentes));
+    assert(self->pendentes != NULL);
+  }
+  self->pendentes[self->n_pendentes++] = (requisicao_t){
+    .operacao = operacao, .pagina = self->pagina, .quadro = self->quadro,
+  };
+  inicia_proxima(self, false);
+  return ERR_OK;
+}
+
+// retira da lista o quadro da leitura concluída mais antiga, -1 se não tem
+static int disco_retira_concluida(disco_t *self)
+{
+  if (self->n_concluidas == 0) return -1;
+  int quadro = self->concluidas[0];
+  self->n_concluidas--;
+  memmove(&self->concluidas[0], &self->concluidas[1],
+          self->n_concluidas * sizeof(*self->concluidas));
+  return quadro;
+}
+
+// E/S {{{1
+
+err_t disco_leitura(void *disp, int id, int *pvalor)
+{
+  disco_t *self = disp;
+  err_t err = ERR_OK;
+  switch (id) {
+    case 0:
+      *pvalor = self->pagina;
+      break;
+    case 1:
+      *pvalor = self->quadro;
+      break;
+    case 2:
+      *pvalor = self->n_pendentes + (self->ocupado ? 1 : 0);
+      break;
+    case 3:
+      *pvalor = disco_retira_concluida(self);
+      break;
+    case 4:
+      *pvalor = self->n_concluidas > 0 ? 1 : 0;
+      break;
+    case 5:
+      *pvalor = self->atendidas;
+      break;
+    case 6:
+      *pvalor = self->trilhas_percorridas;
+      break;
+    default:
+      err = ERR_END_INV;
+  }
+  return err;
+}
+
+err_t disco_escrita(void *disp, int id, int valor)
+{
+  disco_t *self = disp;
+  err_t err = ERR_OK;
+  switch (id) {
+    case 0:
+      self->pagina = valor;
+      break;
+    case 1:
+      self->quadro = valor;
+      break;
+    case 2:
+      err = disco_requisita(self, valor);
+      break;
+    default:
+      err = ERR_END_INV;
+  }
+  return err;
+}
+
+// INSTANTÂNEO {{{1
+
+bool disco_salva(disco_t *self, FILE *arq)
+{
+  return inst_escreve_marca(arq, "DISC")
+         && inst_escreve_int(arq, self->escalonamento)
+         && inst_escreve_int(arq, self->pagina)
+         && inst_escreve_int(arq, self->quadro)
+         && inst_escreve_int(arq, self->n_pendentes)
+         && inst_escreve(arq, self->pendentes, self->n_pendentes * sizeof(*self->pendentes))
+         && inst_escreve_int(arq, self->ocupado)
+         && inst_escreve(arq, &self->atual, sizeof(self->atual))
+         && inst_escreve_int(arq, self->t_ate_conclusao)
+         && inst_escreve_int(arq, self->trilha)
+         && inst_escreve_int(arq, self->subindo)
+         && inst_escreve_int(arq, self->ultima_pagina)
+         && inst_escreve_int(arq, self->n_concluidas)
+         && inst_escreve(arq, self->concluidas, self->n_concluidas * sizeof(*self->concluidas))
+         && inst_escreve_int(arq, self->atendidas)
+         && inst_escreve_int(arq, self->trilhas_percorridas);
+}
+
+bool disco_restaura(disco_t *self, FILE *arq)
+{
+  int escalonamento, n_pendentes, ocupado, subindo, n_concluidas;
+  if (!inst_confere_marca(arq, "DISC")
+      || !inst_le_int(arq, &escalonamento)
+      || !inst_le_int(arq, &self->pagina)
+      || !inst_le_int(arq, &self->quadro)
+      || !inst_le_int(arq, &n_pendentes)
+      || escalonamento < 0 || escalonamento >= N_DISCO_ESCALONAMENTO
+      || n_pendentes < 0) {
+    return false;
+  }
+  self->escalonamento = escalonamento;
+  if (n_pendentes > self->cap_pendentes) {
+    self->cap_pendentes = n_pendentes;
+    self->pendentes = realloc(self->pendentes, self->cap_pendentes * sizeof(*self->pendentes));
+    assert(self->pendentes != NULL);
+  }
+  self->n_pendentes = n_pendentes;
+  if (!inst_le(arq, self->pendentes, n_pendentes * sizeof(*self->pendentes))
+      || !inst_le_int(arq, &ocupado)
+      || !inst_le(arq, &self->atual, sizeof(self->atual))
+      || !inst_le_int(arq, &self->t_ate_conclusao)
+      || !inst_le_int(arq, &self->trilha)
+      || !inst_le_int(arq, &subindo)
+      || !inst_le_int(arq, &self->ultima_pagina)
+      || !inst_le_int(arq, &n_concluidas)
+      || n_concluidas < 0) {
+    return false;
+  }
+  self->ocupado = ocupado;
+  self->subindo = subindo;
+  if (n_concluidas > self->cap_concluidas) {
+    self->cap_concluidas = n_concluidas;
+    self->concluidas = realloc(self->concluidas, self->cap_concluidas * sizeof(*self->concluidas));
+    assert(self->concluidas != NULL);
+  }
+  self->n_concluidas = n_concluidas;
+  return inst_le(arq, self->concluidas, n_concluidas * sizeof(*self->concluidas))
+         && inst_le_int(arq, &self->atendidas)
+         && inst_le_int(arq, &self->trilhas_percorridas);
+}
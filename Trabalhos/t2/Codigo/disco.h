@@ -0,0 +1,103 @@
+// disco.h
+// dispositivo de E/S que transfere páginas entre a memória secundária e a principal
+// simulador de computador
+// so24b
+
+#ifndef DISCO_H
+#define DISCO_H
+
+// simulador de um disco com controladora de acesso direto à memória
+// as requisições de transferência de uma página (leitura: da memória secundária
+//   para um quadro da principal; escrita: de um quadro para a secundária) entram
+//   numa fila, e são atendidas uma por vez à medida que o tempo passa
+// o tempo de atendimento de uma requisição depende de onde a cabeça está:
+//   posicionamento (proporcional à distância em trilhas) + latência rotacional
+//   + transferência da página; a página seguinte à última acessada, na mesma
+//   trilha e sem o disco parar entre as duas, não espera a rotação (acesso
+//   sequencial)
+// quando uma leitura termina, o quadro em que ela foi feita entra na lista de
+//   concluídas e o disco pede interrupção enquanto essa lista não estiver vazia
+// a escrita não gera interrupção: a controladora copia o quadro para o seu buffer
+//   (e dele para a memória secundária) quando recebe a requisição, então o quadro
+//   pode ser reutilizado logo em seguida; o disco fica ocupado pelo tempo da
+//   escrita do mesmo jeito
+
+#include "err.h"
+#include "memoria.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// custos, em unidades de tempo (instruções)
+#ifndef DISCO_PAGINAS_POR_TRILHA
+#define DISCO_PAGINAS_POR_TRILHA 10
+#endif
+#ifndef DISCO_TEMPO_POR_TRILHA
+#define DISCO_TEMPO_POR_TRILHA 1 // posicionamento, por trilha percorrida
+#endif
+#ifndef DISCO_TEMPO_LATENCIA
+#define DISCO_TEMPO_LATENCIA 5 // espera pela rotação, a cada acesso
+#endif
+#ifndef DISCO_TEMPO_TRANSFERENCIA
+#define DISCO_TEMPO_TRANSFERENCIA 8 // transferência de uma página
+#endif
+
+// operações, escritas no dispositivo de comando
+typedef enum {
+  DISCO_LE = 0,      // memória secundária -> memória principal
+  DISCO_ESCREVE = 1, // memória principal -> memória secundária
+} disco_operacao_t;
+
+// ordem de atendimento das requisições pendentes
+typedef enum {
+  DISCO_FCFS,     // ordem de chegada
+  DISCO_SSTF,     // menor distância da posição atual da cabeça
+  DISCO_ELEVADOR, // segue numa direção enquanto tiver requisição nela, depois inverte
+  N_DISCO_ESCALONAMENTO
+} disco_escalonamento_t;
+
+typedef struct disco_t disco_t;
+
+// cria um disco que transfere páginas entre 'mem_sec' (a memória secundária)
+//   e 'mem_princ' (a memória principal)
+disco_t *disco_cria(mem_t *mem_sec, mem_t *mem_princ);
+
+// destrói um disco (as memórias não são destruídas)
+void disco_destroi(disco_t *self);
+
+// altera a ordem de atendimento das próximas requisições
+void disco_define_escalonamento(disco_t *self, disco_escalonamento_t escalonamento);
+
+// retorna o escalonamento com o nome dado ("fcfs", "sstf" ou "elevador"),
+//   ou N_DISCO_ESCALONAMENTO se não existir
+disco_escalonamento_t disco_escalonamento(char *nome);
+
+// registra a passagem de 'n' unidades de tempo
+// esta função é chamada pelo controlador depois de executar instruções
+void disco_avanca(disco_t *self, int n);
+
+// retorna em quanto tempo termina a requisição em atendimento, 0 se o disco
+//   está parado (usado pelo controlador para não passar do fim dela numa rajada)
+int disco_tempo_ate_conclusao(disco_t *self);
+
+// Funções para acessar o disco como dispositivo de E/S, com id:
+//   '0' para ler ou escrever a página da memória secundária da próxima requisição
+//   '1' para ler ou escrever o quadro da memória principal da próxima requisição
+//   '2' para escrever uma operação (disco_operacao_t), que coloca a requisição
+//       na fila; a leitura retorna o número de requisições pendentes
+//   '3' para ler (e retirar da lista) o quadro de uma leitura concluída, -1 se
+//       não tiver
+//   '4' para ler se uma interrupção está sendo pedida (tem leitura concluída)
+//   '5' para ler o número de requisições atendidas até agora
+//   '6' para ler o número de trilhas percorridas pela cabeça até agora
+// Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h
+err_t disco_leitura(void *disp, int id, int *pvalor);
+err_t disco_escrita(void *disp, int id, int valor);
+
+// grava no arquivo 'arq' o estado do disco: requisições pendentes, em
+//   atendimento e concluídas, posição da cabeça e estatísticas (ver
+//   instantaneo.h); as memórias são gravadas à parte
+bool disco_salva(disco_t *self, FILE *arq);
+// recupera o estado gravado por disco_salva
+bool disco_restaura(disco_t *self, FILE *arq);
+
+#endif // DISCO_H
@@ -27,6 +27,13 @@ typedef enum {
   D_RELOGIO_REAL          = 17,
   D_RELOGIO_TIMER         = 18,
   D_RELOGIO_INTERRUPCAO   = 19,
+  D_DISCO_PAGINA          = 20,
+  D_DISCO_QUADRO          = 21,
+  D_DISCO_COMANDO         = 22,
+  D_DISCO_CONCLUIDA       = 23,
+  D_DISCO_INTERRUPCAO     = 24,
+  D_DISCO_ATENDIDAS       = 25,
+  D_DISCO_TRILHAS         = 26,
   N_DISPOSITIVOS
 } dispositivo_id_t;
 
@@ -4,6 +4,7 @@
 // so24b
 
 #include "es.h"
+#include "instantaneo.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -67,3 +68,37 @@ err_t es_escreve(es_t *self, dispositivo_id_t dispositivo, int valor)
   int id = self->dispositivos[dispositivo].id;
   return self->dispositivos[dispositivo].f_escrita(controladora, id, valor);
 }
+
+// os dispositivos são registrados por quem cria o controlador, com ponteiros
+//   para funções e controladoras que não têm como ser gravados; é gravado só
+//   que dispositivos existem e com que id, para a restauração conferir se o
+//   controlador foi montado do mesmo jeito
+bool es_salva(es_t *self, FILE *arq)
+{
+  if (!inst_escreve_marca(arq, "ES  ") || !inst_escreve_int(arq, N_DISPOSITIVOS)) {
+    return false;
+  }
+  for (int d = 0; d < N_DISPOSITIVOS; d++) {
+    dispositivo_t *disp = &self->dispositivos[d];
+    int operacoes = (disp->f_leitura != NULL) | (disp->f_escrita != NULL) << 1;
+    if (!inst_escreve_int(arq, operacoes) || !inst_escreve_int(arq, disp->id)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool es_restaura(es_t *self, FILE *arq)
+{
+  if (!inst_confere_marca(arq, "ES  ") || !inst_confere_int(arq, N_DISPOSITIVOS)) {
+    return false;
+  }
+  for (int d = 0; d < N_DISPOSITIVOS; d++) {
+    dispositivo_t *disp = &self->dispositivos[d];
+    int operacoes = (disp->f_leitura != NULL) | (disp->f_escrita != NULL) << 1;
+    if (!inst_confere_int(arq, operacoes) || !inst_confere_int(arq, disp->id)) {
+      return false;
+    }
+  }
+  return true;
+}
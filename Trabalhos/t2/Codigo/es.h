@@ -10,6 +10,7 @@
 #include "dispositivos.h"
 
 #include <stdbool.h>
+#include <stdio.h>
 
 typedef struct es_t es_t; // declara o tipo como sendo uma estrutura opaca
 
@@ -56,4 +57,12 @@ err_t es_le(es_t *self, dispositivo_id_t dispositivo, int *pvalor);
 //   ERR_OP_INV se operação inválida
 err_t es_escreve(es_t *self, dispositivo_id_t dispositivo, int valor);
 
+// grava no arquivo 'arq' quais dispositivos estão registrados (ver
+//   instantaneo.h); as funções e controladoras não são gravadas
+bool es_salva(es_t *self, FILE *arq);
+
+// confere se os dispositivos registrados são os mesmos gravados por es_salva
+//   (o controlador deve ter sido montado antes, com es_registra_dispositivo)
+bool es_restaura(es_t *self, FILE *arq);
+
 #endif // ES_H
@@ -1,80 +1,192 @@
 #include "fila_processos.h"
 #include "console.h"
+#include "instantaneo.h"
 #include <stdio.h>
 #include <stdlib.h>
 
 #define FILA_PROCESSOS_INICIAL 5
 #define FATOR_CRESCIMENTO_FILA 2
 
+// A fila é intrusiva: o encadeamento (anterior, próximo e a fila a que o
+// processo pertence) fica no próprio descritor do processo. Com isso um
+// processo está em no máximo uma fila, e pode ser removido de qualquer
+// posição em tempo constante.
+// A fila de prioridade é um heap binário (mínimo) em um vetor, ordenado por
+// uma chave do processo (a prioridade ou o tempo de desbloqueio) e, em caso
+// de empate, pela ordem de chegada. A posição de cada processo no vetor fica
+// no descritor, para remoção e reposicionamento em tempo logarítmico.
 struct fila_processos
 {
-    processo_t **elementos;
-    int capacidade;
-    int inicio;
-    int fim;
+    // fila simples
+    processo_t *primeiro;
+    processo_t *ultimo;
     int quantidade;
+
+    // fila de prioridade
+    bool por_prioridade;
+    double (*chave)(processo_t *processo);
+    processo_t **heap;
+    int capacidade;
+    long prox_ordem;
 };
 
-static bool fila_processos_redimensiona(fila_processos_t *fila)
+fila_processos_t *fila_processos_cria()
 {
-    int nova_capacidade = fila->capacidade * FATOR_CRESCIMENTO_FILA;
-    processo_t **novo_elementos = realloc(fila->elementos, nova_capacidade * sizeof(processo_t *));
-
-    if (novo_elementos == NULL)
-        return false;
+    fila_processos_t *fila = malloc(sizeof(fila_processos_t));
+    if (fila == NULL)
+        return NULL;
 
-    // Reorganiza os elementos para manter a ordem lógica
-    if (fila->inicio > fila->fim) {
-        for (int i = 0; i < fila->quantidade; i++) {
-            novo_elementos[i] = novo_elementos[(fila->inicio + i) % fila->capacidade];
-        }
-    }
+    fila->primeiro = NULL;
+    fila->ultimo = NULL;
+    fila->quantidade = 0;
 
-    fila->elementos = novo_elementos;
-    fila->inicio = 0;
-    fila->fim = fila->quantidade;
-    fila->capacidade = nova_capacidade;
+    fila->por_prioridade = false;
+    fila->chave = NULL;
+    fila->heap = NULL;
+    fila->capacidade = 0;
+    fila->prox_ordem = 0;
 
-    return true;
+    return fila;
 }
 
-fila_processos_t *fila_processos_cria()
+static double chave_prioridade(processo_t *processo) { return processo_get_prioridade(processo); }
+
+static fila_processos_t *fila_processos_cria_heap(double (*chave)(processo_t *processo))
 {
-    fila_processos_t *fila = malloc(sizeof(fila_processos_t));
+    fila_processos_t *fila = fila_processos_cria();
     if (fila == NULL)
         return NULL;
 
-    fila->elementos = malloc(FILA_PROCESSOS_INICIAL * sizeof(processo_t *));
-    if (fila->elementos == NULL) {
+    fila->heap = malloc(FILA_PROCESSOS_INICIAL * sizeof(processo_t *));
+    if (fila->heap == NULL) {
         free(fila);
         return NULL;
     }
-
+    fila->por_prioridade = true;
+    fila->chave = chave;
     fila->capacidade = FILA_PROCESSOS_INICIAL;
-    fila->inicio = 0;
-    fila->fim = 0;
-    fila->quantidade = 0;
 
     return fila;
 }
 
+fila_processos_t *fila_processos_cria_prioridade() { return fila_processos_cria_heap(chave_prioridade); }
+
 void fila_processos_destroi(fila_processos_t *fila)
 {
     if (fila != NULL) {
-        free(fila->elementos);
+        // Os processos não pertencem à fila, só são desencadeados
+        while (fila_processos_remove(fila) != NULL)
+            ;
+        free(fila->heap);
         free(fila);
     }
 }
 
-bool fila_processos_insere(fila_processos_t *fila, processo_t *processo)
+// HEAP
+
+// Retorna true se 'a' deve sair da fila antes de 'b'
+static bool heap_antes(fila_processos_t *fila, processo_t *a, processo_t *b)
+{
+    double ca = fila->chave(a);
+    double cb = fila->chave(b);
+    if (ca != cb)
+        return ca < cb;
+    return processo_get_ordem_fila(a) < processo_get_ordem_fila(b);
+}
+
+static void heap_coloca(fila_processos_t *fila, int pos, processo_t *processo)
+{
+    fila->heap[pos] = processo;
+    processo_set_pos_fila(processo, pos);
+}
+
+// Sobe o processo da posição 'pos' até o lugar dele
+static void heap_sobe(fila_processos_t *fila, int pos)
+{
+    processo_t *processo = fila->heap[pos];
+    while (pos > 0) {
+        int pai = (pos - 1) / 2;
+        if (!heap_antes(fila, processo, fila->heap[pai]))
+            break;
+        heap_coloca(fila, pos, fila->heap[pai]);
+        pos = pai;
+    }
+    heap_coloca(fila, pos, processo);
+}
+
+// Desce o processo da posição 'pos' até o lugar dele
+static void heap_desce(fila_processos_t *fila, int pos)
+{
+    processo_t *processo = fila->heap[pos];
+    for (;;) {
+        int filho = 2 * pos + 1;
+        if (filho >= fila->quantidade)
+            break;
+        if (filho + 1 < fila->quantidade && heap_antes(fila, fila->heap[filho + 1], fila->heap[filho]))
+            filho++;
+        if (!heap_antes(fila, fila->heap[filho], processo))
+            break;
+        heap_coloca(fila, pos, fila->heap[filho]);
+        pos = filho;
+    }
+    heap_coloca(fila, pos, processo);
+}
+
+static bool heap_insere(fila_processos_t *fila, processo_t *processo)
 {
     if (fila->quantidade == fila->capacidade) {
-        if (!fila_processos_redimensiona(fila))
+        int nova_capacidade = fila->capacidade * FATOR_CRESCIMENTO_FILA;
+        processo_t **novo_heap = realloc(fila->heap, nova_capacidade * sizeof(processo_t *));
+        if (novo_heap == NULL)
             return false;
+        fila->heap = novo_heap;
+        fila->capacidade = nova_capacidade;
     }
 
-    fila->elementos[fila->fim] = processo;
-    fila->fim = (fila->fim + 1) % fila->capacidade;
+    processo_set_fila(processo, fila);
+    processo_set_ordem_fila(processo, fila->prox_ordem++);
+    heap_coloca(fila, fila->quantidade, processo);
+    fila->quantidade++;
+    heap_sobe(fila, fila->quantidade - 1);
+
+    return true;
+}
+
+static void heap_deleta(fila_processos_t *fila, processo_t *processo)
+{
+    int pos = processo_get_pos_fila(processo);
+    fila->quantidade--;
+    if (pos != fila->quantidade) {
+        // O último ocupa o lugar do removido, e pode ter que subir ou descer
+        processo_t *ultimo = fila->heap[fila->quantidade];
+        heap_coloca(fila, pos, ultimo);
+        heap_sobe(fila, pos);
+        heap_desce(fila, processo_get_pos_fila(ultimo));
+    }
+    processo_set_fila(processo, NULL);
+}
+
+// OPERAÇÕES
+
+bool fila_processos_insere(fila_processos_t *fila, processo_t *processo)
+{
+    // Um processo só pode estar em uma fila
+    if (processo_get_fila(processo) != NULL)
+        return false;
+
+    if (fila->por_prioridade)
+        return heap_insere(fila, processo);
+
+    processo_set_fila(processo, fila);
+    processo_set_ant(processo, fila->ultimo);
+    processo_set_prox(processo, NULL);
+
+    if (fila->ultimo != NULL) {
+        processo_set_prox(fila->ultimo, processo);
+    } else {
+        fila->primeiro = processo;
+    }
+    fila->ultimo = processo;
     fila->quantidade++;
 
     return true;
@@ -82,21 +194,19 @@ bool fila_processos_insere(fila_processos_t *fila, processo_t *processo)
 
 processo_t *fila_processos_remove(fila_processos_t *fila)
 {
-    if (fila->quantidade == 0)
+    processo_t *processo = fila_processos_primeiro(fila);
+    if (processo == NULL)
         return NULL;
 
-    processo_t *processo = fila->elementos[fila->inicio];
-    fila->inicio = (fila->inicio + 1) % fila->capacidade;
-    fila->quantidade--;
-
+    fila_processos_deleta_processo(fila, processo);
     return processo;
 }
 
 processo_t *fila_processos_primeiro(fila_processos_t *fila)
 {
-    if (fila->quantidade == 0)
-        return NULL;
-    return fila->elementos[fila->inicio];
+    if (fila->por_prioridade)
+        return fila->quantidade > 0 ? fila->heap[0] : NULL;
+    return fila->primeiro;
 }
 
 bool fila_processos_vazia(fila_processos_t *fila) { return fila->quantidade == 0; }
@@ -105,59 +215,123 @@ int fila_processos_tamanho(fila_processos_t *fila) { return fila->quantidade; }
 
 bool fila_processos_deleta_processo(fila_processos_t *fila, processo_t *processo_a_deletar)
 {
-    if (fila_processos_vazia(fila)) {
+    // O processo não está nesta fila
+    if (processo_get_fila(processo_a_deletar) != fila) {
         return false;
     }
 
-    // Encontrar o índice do processo a ser deletado
-    int indice = -1;
-    for (int i = 0; i < fila->quantidade; i++) {
-        int indice_real = (fila->inicio + i) % fila->capacidade;
-        if (fila->elementos[indice_real] == processo_a_deletar) {
-            indice = indice_real;
-            break;
-        }
+    if (fila->por_prioridade) {
+        heap_deleta(fila, processo_a_deletar);
+        return true;
     }
 
-    // Se o processo não foi encontrado
-    if (indice == -1) {
-        return false;
-    }
+    processo_t *ant = processo_get_ant(processo_a_deletar);
+    processo_t *prox = processo_get_prox(processo_a_deletar);
 
-    // Deslocar elementos para cobrir o espaço do processo deletado
-    for (int i = indice; i != fila->fim; i = (i + 1) % fila->capacidade) {
-        int proximo = (i + 1) % fila->capacidade;
-        fila->elementos[i] = fila->elementos[proximo];
+    if (ant != NULL) {
+        processo_set_prox(ant, prox);
+    } else {
+        fila->primeiro = prox;
+    }
+    if (prox != NULL) {
+        processo_set_ant(prox, ant);
+    } else {
+        fila->ultimo = ant;
     }
 
-    // Ajustar o fim e a quantidade
-    fila->fim = (fila->fim - 1 + fila->capacidade) % fila->capacidade;
+    processo_set_ant(processo_a_deletar, NULL);
+    processo_set_prox(processo_a_deletar, NULL);
+    processo_set_fila(processo_a_deletar, NULL);
     fila->quantidade--;
 
     return true;
 }
 
-// Ordem crescente de prioridade (menor valor = maior prioridade)
-void fila_processos_ordena_prioridade(fila_processos_t *fila)
+bool fila_processos_atualiza_prioridade(fila_processos_t *fila, processo_t *processo)
 {
-    if (fila == NULL || fila->quantidade <= 1)
-        return; // Fila vazia ou com um único elemento, já está ordenada.
+    if (processo_get_fila(processo) != fila) {
+        return false;
+    }
+
+    if (!fila->por_prioridade) {
+        // Na fila simples, só vai para o fim
+        fila_processos_deleta_processo(fila, processo);
+        return fila_processos_insere(fila, processo);
+    }
 
-    int total = fila->quantidade;
-    for (int i = 0; i < total - 1; i++) {
-        for (int j = 0; j < total - i - 1; j++) {
-            int indice_atual = (fila->inicio + j) % fila->capacidade;
-            int indice_proximo = (fila->inicio + j + 1) % fila->capacidade;
+    // Passa a ser o último a chegar, e sobe ou desce conforme a nova prioridade
+    int pos = processo_get_pos_fila(processo);
+    processo_set_ordem_fila(processo, fila->prox_ordem++);
+    heap_sobe(fila, pos);
+    heap_desce(fila, processo_get_pos_fila(processo));
+    return true;
+}
+
+// INSTANTÂNEO
 
-            processo_t *proc_atual = fila->elementos[indice_atual];
-            if (processo_get_prioridade(proc_atual) > processo_get_prioridade(proc_atual)) {
-                // Trocar os processos de posição
-                processo_t *temp = fila->elementos[indice_atual];
-                fila->elementos[indice_atual] = fila->elementos[indice_proximo];
-                fila->elementos[indice_proximo] = temp;
-            }
+// Grava os pids na ordem da fila (a do vetor, na de prioridade, com a ordem de
+// chegada de cada um), para que a fila restaurada seja igual e não só equivalente
+bool fila_processos_salva(fila_processos_t *fila, FILE *arq)
+{
+    if (!inst_escreve_marca(arq, "FILA") || !inst_escreve_int(arq, fila->quantidade) ||
+        !inst_escreve(arq, &fila->prox_ordem, sizeof(fila->prox_ordem)))
+        return false;
+    processo_t *proc = fila->primeiro;
+    for (int i = 0; i < fila->quantidade; i++) {
+        if (fila->por_prioridade) {
+            proc = fila->heap[i];
+            long ordem = processo_get_ordem_fila(proc);
+            if (!inst_escreve(arq, &ordem, sizeof(ordem)))
+                return false;
+        }
+        if (!inst_escreve_int(arq, processo_get_pid(proc)))
+            return false;
+        if (!fila->por_prioridade) {
+            proc = processo_get_prox(proc);
         }
     }
+    return true;
+}
+
+bool fila_processos_restaura(fila_processos_t *fila, FILE *arq, processo_t **tabela_processos, int n_processos)
+{
+    int quantidade;
+    long prox_ordem;
+    if (!fila_processos_vazia(fila) || !inst_confere_marca(arq, "FILA") || !inst_le_int(arq, &quantidade) ||
+        !inst_le(arq, &prox_ordem, sizeof(prox_ordem)))
+        return false;
+    for (int i = 0; i < quantidade; i++) {
+        long ordem = 0;
+        int pid;
+        if (fila->por_prioridade && !inst_le(arq, &ordem, sizeof(ordem)))
+            return false;
+        if (!inst_le_int(arq, &pid) || pid < 1 || pid > n_processos)
+            return false;
+        processo_t *proc = tabela_processos[pid - 1];
+        if (proc == NULL)
+            return false;
+        if (!fila->por_prioridade) {
+            if (!fila_processos_insere(fila, proc))
+                return false;
+            continue;
+        }
+        // Cada um volta para a mesma posição do vetor, que já era um heap
+        if (processo_get_fila(proc) != NULL)
+            return false;
+        if (fila->quantidade == fila->capacidade) {
+            int nova_capacidade = fila->capacidade * FATOR_CRESCIMENTO_FILA;
+            processo_t **novo_heap = realloc(fila->heap, nova_capacidade * sizeof(processo_t *));
+            if (novo_heap == NULL)
+                return false;
+            fila->heap = novo_heap;
+            fila->capacidade = nova_capacidade;
+        }
+        processo_set_fila(proc, fila);
+        processo_set_ordem_fila(proc, ordem);
+        heap_coloca(fila, fila->quantidade++, proc);
+    }
+    fila->prox_ordem = prox_ordem;
+    return true;
 }
 
 void debug_fila_processos(fila_processos_t *fila)
@@ -167,19 +341,20 @@ void debug_fila_processos(fila_processos_t *fila)
         console_printf("Fila vazia ou não inicializada.\n");
         return;
     }
+    // A fila de prioridade é mostrada na ordem do heap, não na ordem de saída
+    processo_t *proc = fila_processos_primeiro(fila);
     for (int i = 0; i < fila->quantidade; i++) {
-        int indice = (fila->inicio + i) % fila->capacidade;
-        processo_t *proc = fila->elementos[indice];
-        if (proc != NULL) {
-            console_printf("Posição: %d | PID: %d | Estado: %s | PC: %d | Reg A: %d | Reg X: %d | Terminal: %d | "
-                           "Motivo Bloqueio: %s | Prioridade: %.2f\n",
-                           i, processo_get_pid(proc), processo_estado_para_string(processo_get_estado(proc)),
-                           processo_get_pc(proc), processo_get_reg_A(proc), processo_get_reg_X(proc),
-                           processo_get_terminal(proc), processo_motivo_para_string(processo_get_motivo_bloqueio(proc)),
-                           processo_get_prioridade(proc));
-
-        } else {
-            console_printf("Posição: %d | Vazia\n", i);
+        if (fila->por_prioridade) {
+            proc = fila->heap[i];
+        }
+        console_printf("Posição: %d | PID: %d | Estado: %s | PC: %d | Reg A: %d | Reg X: %d | Terminal: %d | "
+                       "Motivo Bloqueio: %s | Prioridade: %.2f\n",
+                       i, processo_get_pid(proc), processo_estado_para_string(processo_get_estado(proc)),
+                       processo_get_pc(proc), processo_get_reg_A(proc), processo_get_reg_X(proc),
+                       processo_get_terminal(proc), processo_motivo_para_string(processo_get_motivo_bloqueio(proc)),
+                       processo_get_prioridade(proc));
+        if (!fila->por_prioridade) {
+            proc = processo_get_prox(proc);
         }
     }
     console_printf("============================\n");
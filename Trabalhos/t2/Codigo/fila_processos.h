@@ -3,12 +3,16 @@
 
 #include "processo.h"
 #include <stdbool.h>
+#include <stdio.h>
 
 // Estrutura da fila de processos
 typedef struct fila_processos fila_processos_t;
 
 // Funções de criação e destruição
+// A fila simples é FIFO; a fila de prioridade entrega primeiro o processo de menor
+//   valor de prioridade e, entre iguais, o que chegou antes
 fila_processos_t *fila_processos_cria();
+fila_processos_t *fila_processos_cria_prioridade();
 void fila_processos_destroi(fila_processos_t *fila);
 
 // Operações básicas
@@ -22,7 +26,15 @@ int fila_processos_tamanho(fila_processos_t *fila);
 
 // Funções específicas
 bool fila_processos_deleta_processo(fila_processos_t *fila, processo_t *processo_a_deletar);
-void fila_processos_ordena_prioridade(fila_processos_t *fila);
+// Reposiciona o processo depois de uma mudança na sua prioridade, como se tivesse
+//   acabado de chegar (vai para depois dos de mesma prioridade)
+bool fila_processos_atualiza_prioridade(fila_processos_t *fila, processo_t *processo);
+
+// Instantâneo (ver instantaneo.h): grava os pids dos processos na fila; a
+//   restauração (numa fila vazia) os encadeia de volta, buscando-os na tabela
+//   de processos indexada pelo pid (o de pid p na posição p - 1)
+bool fila_processos_salva(fila_processos_t *fila, FILE *arq);
+bool fila_processos_restaura(fila_processos_t *fila, FILE *arq, processo_t **tabela_processos, int n_processos);
 
 // Funções de depuração
 void debug_fila_processos(fila_processos_t *fila);
@@ -1,9 +1,40 @@
 #include "gere_blocos.h"
 #include "console.h"
 #include "mmu.h"
+#include "instantaneo.h"
 #include <stdlib.h>
 
-#define ESPACO_CPU 10
+// quadros reservados para o hardware e o tratador de interrupção (endereços 0 a 99)
+#define ESPACO_CPU (PAGINA_DO_END(99) + 1)
+
+#define BITS_POR_PALAVRA 64
+
+// MAPA DE BITS
+
+static bool bloco_em_uso(gere_blocos_t *gerenciador, int indice)
+{
+    return (gerenciador->ocupados[indice / BITS_POR_PALAVRA] >> (indice % BITS_POR_PALAVRA)) & 1;
+}
+
+static void marca_em_uso(gere_blocos_t *gerenciador, int indice)
+{
+    if (bloco_em_uso(gerenciador, indice))
+        return;
+    gerenciador->ocupados[indice / BITS_POR_PALAVRA] |= (uint64_t)1 << (indice % BITS_POR_PALAVRA);
+    gerenciador->n_livres--;
+}
+
+static void marca_livre(gere_blocos_t *gerenciador, int indice)
+{
+    if (!bloco_em_uso(gerenciador, indice))
+        return;
+    int palavra = indice / BITS_POR_PALAVRA;
+    gerenciador->ocupados[palavra] &= ~((uint64_t)1 << (indice % BITS_POR_PALAVRA));
+    gerenciador->n_livres++;
+    if (palavra < gerenciador->primeira_palavra_livre) {
+        gerenciador->primeira_palavra_livre = palavra;
+    }
+}
 
 gere_blocos_t *gere_blocos_cria(int tam)
 {
@@ -20,52 +51,269 @@ gere_blocos_t *gere_blocos_cria(int tam)
         return NULL;
     }
 
+    gerenciador->n_palavras = (tam + BITS_POR_PALAVRA - 1) / BITS_POR_PALAVRA;
+    gerenciador->ocupados = calloc(gerenciador->n_palavras, sizeof(uint64_t));
+    if (!gerenciador->ocupados) {
+        console_printf("Erro ao alocar memória para o mapa de blocos.");
+        free(gerenciador->blocos);
+        free(gerenciador);
+        return NULL;
+    }
     gerenciador->total_blocos = tam;
+    gerenciador->n_livres = tam;
+    gerenciador->primeira_palavra_livre = 0;
+
+    gerenciador->primeiro_carga = -1;
+    gerenciador->ultimo_carga = -1;
+    gerenciador->n_carregados = 0;
+    gerenciador->n_reservados = 0;
+
     for (int i = 0; i < tam; i++) {
+        gerenciador->blocos[i].processo_pid = 0;
+        gerenciador->blocos[i].imagem = -1;
+        gerenciador->blocos[i].pagina = 0;
+        gerenciador->blocos[i].idade = 0;
+        gerenciador->blocos[i].acessada = false;
+        gerenciador->blocos[i].prebuscada = false;
+        gerenciador->blocos[i].reservas = NULL;
+        gerenciador->blocos[i].ant_carga = -1;
+        gerenciador->blocos[i].prox_carga = -1;
         if (i < ESPACO_CPU) {
-            gerenciador->blocos[i].em_uso = true;
-            continue;
+            marca_em_uso(gerenciador, i);
         }
-        gerenciador->blocos[i].em_uso = false;
-        gerenciador->blocos[i].processo_pid = 0;
+    }
+    // Os bits depois do último bloco nunca ficam livres
+    if (tam % BITS_POR_PALAVRA != 0) {
+        gerenciador->ocupados[gerenciador->n_palavras - 1] |= ~(uint64_t)0 << (tam % BITS_POR_PALAVRA);
     }
     return gerenciador;
 }
 
-bool gere_blocos_tem_disponivel(gere_blocos_t *gerenciador)
+void gere_blocos_destroi(gere_blocos_t *gerenciador)
 {
-    for (int i = 0; i < gerenciador->total_blocos; i++) {
-        if (!gerenciador->blocos[i].em_uso) {
-            return true;
-        }
+    if (gerenciador != NULL) {
+        free(gerenciador->ocupados);
+        free(gerenciador->blocos);
+        free(gerenciador);
     }
-
-    return false;
 }
 
+bool gere_blocos_tem_disponivel(gere_blocos_t *gerenciador) { return gerenciador->n_livres > 0; }
+
 int gere_blocos_buscar_proximo(gere_blocos_t *gerenciador)
 {
-    for (int i = 0; i < gerenciador->total_blocos; i++) {
-        if (!gerenciador->blocos[i].em_uso) {
-            gerenciador->blocos[i].em_uso = true;
-            return i;
-        }
+    if (gerenciador->n_livres == 0) {
+        return -1;
     }
 
-    return -1;
+    // As palavras antes de primeira_palavra_livre estão cheias
+    int palavra = gerenciador->primeira_palavra_livre;
+    while (gerenciador->ocupados[palavra] == ~(uint64_t)0) {
+        palavra++;
+    }
+    gerenciador->primeira_palavra_livre = palavra;
+
+    int indice = palavra * BITS_POR_PALAVRA + __builtin_ctzll(~gerenciador->ocupados[palavra]);
+    marca_em_uso(gerenciador, indice);
+    return indice;
 }
 
 void gere_blocos_cadastra_bloco(gere_blocos_t *gerenciador, int end_ini, int end_fim, int pid)
 {
     for (int address = 0; address < end_fim; address += TAM_PAGINA) {
-        gerenciador->blocos[address / TAM_PAGINA].em_uso = true;
-        gerenciador->blocos[address / TAM_PAGINA].processo_pid = pid;
+        marca_em_uso(gerenciador, PAGINA_DO_END(address));
+        gerenciador->blocos[PAGINA_DO_END(address)].processo_pid = pid;
+    }
+}
+
+// ORDEM DE CARGA
+
+static void insere_fim_carga(gere_blocos_t *gerenciador, int indice)
+{
+    bloco_t *bloco = &gerenciador->blocos[indice];
+    bloco->ant_carga = gerenciador->ultimo_carga;
+    bloco->prox_carga = -1;
+    if (gerenciador->ultimo_carga != -1) {
+        gerenciador->blocos[gerenciador->ultimo_carga].prox_carga = indice;
+    } else {
+        gerenciador->primeiro_carga = indice;
+    }
+    gerenciador->ultimo_carga = indice;
+    gerenciador->n_carregados++;
+}
+
+static void retira_carga(gere_blocos_t *gerenciador, int indice)
+{
+    bloco_t *bloco = &gerenciador->blocos[indice];
+    if (bloco->ant_carga != -1) {
+        gerenciador->blocos[bloco->ant_carga].prox_carga = bloco->prox_carga;
+    } else {
+        gerenciador->primeiro_carga = bloco->prox_carga;
+    }
+    if (bloco->prox_carga != -1) {
+        gerenciador->blocos[bloco->prox_carga].ant_carga = bloco->ant_carga;
+    } else {
+        gerenciador->ultimo_carga = bloco->ant_carga;
+    }
+    bloco->ant_carga = -1;
+    bloco->prox_carga = -1;
+    gerenciador->n_carregados--;
+}
+
+static bool na_ordem_carga(gere_blocos_t *gerenciador, int indice)
+{
+    return gerenciador->blocos[indice].ant_carga != -1 || gerenciador->primeiro_carga == indice;
+}
+
+// o bloco deixa de estar registrado no índice de reservas do dono
+static void retira_reserva(gere_blocos_t *gerenciador, int indice)
+{
+    bloco_t *bloco = &gerenciador->blocos[indice];
+    if (bloco->reservas != NULL) {
+        bloco->reservas[bloco->pagina] = -1;
+        bloco->reservas = NULL;
     }
 }
 
-void gere_blocos_atualiza_bloco(gere_blocos_t *gerenciador, int indice, int pid, int pagina)
+void gere_blocos_reserva_bloco(gere_blocos_t *gerenciador, int indice, int pid, int imagem, int pagina,
+                               int *reservas)
 {
-    gerenciador->blocos[indice].em_uso = true;
+    marca_em_uso(gerenciador, indice);
     gerenciador->blocos[indice].processo_pid = pid;
+    gerenciador->blocos[indice].imagem = imagem;
     gerenciador->blocos[indice].pagina = pagina;
+    gerenciador->blocos[indice].idade = 0;
+    gerenciador->blocos[indice].acessada = false;
+    gerenciador->blocos[indice].prebuscada = false;
+    gerenciador->n_reservados++;
+    gere_blocos_registra_reserva(gerenciador, indice, reservas);
+}
+
+void gere_blocos_registra_reserva(gere_blocos_t *gerenciador, int indice, int *reservas)
+{
+    bloco_t *bloco = &gerenciador->blocos[indice];
+    bloco->reservas = reservas;
+    if (reservas != NULL) {
+        reservas[bloco->pagina] = indice;
+    }
+}
+
+void gere_blocos_ativa_bloco(gere_blocos_t *gerenciador, int indice)
+{
+    if (na_ordem_carga(gerenciador, indice)) {
+        return;
+    }
+    gerenciador->n_reservados--;
+    retira_reserva(gerenciador, indice);
+    insere_fim_carga(gerenciador, indice);
+}
+
+bool gere_blocos_reservado(gere_blocos_t *gerenciador, int indice)
+{
+    return gerenciador->blocos[indice].processo_pid != 0 && !na_ordem_carga(gerenciador, indice);
+}
+
+void gere_blocos_libera_bloco(gere_blocos_t *gerenciador, int indice)
+{
+    // Só os blocos com páginas já carregadas estão na ordem de carga, os outros
+    //   com dono estão reservados
+    if (na_ordem_carga(gerenciador, indice)) {
+        retira_carga(gerenciador, indice);
+    } else if (gerenciador->blocos[indice].processo_pid != 0) {
+        gerenciador->n_reservados--;
+        retira_reserva(gerenciador, indice);
+    }
+    gerenciador->blocos[indice].processo_pid = 0;
+    gerenciador->blocos[indice].imagem = -1;
+    marca_livre(gerenciador, indice);
+}
+
+int gere_blocos_mais_antigo(gere_blocos_t *gerenciador) { return gerenciador->primeiro_carga; }
+
+int gere_blocos_proximo_carregado(gere_blocos_t *gerenciador, int indice)
+{
+    return gerenciador->blocos[indice].prox_carga;
+}
+
+void gere_blocos_renova_mais_antigo(gere_blocos_t *gerenciador)
+{
+    int indice = gere_blocos_mais_antigo(gerenciador);
+    if (indice == -1) {
+        return;
+    }
+    retira_carga(gerenciador, indice);
+    insere_fim_carga(gerenciador, indice);
+}
+
+void gere_blocos_libera_processo(gere_blocos_t *gerenciador, int pid)
+{
+    int indice = gerenciador->primeiro_carga;
+    while (indice != -1) {
+        int proximo = gerenciador->blocos[indice].prox_carga;
+        if (gerenciador->blocos[indice].processo_pid == pid && gerenciador->blocos[indice].imagem == -1) {
+            gere_blocos_libera_bloco(gerenciador, indice);
+        }
+        indice = proximo;
+    }
+}
+
+// INSTANTÂNEO
+
+// cada bloco é gravado campo a campo (a estrutura tem preenchimento, e o
+//   ponteiro para o índice de reservas não é gravado)
+static bool salva_bloco(bloco_t *bloco, FILE *arq)
+{
+    return inst_escreve_int(arq, bloco->processo_pid) && inst_escreve_int(arq, bloco->imagem) &&
+           inst_escreve_int(arq, bloco->pagina) && inst_escreve_int(arq, bloco->idade) &&
+           inst_escreve_int(arq, bloco->acessada) && inst_escreve_int(arq, bloco->prebuscada) &&
+           inst_escreve_int(arq, bloco->ant_carga) && inst_escreve_int(arq, bloco->prox_carga);
+}
+
+static bool restaura_bloco(bloco_t *bloco, FILE *arq)
+{
+    int idade, acessada, prebuscada;
+    if (!inst_le_int(arq, &bloco->processo_pid) || !inst_le_int(arq, &bloco->imagem) ||
+        !inst_le_int(arq, &bloco->pagina) || !inst_le_int(arq, &idade) || !inst_le_int(arq, &acessada) ||
+        !inst_le_int(arq, &prebuscada) || !inst_le_int(arq, &bloco->ant_carga) ||
+        !inst_le_int(arq, &bloco->prox_carga)) {
+        return false;
+    }
+    bloco->idade = idade;
+    bloco->acessada = acessada;
+    bloco->prebuscada = prebuscada;
+    // as reservas são reencadeadas pelo SO (ver gere_blocos_registra_reserva)
+    bloco->reservas = NULL;
+    return true;
+}
+
+bool gere_blocos_salva(gere_blocos_t *gerenciador, FILE *arq)
+{
+    if (!inst_escreve_marca(arq, "BLOC") || !inst_escreve_int(arq, gerenciador->total_blocos)) {
+        return false;
+    }
+    for (int i = 0; i < gerenciador->total_blocos; i++) {
+        if (!salva_bloco(&gerenciador->blocos[i], arq)) {
+            return false;
+        }
+    }
+    return inst_escreve(arq, gerenciador->ocupados, sizeof(uint64_t) * gerenciador->n_palavras) &&
+           inst_escreve_int(arq, gerenciador->n_livres) && inst_escreve_int(arq, gerenciador->primeira_palavra_livre) &&
+           inst_escreve_int(arq, gerenciador->primeiro_carga) && inst_escreve_int(arq, gerenciador->ultimo_carga) &&
+           inst_escreve_int(arq, gerenciador->n_carregados) && inst_escreve_int(arq, gerenciador->n_reservados);
+}
+
+bool gere_blocos_restaura(gere_blocos_t *gerenciador, FILE *arq)
+{
+    if (!inst_confere_marca(arq, "BLOC") || !inst_confere_int(arq, gerenciador->total_blocos)) {
+        return false;
+    }
+    for (int i = 0; i < gerenciador->total_blocos; i++) {
+        if (!restaura_bloco(&gerenciador->blocos[i], arq)) {
+            return false;
+        }
+    }
+    return inst_le(arq, gerenciador->ocupados, sizeof(uint64_t) * gerenciador->n_palavras) &&
+           inst_le_int(arq, &gerenciador->n_livres) && inst_le_int(arq, &gerenciador->primeira_palavra_livre) &&
+           inst_le_int(arq, &gerenciador->primeiro_carga) && inst_le_int(arq, &gerenciador->ultimo_carga) &&
+           inst_le_int(arq, &gerenciador->n_carregados) && inst_le_int(arq, &gerenciador->n_reservados);
 }
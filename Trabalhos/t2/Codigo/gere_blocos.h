@@ -2,12 +2,30 @@
 #define GERE_BLOCOS_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 
 typedef struct
 {
-    bool em_uso;
+    // dono da página; se ela é de uma imagem compartilhada, o processo que
+    //   pediu a carga
     int processo_pid;
+    // imagem compartilhada da página (ver imagens.h), -1 se é do processo
+    int imagem;
     int pagina;
+    // contador de envelhecimento (usado pelo algoritmo de substituição)
+    unsigned char idade;
+    // bit de acesso recolhido das tabelas de páginas a cada interrupção do relógio
+    //   (para o conjunto de trabalho), até o algoritmo de substituição zerá-lo
+    bool acessada;
+    // a página foi trazida por pré-busca e ainda não se sabe se foi usada
+    bool prebuscada;
+    // enquanto o bloco está reservado, índice por página do dono em que ele está
+    //   registrado (ver gere_blocos_reserva_bloco), NULL se não tem
+    int *reservas;
+    // encadeamento na ordem de carga (índices dos blocos, -1 no fim)
+    int ant_carga;
+    int prox_carga;
 } bloco_t;
 
 // rastreia memoria fisica principal
@@ -15,17 +33,68 @@ typedef struct gere_blocos_t
 {
     bloco_t *blocos;
     int total_blocos;
+    // um bit por bloco, 1 se o bloco está em uso
+    uint64_t *ocupados;
+    int n_palavras;
+    int n_livres;
+    // nenhuma palavra antes desta tem bloco livre
+    int primeira_palavra_livre;
+    // blocos ocupados por páginas de processos, na ordem em que foram carregados
+    //   (usada na escolha da página a substituir)
+    int primeiro_carga;
+    int ultimo_carga;
+    int n_carregados;
+    // blocos reservados para páginas que ainda estão sendo carregadas
+    int n_reservados;
 } gere_blocos_t;
 
 // recebe o numero de paginas fisicas rastreadas
 gere_blocos_t *gere_blocos_cria(int tam);
 
+void gere_blocos_destroi(gere_blocos_t *self);
+
 bool gere_blocos_tem_disponivel(gere_blocos_t *self);
 
+// marca como em uso e retorna o bloco livre de menor número, -1 se não houver
 int gere_blocos_buscar_proximo(gere_blocos_t *self);
 
-void gere_blocos_atualiza_bloco(gere_blocos_t *gerenciador, int indice, int pid, int pagina);
+// reserva o bloco para a página 'pagina' do processo 'pid' (ou da imagem 'imagem',
+//   se não for -1), que ainda está sendo carregada; o bloco não entra na ordem
+//   de carga (não pode ser substituído) até gere_blocos_ativa_bloco
+// se 'reservas' não for NULL, o bloco fica registrado em reservas[pagina] até
+//   ser ativado ou liberado (quando volta a -1)
+void gere_blocos_reserva_bloco(gere_blocos_t *gerenciador, int indice, int pid, int imagem, int pagina,
+                               int *reservas);
+
+// termina a carga do bloco reservado, que passa a ser o último na ordem de carga
+void gere_blocos_ativa_bloco(gere_blocos_t *gerenciador, int indice);
+
+// o bloco está reservado para uma página que ainda está sendo carregada
+bool gere_blocos_reservado(gere_blocos_t *gerenciador, int indice);
+
+// libera o bloco, que sai da ordem de carga
+void gere_blocos_libera_bloco(gere_blocos_t *gerenciador, int indice);
+
+// retorna o bloco carregado há mais tempo, -1 se não houver
+int gere_blocos_mais_antigo(gere_blocos_t *gerenciador);
+
+// retorna o bloco carregado depois de 'indice', -1 se for o último
+int gere_blocos_proximo_carregado(gere_blocos_t *gerenciador, int indice);
+
+// retira o bloco mais antigo da ordem de carga e o coloca no fim, como se tivesse
+//   acabado de ser carregado (segunda chance)
+void gere_blocos_renova_mais_antigo(gere_blocos_t *gerenciador);
+
+// libera todos os blocos com páginas privadas do processo 'pid'
+void gere_blocos_libera_processo(gere_blocos_t *gerenciador, int pid);
 
 void gere_blocos_cadastra_bloco(gere_blocos_t *gerenciador, int end_ini, int end_fim, int pid);
 
+// Instantâneo (ver instantaneo.h), num gerenciador criado com o mesmo tamanho
+// os índices das reservas não são gravados: quem restaura registra de novo cada
+//   bloco reservado com gere_blocos_registra_reserva
+bool gere_blocos_salva(gere_blocos_t *gerenciador, FILE *arq);
+bool gere_blocos_restaura(gere_blocos_t *gerenciador, FILE *arq);
+void gere_blocos_registra_reserva(gere_blocos_t *gerenciador, int indice, int *reservas);
+
 #endif // GERE_BLOCOS_H
@@ -0,0 +1,197 @@
+#include "gere_mem_sec.h"
+#include "console.h"
+#include "instantaneo.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXTENSOES_INICIAL 8
+#define FATOR_CRESCIMENTO_EXTENSOES 2
+
+gere_mem_sec_t *gere_mem_sec_cria(int total_paginas)
+{
+    gere_mem_sec_t *gerenciador = malloc(sizeof(gere_mem_sec_t));
+    if (!gerenciador) {
+        console_printf("Erro ao alocar memória para o gerenciador da memória secundária.");
+        return NULL;
+    }
+
+    gerenciador->livres = malloc(sizeof(extensao_t) * EXTENSOES_INICIAL);
+    if (!gerenciador->livres) {
+        console_printf("Erro ao alocar memória para as extensões livres.");
+        free(gerenciador);
+        return NULL;
+    }
+    gerenciador->capacidade = EXTENSOES_INICIAL;
+
+    // No início, tudo é uma única extensão livre
+    gerenciador->total_paginas = total_paginas;
+    gerenciador->livres[0].inicio = 0;
+    gerenciador->livres[0].n_paginas = total_paginas;
+    gerenciador->n_livres = total_paginas > 0 ? 1 : 0;
+
+    gerenciador->paginas_em_uso = 0;
+    gerenciador->pico_paginas_em_uso = 0;
+    gerenciador->pico_fragmentacao = 0;
+    return gerenciador;
+}
+
+void gere_mem_sec_destroi(gere_mem_sec_t *gerenciador)
+{
+    if (gerenciador != NULL) {
+        free(gerenciador->livres);
+        free(gerenciador);
+    }
+}
+
+// MÉTRICAS
+
+int gere_mem_sec_maior_livre(gere_mem_sec_t *gerenciador)
+{
+    int maior = 0;
+    for (int i = 0; i < gerenciador->n_livres; i++) {
+        if (gerenciador->livres[i].n_paginas > maior) {
+            maior = gerenciador->livres[i].n_paginas;
+        }
+    }
+    return maior;
+}
+
+float gere_mem_sec_fragmentacao(gere_mem_sec_t *gerenciador)
+{
+    int total_livre = gerenciador->total_paginas - gerenciador->paginas_em_uso;
+    if (total_livre == 0) {
+        return 0;
+    }
+    return 1 - (float)gere_mem_sec_maior_livre(gerenciador) / total_livre;
+}
+
+static void atualiza_metricas(gere_mem_sec_t *gerenciador)
+{
+    if (gerenciador->paginas_em_uso > gerenciador->pico_paginas_em_uso) {
+        gerenciador->pico_paginas_em_uso = gerenciador->paginas_em_uso;
+    }
+    float fragmentacao = gere_mem_sec_fragmentacao(gerenciador);
+    if (fragmentacao > gerenciador->pico_fragmentacao) {
+        gerenciador->pico_fragmentacao = fragmentacao;
+    }
+}
+
+// LISTA DE EXTENSÕES LIVRES
+
+static void remove_extensao(gere_mem_sec_t *gerenciador, int i)
+{
+    memmove(&gerenciador->livres[i], &gerenciador->livres[i + 1],
+            (gerenciador->n_livres - i - 1) * sizeof(extensao_t));
+    gerenciador->n_livres--;
+}
+
+static bool insere_extensao(gere_mem_sec_t *gerenciador, int i, int inicio, int n_paginas)
+{
+    if (gerenciador->n_livres == gerenciador->capacidade) {
+        int nova_capacidade = gerenciador->capacidade * FATOR_CRESCIMENTO_EXTENSOES;
+        extensao_t *novas = realloc(gerenciador->livres, nova_capacidade * sizeof(extensao_t));
+        if (novas == NULL) {
+            console_printf("Erro ao aumentar a lista de extensões livres.");
+            return false;
+        }
+        gerenciador->livres = novas;
+        gerenciador->capacidade = nova_capacidade;
+    }
+    memmove(&gerenciador->livres[i + 1], &gerenciador->livres[i],
+            (gerenciador->n_livres - i) * sizeof(extensao_t));
+    gerenciador->livres[i].inicio = inicio;
+    gerenciador->livres[i].n_paginas = n_paginas;
+    gerenciador->n_livres++;
+    return true;
+}
+
+// OPERAÇÕES
+
+int gere_mem_sec_aloca(gere_mem_sec_t *gerenciador, int n_paginas)
+{
+    for (int i = 0; i < gerenciador->n_livres; i++) {
+        extensao_t *extensao = &gerenciador->livres[i];
+        if (extensao->n_paginas < n_paginas) {
+            continue;
+        }
+
+        // Aloca do começo da extensão, o que sobra continua livre
+        int inicio = extensao->inicio;
+        extensao->inicio += n_paginas;
+        extensao->n_paginas -= n_paginas;
+        if (extensao->n_paginas == 0) {
+            remove_extensao(gerenciador, i);
+        }
+
+        gerenciador->paginas_em_uso += n_paginas;
+        atualiza_metricas(gerenciador);
+        return inicio;
+    }
+    return -1;
+}
+
+void gere_mem_sec_libera(gere_mem_sec_t *gerenciador, int inicio, int n_paginas)
+{
+    if (n_paginas <= 0) {
+        return;
+    }
+
+    // Posição da primeira extensão livre depois da liberada
+    int i = 0;
+    while (i < gerenciador->n_livres && gerenciador->livres[i].inicio < inicio) {
+        i++;
+    }
+
+    bool junta_anterior = i > 0 && gerenciador->livres[i - 1].inicio + gerenciador->livres[i - 1].n_paginas == inicio;
+    bool junta_seguinte = i < gerenciador->n_livres && inicio + n_paginas == gerenciador->livres[i].inicio;
+
+    if (junta_anterior && junta_seguinte) {
+        gerenciador->livres[i - 1].n_paginas += n_paginas + gerenciador->livres[i].n_paginas;
+        remove_extensao(gerenciador, i);
+    } else if (junta_anterior) {
+        gerenciador->livres[i - 1].n_paginas += n_paginas;
+    } else if (junta_seguinte) {
+        gerenciador->livres[i].inicio = inicio;
+        gerenciador->livres[i].n_paginas += n_paginas;
+    } else if (!insere_extensao(gerenciador, i, inicio, n_paginas)) {
+        // Sem memória para registrar a extensão, as páginas ficam perdidas
+        return;
+    }
+
+    gerenciador->paginas_em_uso -= n_paginas;
+    atualiza_metricas(gerenciador);
+}
+
+// INSTANTÂNEO
+
+bool gere_mem_sec_salva(gere_mem_sec_t *gerenciador, FILE *arq)
+{
+    return inst_escreve_marca(arq, "MSEC") && inst_escreve_int(arq, gerenciador->total_paginas) &&
+           inst_escreve_int(arq, gerenciador->n_livres) &&
+           inst_escreve(arq, gerenciador->livres, sizeof(extensao_t) * gerenciador->n_livres) &&
+           inst_escreve_int(arq, gerenciador->paginas_em_uso) &&
+           inst_escreve_int(arq, gerenciador->pico_paginas_em_uso) &&
+           inst_escreve(arq, &gerenciador->pico_fragmentacao, sizeof(gerenciador->pico_fragmentacao));
+}
+
+bool gere_mem_sec_restaura(gere_mem_sec_t *gerenciador, FILE *arq)
+{
+    int n_livres;
+    if (!inst_confere_marca(arq, "MSEC") || !inst_confere_int(arq, gerenciador->total_paginas) ||
+        !inst_le_int(arq, &n_livres) || n_livres < 0)
+        return false;
+    if (n_livres > gerenciador->capacidade) {
+        extensao_t *novas = realloc(gerenciador->livres, sizeof(extensao_t) * n_livres);
+        if (!novas) {
+            console_printf("Erro ao alocar memória para as extensões livres.");
+            return false;
+        }
+        gerenciador->livres = novas;
+        gerenciador->capacidade = n_livres;
+    }
+    gerenciador->n_livres = n_livres;
+    return inst_le(arq, gerenciador->livres, sizeof(extensao_t) * n_livres) &&
+           inst_le_int(arq, &gerenciador->paginas_em_uso) && inst_le_int(arq, &gerenciador->pico_paginas_em_uso) &&
+           inst_le(arq, &gerenciador->pico_fragmentacao, sizeof(gerenciador->pico_fragmentacao));
+}
@@ -0,0 +1,53 @@
+#ifndef GERE_MEM_SEC_H
+#define GERE_MEM_SEC_H
+
+// Gerencia o espaço da memória secundária, em páginas. Cada processo recebe
+//   uma extensão (páginas consecutivas) com a sua imagem, onde também são
+//   salvas as suas páginas alteradas, e a devolve quando morre.
+// O espaço livre é uma lista de extensões ordenada pelo início; a alocação
+//   usa a primeira que couber e a liberação junta a extensão com as vizinhas.
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct
+{
+    int inicio;
+    int n_paginas;
+} extensao_t;
+
+typedef struct gere_mem_sec_t
+{
+    int total_paginas;
+    // extensões livres, ordenadas pelo início e sem vizinhas encostadas
+    extensao_t *livres;
+    int n_livres;
+    int capacidade;
+    // métricas
+    int paginas_em_uso;
+    int pico_paginas_em_uso;
+    float pico_fragmentacao;
+} gere_mem_sec_t;
+
+// recebe o número de páginas da memória secundária
+gere_mem_sec_t *gere_mem_sec_cria(int total_paginas);
+
+void gere_mem_sec_destroi(gere_mem_sec_t *self);
+
+// aloca 'n_paginas' consecutivas, retorna a primeira ou -1 se não houver espaço
+int gere_mem_sec_aloca(gere_mem_sec_t *self, int n_paginas);
+
+// devolve as 'n_paginas' a partir de 'inicio', alocadas antes
+void gere_mem_sec_libera(gere_mem_sec_t *self, int inicio, int n_paginas);
+
+// fragmentação externa: 1 - (maior extensão livre / total livre), 0 se não tem espaço livre
+float gere_mem_sec_fragmentacao(gere_mem_sec_t *self);
+
+// número de páginas na maior extensão livre
+int gere_mem_sec_maior_livre(gere_mem_sec_t *self);
+
+// Instantâneo (ver instantaneo.h), num gerenciador criado com o mesmo número de páginas
+bool gere_mem_sec_salva(gere_mem_sec_t *self, FILE *arq);
+bool gere_mem_sec_restaura(gere_mem_sec_t *self, FILE *arq);
+
+#endif // GERE_MEM_SEC_H
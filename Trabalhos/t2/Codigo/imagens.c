@@ -0,0 +1,208 @@
+#include "imagens.h"
+#include "console.h"
+#include "instantaneo.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGENS_INICIAL 4
+#define FATOR_CRESCIMENTO_IMAGENS 2
+
+imagens_t *imagens_cria(void)
+{
+    imagens_t *imagens = malloc(sizeof(imagens_t));
+    if (!imagens) {
+        console_printf("Erro ao alocar memória para as imagens dos programas.");
+        return NULL;
+    }
+
+    imagens->imagens = malloc(sizeof(imagem_t) * IMAGENS_INICIAL);
+    if (!imagens->imagens) {
+        console_printf("Erro ao alocar memória para as imagens dos programas.");
+        free(imagens);
+        return NULL;
+    }
+    imagens->capacidade = IMAGENS_INICIAL;
+    imagens->n_imagens = 0;
+    imagens->paginas_repetidas = 0;
+    return imagens;
+}
+
+void imagens_destroi(imagens_t *imagens)
+{
+    if (imagens != NULL) {
+        for (int i = 0; i < imagens->n_imagens; i++) {
+            imagens_descarta(imagens, i);
+        }
+        free(imagens->imagens);
+        free(imagens);
+    }
+}
+
+int imagens_busca(imagens_t *imagens, char *nome)
+{
+    for (int i = 0; i < imagens->n_imagens; i++) {
+        imagem_t *imagem = &imagens->imagens[i];
+        if (imagem->nome != NULL && strcmp(imagem->nome, nome) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int imagens_insere(imagens_t *imagens, char *nome, int pagina_mem_sec, int n_paginas)
+{
+    if (imagens->n_imagens == imagens->capacidade) {
+        int nova_capacidade = imagens->capacidade * FATOR_CRESCIMENTO_IMAGENS;
+        imagem_t *novas = realloc(imagens->imagens, sizeof(imagem_t) * nova_capacidade);
+        if (!novas) {
+            console_printf("Erro ao alocar memória para as imagens dos programas.");
+            return -1;
+        }
+        imagens->imagens = novas;
+        imagens->capacidade = nova_capacidade;
+    }
+
+    imagem_t *imagem = &imagens->imagens[imagens->n_imagens];
+    imagem->nome = strdup(nome);
+    imagem->quadros = malloc(sizeof(int) * n_paginas);
+    imagem->mapeadores = calloc(n_paginas, sizeof(int *));
+    imagem->n_mapeadores = calloc(n_paginas, sizeof(int));
+    imagem->n_conjuntos = calloc(n_paginas, sizeof(int));
+    if (!imagem->nome || !imagem->quadros ||
+        (n_paginas > 0 && (!imagem->mapeadores || !imagem->n_mapeadores || !imagem->n_conjuntos))) {
+        console_printf("Erro ao alocar memória para a imagem de '%s'.", nome);
+        free(imagem->nome);
+        free(imagem->quadros);
+        free(imagem->mapeadores);
+        free(imagem->n_mapeadores);
+        free(imagem->n_conjuntos);
+        return -1;
+    }
+    for (int pagina = 0; pagina < n_paginas; pagina++) {
+        imagem->quadros[pagina] = -1;
+    }
+    imagem->pagina_mem_sec = pagina_mem_sec;
+    imagem->n_paginas = n_paginas;
+    imagem->n_usuarios = 0;
+    return imagens->n_imagens++;
+}
+
+void imagens_descarta(imagens_t *imagens, int indice)
+{
+    imagem_t *imagem = &imagens->imagens[indice];
+    // A imagem descartada não é mais encontrada pelo nome
+    free(imagem->nome);
+    free(imagem->quadros);
+    if (imagem->mapeadores != NULL) {
+        for (int pagina = 0; pagina < imagem->n_paginas; pagina++) {
+            free(imagem->mapeadores[pagina]);
+        }
+    }
+    free(imagem->mapeadores);
+    free(imagem->n_mapeadores);
+    free(imagem->n_conjuntos);
+    imagem->nome = NULL;
+    imagem->quadros = NULL;
+    imagem->mapeadores = NULL;
+    imagem->n_mapeadores = NULL;
+    imagem->n_conjuntos = NULL;
+    imagem->n_usuarios = 0;
+}
+
+bool imagens_adiciona_mapeador(imagens_t *imagens, int indice, int pagina, int pid)
+{
+    imagem_t *imagem = &imagens->imagens[indice];
+    int n = imagem->n_mapeadores[pagina];
+    for (int i = 0; i < n; i++) {
+        if (imagem->mapeadores[pagina][i] == pid) {
+            return true;
+        }
+    }
+    // O vetor dobra quando o número de mapeadores chega numa potência de 2, então
+    //   sempre tem pelo menos a menor potência de 2 que comporta todos
+    if ((n & (n - 1)) == 0) {
+        int *novos = realloc(imagem->mapeadores[pagina], sizeof(int) * (n > 0 ? n * 2 : 1));
+        if (!novos) {
+            console_printf("Erro ao alocar memória para os mapeadores da página %d da imagem %d.", pagina, indice);
+            return false;
+        }
+        imagem->mapeadores[pagina] = novos;
+    }
+    imagem->mapeadores[pagina][n] = pid;
+    imagem->n_mapeadores[pagina]++;
+    return true;
+}
+
+void imagens_remove_mapeador(imagens_t *imagens, int indice, int pagina, int pid)
+{
+    imagem_t *imagem = &imagens->imagens[indice];
+    int n = imagem->n_mapeadores[pagina];
+    for (int i = 0; i < n; i++) {
+        if (imagem->mapeadores[pagina][i] == pid) {
+            imagem->mapeadores[pagina][i] = imagem->mapeadores[pagina][n - 1];
+            imagem->n_mapeadores[pagina]--;
+            return;
+        }
+    }
+}
+
+void imagens_limpa_mapeadores(imagens_t *imagens, int indice, int pagina)
+{
+    imagens->imagens[indice].n_mapeadores[pagina] = 0;
+}
+
+void imagens_conta_conjunto(imagens_t *imagens, int indice, int pagina, int variacao)
+{
+    int *n = &imagens->imagens[indice].n_conjuntos[pagina];
+    int repetidas_antes = *n > 1 ? *n - 1 : 0;
+    *n += variacao;
+    imagens->paginas_repetidas += (*n > 1 ? *n - 1 : 0) - repetidas_antes;
+}
+
+// INSTANTÂNEO
+
+// As descartadas também são gravadas (sem nome nem quadros), para que os
+// índices continuem os mesmos
+bool imagens_salva(imagens_t *imagens, FILE *arq)
+{
+    if (!inst_escreve_marca(arq, "IMAG") || !inst_escreve_int(arq, imagens->n_imagens))
+        return false;
+    for (int i = 0; i < imagens->n_imagens; i++) {
+        imagem_t *imagem = &imagens->imagens[i];
+        int tam_nome = imagem->nome != NULL ? strlen(imagem->nome) : -1;
+        if (!inst_escreve_int(arq, tam_nome) || (tam_nome > 0 && !inst_escreve(arq, imagem->nome, tam_nome)) ||
+            !inst_escreve_int(arq, imagem->pagina_mem_sec) || !inst_escreve_int(arq, imagem->n_paginas) ||
+            !inst_escreve_int(arq, imagem->n_usuarios) ||
+            (imagem->quadros != NULL && !inst_escreve(arq, imagem->quadros, sizeof(int) * imagem->n_paginas)))
+            return false;
+    }
+    return true;
+}
+
+bool imagens_restaura(imagens_t *imagens, FILE *arq)
+{
+    int n_imagens;
+    if (imagens->n_imagens != 0 || !inst_confere_marca(arq, "IMAG") || !inst_le_int(arq, &n_imagens))
+        return false;
+    for (int i = 0; i < n_imagens; i++) {
+        int tam_nome, pagina_mem_sec, n_paginas, n_usuarios;
+        if (!inst_le_int(arq, &tam_nome) || tam_nome > 1000)
+            return false;
+        char nome[tam_nome > 0 ? tam_nome + 1 : 1];
+        if ((tam_nome > 0 && !inst_le(arq, nome, tam_nome)) || !inst_le_int(arq, &pagina_mem_sec) ||
+            !inst_le_int(arq, &n_paginas) || !inst_le_int(arq, &n_usuarios) || n_paginas < 0)
+            return false;
+        nome[tam_nome > 0 ? tam_nome : 0] = '\0';
+        int indice = imagens_insere(imagens, nome, pagina_mem_sec, n_paginas);
+        if (indice < 0)
+            return false;
+        imagem_t *imagem = &imagens->imagens[indice];
+        if (tam_nome < 0) {
+            imagens_descarta(imagens, indice);
+        } else if (!inst_le(arq, imagem->quadros, sizeof(int) * n_paginas)) {
+            return false;
+        }
+        imagem->n_usuarios = n_usuarios;
+    }
+    return true;
+}
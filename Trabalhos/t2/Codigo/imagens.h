@@ -0,0 +1,75 @@
+#ifndef IMAGENS_H
+#define IMAGENS_H
+
+// Imagens dos programas na memória secundária, compartilhadas pelos processos
+//   que executam o mesmo executável. As páginas de uma imagem são mapeadas
+//   protegidas contra escrita, todos os processos no mesmo quadro; um processo
+//   que escreve numa delas passa a ter uma cópia privada da página (cópia na
+//   escrita), salva na sua própria extensão da memória secundária.
+// Uma imagem é identificada pelo seu índice, que não é reutilizado: quando o
+//   último processo que a usa morre ela é descartada, e uma nova carga do mesmo
+//   programa cria outra.
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct
+{
+    char *nome;
+    // primeira página da extensão da memória secundária com a imagem
+    int pagina_mem_sec;
+    int n_paginas;
+    // processos vivos executando a imagem; 0 se foi descartada
+    int n_usuarios;
+    // quadro com cada página, lida ou sendo lida do disco, -1 se não tem
+    int *quadros;
+    // pids dos processos que mapeiam cada página no seu quadro, sem ordem
+    int **mapeadores;
+    int *n_mapeadores;
+    // processos ativos com cada página (compartilhada) no conjunto de trabalho
+    int *n_conjuntos;
+} imagem_t;
+
+typedef struct imagens_t
+{
+    imagem_t *imagens;
+    int n_imagens;
+    int capacidade;
+    // páginas contadas a mais quando se somam os conjuntos de trabalho dos
+    //   processos ativos: para cada página, os conjuntos que a têm menos 1
+    int paginas_repetidas;
+} imagens_t;
+
+imagens_t *imagens_cria(void);
+
+void imagens_destroi(imagens_t *self);
+
+// retorna o índice da imagem em uso do executável 'nome', -1 se não tem
+int imagens_busca(imagens_t *self, char *nome);
+
+// insere a imagem do executável 'nome', com 'n_paginas' a partir de 'pagina_mem_sec'
+//   na memória secundária, sem usuários e sem quadros; retorna o índice ou -1
+int imagens_insere(imagens_t *self, char *nome, int pagina_mem_sec, int n_paginas);
+
+// descarta a imagem (a memória secundária deve ser liberada por quem a alocou)
+void imagens_descarta(imagens_t *self, int indice);
+
+// o processo 'pid' passa a mapear a página no quadro dela (se ainda não mapeava);
+//   retorna false se não conseguiu memória
+bool imagens_adiciona_mapeador(imagens_t *self, int indice, int pagina, int pid);
+
+// o processo 'pid' deixa de mapear a página (se mapeava)
+void imagens_remove_mapeador(imagens_t *self, int indice, int pagina, int pid);
+
+// nenhum processo mapeia mais a página (ela saiu do quadro)
+void imagens_limpa_mapeadores(imagens_t *self, int indice, int pagina);
+
+// soma 'variacao' ao número de conjuntos de trabalho que têm a página
+void imagens_conta_conjunto(imagens_t *self, int indice, int pagina, int variacao);
+
+// Instantâneo (ver instantaneo.h); os mapeadores e as contagens de conjuntos de
+//   trabalho não são gravados, quem restaura refaz a partir dos processos, restaurado num conjunto ainda vazio
+bool imagens_salva(imagens_t *self, FILE *arq);
+bool imagens_restaura(imagens_t *self, FILE *arq);
+
+#endif // IMAGENS_H
@@ -0,0 +1,83 @@
+// instantaneo.c
+// gravação e leitura do estado da simulação em arquivo
+// simulador de computador
+// so24b
+
+#include "instantaneo.h"
+
+#include <string.h>
+
+bool inst_escreve(FILE *arq, const void *dados, size_t tam)
+{
+  if (tam == 0) return true;
+  return fwrite(dados, 1, tam, arq) == tam;
+}
+
+bool inst_le(FILE *arq, void *dados, size_t tam)
+{
+  if (tam == 0) return true;
+  return fread(dados, 1, tam, arq) == tam;
+}
+
+bool inst_escreve_int(FILE *arq, int valor)
+{
+  return inst_escreve(arq, &valor, sizeof(valor));
+}
+
+bool inst_le_int(FILE *arq, int *pvalor)
+{
+  return inst_le(arq, pvalor, sizeof(*pvalor));
+}
+
+bool inst_confere_int(FILE *arq, int valor)
+{
+  int lido;
+  return inst_le_int(arq, &lido) && lido == valor;
+}
+
+bool inst_escreve_marca(FILE *arq, char *marca)
+{
+  return inst_escreve(arq, marca, 4);
+}
+
+bool inst_confere_marca(FILE *arq, char *marca)
+{
+  char lida[4];
+  return inst_le(arq, lida, 4) && memcmp(lida, marca, 4) == 0;
+}
+
+// o vetor é gravado em trechos, cada um com o número de zeros e o número de
+//   valores seguintes diferentes de zero, seguido desses valores
+bool inst_escreve_vetor(FILE *arq, const int *valores, int n)
+{
+  int i = 0;
+  while (i < n) {
+    int zeros = 0;
+    while (i + zeros < n && valores[i + zeros] == 0) zeros++;
+    int inicio = i + zeros;
+    int fim = inicio;
+    while (fim < n && valores[fim] != 0) fim++;
+    if (!inst_escreve_int(arq, zeros)
+        || !inst_escreve_int(arq, fim - inicio)
+        || !inst_escreve(arq, valores + inicio, (fim - inicio) * sizeof(int))) {
+      return false;
+    }
+    i = fim;
+  }
+  return true;
+}
+
+bool inst_le_vetor(FILE *arq, int *valores, int n)
+{
+  int i = 0;
+  while (i < n) {
+    int zeros, outros;
+    if (!inst_le_int(arq, &zeros) || !inst_le_int(arq, &outros)) return false;
+    if (zeros < 0 || outros < 0 || zeros > n - i || outros > n - i - zeros) return false;
+    memset(valores + i, 0, zeros * sizeof(int));
+    i += zeros;
+    if (!inst_le(arq, valores + i, outros * sizeof(int))) return false;
+    i += outros;
+  }
+  return true;
+}
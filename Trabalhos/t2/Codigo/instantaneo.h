@@ -0,0 +1,47 @@
+// instantaneo.h
+// gravação e leitura do estado da simulação em arquivo
+// simulador de computador
+// so24b
+
+#ifndef INSTANTANEO_H
+#define INSTANTANEO_H
+
+// Um instantâneo é o estado completo da simulação num arquivo binário, para
+//   que ela possa continuar depois a partir desse ponto (por exemplo, para
+//   várias execuções começarem todas depois da carga inicial dos processos).
+// Cada componente grava o seu estado com uma função <componente>_salva e o
+//   recupera com <componente>_restaura, num componente já criado (com
+//   <componente>_cria); o estado de cada um começa com uma marca de 4
+//   caracteres, conferida na leitura, para detectar um arquivo que não
+//   corresponde ao que está sendo lido.
+// Os ponteiros não são gravados: quem restaura é que os refaz (o SO, por
+//   exemplo, reencadeia os processos nas filas a partir dos pids).
+// As funções retornam false se a escrita ou a leitura falhar ou se o
+//   conteúdo lido não for o esperado.
+// O formato é o da máquina que gravou (inteiros na ordem de bytes dela).
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// escreve/lê 'tam' bytes
+bool inst_escreve(FILE *arq, const void *dados, size_t tam);
+bool inst_le(FILE *arq, void *dados, size_t tam);
+
+// escreve/lê um inteiro
+bool inst_escreve_int(FILE *arq, int valor);
+bool inst_le_int(FILE *arq, int *pvalor);
+
+// lê um inteiro e confere se tem o valor 'valor' (um tamanho que deve ser o
+//   mesmo na gravação e na leitura, por exemplo, gravado com inst_escreve_int)
+bool inst_confere_int(FILE *arq, int valor);
+
+// escreve a marca 'marca' (4 caracteres) / lê e confere se é ela
+bool inst_escreve_marca(FILE *arq, char *marca);
+bool inst_confere_marca(FILE *arq, char *marca);
+
+// escreve/lê os 'n' inteiros de 'valores', compactando as sequências de zeros
+//   (a maior parte de uma memória pouco usada)
+bool inst_escreve_vetor(FILE *arq, const int *valores, int n);
+bool inst_le_vetor(FILE *arq, int *valores, int n);
+
+#endif // INSTANTANEO_H
@@ -17,6 +17,10 @@ typedef enum {
   // interrupções de E/S ainda não implementadas
   IRQ_TECLADO,       // interrupção causada pelo teclado
   IRQ_TELA,          // interrupção causada pela tela
+  // mais interrupções geradas por dispositivos de E/S
+  IRQ_DISCO,         // leitura do disco concluída
+  // interrupção pedida por outro núcleo (CPU), quando tem mais de um
+  IRQ_NUCLEO,        // aviso do SO executando em outro núcleo
   N_IRQ              // número de interrupções
 } irq_t;
 
@@ -32,6 +36,13 @@ char *irq_nome(irq_t irq);
 #define IRQ_END_complemento 4
 #define IRQ_END_modo        5
 
+// com mais de um núcleo (CPU) compartilhando a memória, cada um salva o estado
+//   numa área própria, com os endereços acima somados a IRQ_END_AREA(núcleo):
+//   a do núcleo 0 é a do início da memória, as dos outros ficam depois do
+//   tratador de interrupção, ainda nos quadros reservados para o SO
+#define IRQ_MAX_NUCLEOS     8
+#define IRQ_END_AREA(n)     ((n) == 0 ? 0 : 40 + (n) * 6)
+
 // endereço para onde desviar quando aceita uma interrupção
 #define IRQ_END_TRATADOR   10
 
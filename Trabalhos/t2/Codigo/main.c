@@ -6,41 +6,78 @@
 #include "console.h"
 #include "controle.h"
 #include "cpu.h"
+#include "disco.h"
 #include "dispositivos.h"
 #include "es.h"
+#include "instantaneo.h"
+#include "irq.h"
 #include "memoria.h"
 #include "mmu.h"
+#include "registro.h"
 #include "relogio.h"
 #include "so.h"
 #include "terminal.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 // constantes
 #define MEM_TAM 1000 // tamanho da memória principal
+#define MEM_SEC_TAM 10000 // tamanho da memória secundária
+#define MEM_SEC_ARQUIVO_TAM (4 * 1024 * 1024) // tamanho da memória secundária em arquivo
+#define VERSAO_INSTANTANEO 3 // muda quando muda o que é gravado no instantâneo
 
 // estrutura com os componentes do computador simulado
 typedef struct
 {
     mem_t *mem;
-    mmu_t *mmu;
-    cpu_t *cpu;
+    mem_t *mem_sec;
+    // cada núcleo tem a sua CPU e a sua MMU (com a sua TLB); o 0 é o que
+    //   existe sempre, os outros são criados com a opção -c
+    int n_nucleos;
+    mmu_t *mmu[IRQ_MAX_NUCLEOS];
+    cpu_t *cpu[IRQ_MAX_NUCLEOS];
     relogio_t *relogio;
+    disco_t *disco;
     console_t *console;
     es_t *es;
     controle_t *controle;
 } hardware_t;
 
-static void cria_hardware(hardware_t *hw)
+// a memória é observada pelas CPUs de todos os núcleos
+static void invalida_decod_nucleos(void *arg, int endfis)
 {
-    // cria a memória e a MMU
+    hardware_t *hw = arg;
+    for (int i = 0; i < hw->n_nucleos; i++) {
+        cpu_invalida_decod(hw->cpu[i], endfis);
+    }
+}
+
+static void cria_hardware(hardware_t *hw, bool sem_tela, char *arquivo_mem_sec, int n_nucleos)
+{
+    // cria a memória e as MMUs
     hw->mem = mem_cria(MEM_TAM);
-    hw->mmu = mmu_cria(hw->mem);
+    hw->n_nucleos = n_nucleos;
+    for (int i = 0; i < n_nucleos; i++) {
+        hw->mmu[i] = mmu_cria(hw->mem);
+    }
+    // a memória secundária em arquivo pode ser bem maior, só ocupa o que é usado
+    if (arquivo_mem_sec != NULL) {
+        hw->mem_sec = mem_cria_arquivo(arquivo_mem_sec, MEM_SEC_ARQUIVO_TAM);
+        if (hw->mem_sec == NULL) {
+            perror(arquivo_mem_sec);
+            exit(1);
+        }
+    } else {
+        hw->mem_sec = mem_cria(MEM_SEC_TAM);
+    }
 
     // cria dispositivos de E/S
-    hw->console = console_cria();
+    hw->console = console_cria(sem_tela);
     hw->relogio = relogio_cria();
+    hw->disco = disco_cria(hw->mem_sec, hw->mem);
 
     // cria o controlador de E/S e registra os dispositivos
     //   por exemplo, o dispositivo 8 do controlador de E/S (e da CPU) será o
@@ -76,40 +113,275 @@ static void cria_hardware(hardware_t *hw)
     es_registra_dispositivo(hw->es, D_RELOGIO_REAL, hw->relogio, 1, relogio_leitura, NULL);
     es_registra_dispositivo(hw->es, D_RELOGIO_TIMER, hw->relogio, 2, relogio_leitura, relogio_escrita);
     es_registra_dispositivo(hw->es, D_RELOGIO_INTERRUPCAO, hw->relogio, 3, relogio_leitura, relogio_escrita);
+    // página, quadro, comando, leitura concluída, interrupção e estatísticas do disco
+    es_registra_dispositivo(hw->es, D_DISCO_PAGINA, hw->disco, 0, disco_leitura, disco_escrita);
+    es_registra_dispositivo(hw->es, D_DISCO_QUADRO, hw->disco, 1, disco_leitura, disco_escrita);
+    es_registra_dispositivo(hw->es, D_DISCO_COMANDO, hw->disco, 2, disco_leitura, disco_escrita);
+    es_registra_dispositivo(hw->es, D_DISCO_CONCLUIDA, hw->disco, 3, disco_leitura, NULL);
+    es_registra_dispositivo(hw->es, D_DISCO_INTERRUPCAO, hw->disco, 4, disco_leitura, NULL);
+    es_registra_dispositivo(hw->es, D_DISCO_ATENDIDAS, hw->disco, 5, disco_leitura, NULL);
+    es_registra_dispositivo(hw->es, D_DISCO_TRILHAS, hw->disco, 6, disco_leitura, NULL);
 
-    // cria a unidade de execução e inicializa com a MMU e E/S
-    hw->cpu = cpu_cria(hw->mmu, hw->es);
+    // cria as unidades de execução e inicializa com a MMU de cada uma e a E/S
+    // cada núcleo salva o estado na sua área da memória quando é interrompido
+    for (int i = 0; i < n_nucleos; i++) {
+        hw->cpu[i] = cpu_cria(hw->mmu[i], hw->es);
+        cpu_define_area_irq(hw->cpu[i], IRQ_END_AREA(i));
+    }
+    // a CPU guarda instruções decodificadas, precisa saber quando a memória muda
+    if (n_nucleos == 1) {
+        mem_define_observador(hw->mem, cpu_invalida_decod, hw->cpu[0]);
+    } else {
+        mem_define_observador(hw->mem, invalida_decod_nucleos, hw);
+    }
 
-    // cria o controlador da CPU e inicializa com a unidade de execução, a console e
-    //   o relógio
-    hw->controle = controle_cria(hw->cpu, hw->console, hw->relogio);
+    // cria o controlador da CPU e inicializa com as unidades de execução, a console,
+    //   o relógio e o disco
+    hw->controle = controle_cria(hw->cpu[0], hw->console, hw->relogio, hw->disco);
+    for (int i = 1; i < n_nucleos; i++) {
+        controle_adiciona_cpu(hw->controle, hw->cpu[i]);
+    }
 }
 
 static void destroi_hardware(hardware_t *hw)
 {
     controle_destroi(hw->controle);
-    cpu_destroi(hw->cpu);
+    for (int i = 0; i < hw->n_nucleos; i++) {
+        cpu_destroi(hw->cpu[i]);
+    }
     es_destroi(hw->es);
+    disco_destroi(hw->disco);
     relogio_destroi(hw->relogio);
     console_destroi(hw->console);
-    mmu_destroi(hw->mmu);
+    for (int i = 0; i < hw->n_nucleos; i++) {
+        mmu_destroi(hw->mmu[i]);
+    }
+    mem_destroi(hw->mem_sec);
     mem_destroi(hw->mem);
 }
 
-int main()
+// grava o estado de todo o computador e do SO no arquivo 'nome'
+// só com um núcleo
+// o cabeçalho identifica o formato e a configuração com que foi compilado
+static bool grava_instantaneo(hardware_t *hw, so_t *so, char *nome)
+{
+    FILE *arq = fopen(nome, "wb");
+    if (arq == NULL) {
+        perror(nome);
+        return false;
+    }
+    bool ok = inst_escreve_marca(arq, "SO24") && inst_escreve_int(arq, VERSAO_INSTANTANEO) &&
+              inst_escreve_int(arq, TAM_PAGINA) && mem_salva(hw->mem, arq) && mem_salva(hw->mem_sec, arq) &&
+              cpu_salva(hw->cpu[0], arq) && relogio_salva(hw->relogio, arq) && disco_salva(hw->disco, arq) &&
+              es_salva(hw->es, arq) && console_salva(hw->console, arq) && mmu_salva(hw->mmu[0], arq) &&
+              so_salva(so, arq);
+    if (fclose(arq) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: erro na gravação do instantâneo\n", nome);
+    }
+    return ok;
+}
+
+// recupera o estado gravado por grava_instantaneo, num hardware e SO recém-criados
+// a MMU é restaurada antes do SO, que define nela a tabela de páginas em uso
+static bool restaura_instantaneo(hardware_t *hw, so_t *so, char *nome)
+{
+    FILE *arq = fopen(nome, "rb");
+    if (arq == NULL) {
+        perror(nome);
+        return false;
+    }
+    bool ok = inst_confere_marca(arq, "SO24") && inst_confere_int(arq, VERSAO_INSTANTANEO) &&
+              inst_confere_int(arq, TAM_PAGINA) && mem_restaura(hw->mem, arq) && mem_restaura(hw->mem_sec, arq) &&
+              cpu_restaura(hw->cpu[0], arq) && relogio_restaura(hw->relogio, arq) && disco_restaura(hw->disco, arq) &&
+              es_restaura(hw->es, arq) && console_restaura(hw->console, arq) && mmu_restaura(hw->mmu[0], arq) &&
+              so_restaura(so, arq);
+    fclose(arq);
+    if (!ok) {
+        fprintf(stderr, "%s: instantâneo inválido ou gravado com outra configuração\n", nome);
+    }
+    return ok;
+}
+
+static void uso(char *nome)
+{
+    fprintf(stderr,
+            "uso: %s [-l] [-s algoritmo] [-d escalonamento] [-m arquivo] [-i intervalo] [-f]\n"
+            "       [-g arquivo [-t instante]] [-r arquivo] [-e arquivo | -p arquivo] [-c núcleos]\n",
+            nome);
+    fprintf(stderr, "  -l  modo lote: executa sem tela até o SO terminar todos os processos\n");
+    fprintf(stderr, "      (entrada dos terminais de terminal_X.entrada, saída em terminal_X.saida)\n");
+    fprintf(stderr, "  -s  algoritmo de substituição de páginas:\n");
+    fprintf(stderr, "      fifo, segunda_chance, nru ou envelhecimento\n");
+    fprintf(stderr, "  -d  ordem de atendimento das requisições ao disco:\n");
+    fprintf(stderr, "      fcfs, sstf ou elevador\n");
+    fprintf(stderr, "  -m  guarda a memória secundária no arquivo dado (criado se não existir,\n");
+    fprintf(stderr, "      mantido entre execuções)\n");
+    fprintf(stderr, "  -i  escreve as métricas de paginação a cada 'intervalo' instruções\n");
+    fprintf(stderr, "      (em ../metricas_periodicas.txt)\n");
+    fprintf(stderr, "  -f  a CPU executa fundidas sequências comuns de instruções\n");
+    fprintf(stderr, "  -g  grava no arquivo dado um instantâneo da simulação quando o relógio\n");
+    fprintf(stderr, "      chegar em 'instante' (-t, padrão 0), e continua a execução\n");
+    fprintf(stderr, "  -r  começa a simulação do instantâneo gravado no arquivo dado (com -g);\n");
+    fprintf(stderr, "      as opções -s, -d, -i e -f valem a partir dele\n");
+    fprintf(stderr, "      -g e -r só no modo lote\n");
+    fprintf(stderr, "  -e  grava no arquivo dado os eventos externos (comandos, entrada dos\n");
+    fprintf(stderr, "      terminais, relógio real), com o instante de cada um\n");
+    fprintf(stderr, "  -p  reproduz os eventos gravados com -e no arquivo dado, nos mesmos\n");
+    fprintf(stderr, "      instantes (com -l, a execução gravada na tela é repetida sem ela)\n");
+    fprintf(stderr, "  -c  número de núcleos (CPUs com a sua MMU) que compartilham a memória,\n");
+    fprintf(stderr, "      de 1 (o padrão) a %d; com mais de um, sem -g e -r\n", IRQ_MAX_NUCLEOS);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
 {
     hardware_t hw;
     so_t *so;
+    bool sem_tela = false;
+    algoritmo_substituicao_t substituicao = N_ALGORITMO_SUBSTITUICAO;
+    disco_escalonamento_t escalonamento_disco = N_DISCO_ESCALONAMENTO;
+    char *arquivo_mem_sec = NULL;
+    int intervalo_metricas = 0;
+    bool funde_instrucoes = false;
+    char *arquivo_grava = NULL;
+    int instante_grava = 0;
+    char *arquivo_restaura = NULL;
+    char *arquivo_registro = NULL;
+    bool reproduz_registro = false;
+    registro_t *registro = NULL;
+    int n_nucleos = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "ls:d:m:i:fg:t:r:e:p:c:")) != -1) {
+        switch (opt) {
+        case 'l':
+            sem_tela = true;
+            break;
+        case 's':
+            substituicao = so_algoritmo_substituicao(optarg);
+            if (substituicao == N_ALGORITMO_SUBSTITUICAO) {
+                uso(argv[0]);
+            }
+            break;
+        case 'd':
+            escalonamento_disco = disco_escalonamento(optarg);
+            if (escalonamento_disco == N_DISCO_ESCALONAMENTO) {
+                uso(argv[0]);
+            }
+            break;
+        case 'm':
+            arquivo_mem_sec = optarg;
+            break;
+        case 'i':
+            intervalo_metricas = atoi(optarg);
+            if (intervalo_metricas <= 0) {
+                uso(argv[0]);
+            }
+            break;
+        case 'f':
+            funde_instrucoes = true;
+            break;
+        case 'g':
+            arquivo_grava = optarg;
+            break;
+        case 't':
+            instante_grava = atoi(optarg);
+            if (instante_grava < 0) {
+                uso(argv[0]);
+            }
+            break;
+        case 'r':
+            arquivo_restaura = optarg;
+            break;
+        case 'e':
+        case 'p':
+            if (arquivo_registro != NULL) {
+                uso(argv[0]);
+            }
+            arquivo_registro = optarg;
+            reproduz_registro = opt == 'p';
+            break;
+        case 'c':
+            n_nucleos = atoi(optarg);
+            if (n_nucleos < 1 || n_nucleos > IRQ_MAX_NUCLEOS) {
+                uso(argv[0]);
+            }
+            break;
+        default:
+            uso(argv[0]);
+        }
+    }
+    // o instantâneo inclui a saída dos terminais, que só é conhecida no modo lote
+    // e só tem o estado de um núcleo
+    if ((arquivo_grava != NULL || arquivo_restaura != NULL) && (!sem_tela || n_nucleos > 1)) {
+        uso(argv[0]);
+    }
 
     // cria o hardware
-    cria_hardware(&hw);
-    // cria o sistema operacional
-    so = so_cria(hw.cpu, hw.mem, hw.mmu, hw.es, hw.console);
+    cria_hardware(&hw, sem_tela, arquivo_mem_sec, n_nucleos);
+    // cria o sistema operacional, que executa em todos os núcleos
+    so = so_cria(hw.cpu[0], hw.mem, hw.mem_sec, hw.mmu[0], hw.es, hw.console);
+    for (int i = 1; i < n_nucleos; i++) {
+        so_adiciona_nucleo(so, hw.cpu[i], hw.mmu[i]);
+    }
+    // o estado criado é substituído pelo do instantâneo, e as opções valem a partir dele
+    if (arquivo_restaura != NULL && !restaura_instantaneo(&hw, so, arquivo_restaura)) {
+        so_destroi(so);
+        destroi_hardware(&hw);
+        exit(1);
+    }
+    // os instantes do registro são os do relógio, que pode ter vindo do instantâneo
+    if (arquivo_registro != NULL) {
+        if (reproduz_registro) {
+            registro = registro_cria_reproducao(arquivo_registro, hw.relogio);
+        } else {
+            registro = registro_cria_gravacao(arquivo_registro, hw.relogio);
+        }
+        if (registro == NULL) {
+            so_destroi(so);
+            destroi_hardware(&hw);
+            exit(1);
+        }
+        console_define_registro(hw.console, registro);
+        relogio_define_registro(hw.relogio, registro);
+    }
+    if (escalonamento_disco != N_DISCO_ESCALONAMENTO) {
+        disco_define_escalonamento(hw.disco, escalonamento_disco);
+    }
+    for (int i = 0; i < n_nucleos; i++) {
+        cpu_define_fusao(hw.cpu[i], funde_instrucoes);
+    }
+    if (substituicao != N_ALGORITMO_SUBSTITUICAO) {
+        so_define_algoritmo_substituicao(so, substituicao);
+    }
+    so_define_intervalo_metricas(so, intervalo_metricas);
 
     // executa o laço principal do controlador
-    controle_laco(hw.controle);
+    if (sem_tela) {
+        if (arquivo_grava != NULL) {
+            controle_define_parada(hw.controle, instante_grava);
+        }
+        if (!controle_laco_lote(hw.controle)) {
+            // parou no instante pedido: grava e continua até o fim
+            grava_instantaneo(&hw, so, arquivo_grava);
+            controle_laco_lote(hw.controle);
+        } else if (arquivo_grava != NULL) {
+            fprintf(stderr, "%s: a simulação terminou antes do instante %d, instantâneo não gravado\n",
+                    arquivo_grava, instante_grava);
+        }
+    } else {
+        controle_laco(hw.controle);
+    }
 
     // destroi tudo
     so_destroi(so);
+    if (registro != NULL) {
+        console_define_registro(hw.console, NULL);
+        relogio_define_registro(hw.relogio, NULL);
+        registro_destroi(registro);
+    }
     destroi_hardware(&hw);
 }
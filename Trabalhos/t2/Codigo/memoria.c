@@ -4,14 +4,31 @@
 // so24b
 
 #include "memoria.h"
+#include "instantaneo.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// o arquivo de uma memória em arquivo cresce de tantos valores por vez
+#define MEM_ARQUIVO_PEDACO (64 * 1024)
 
 // tipo de dados para representar uma região de memória
 struct mem_t {
   int tam;
   int *conteudo;
+  // memória em arquivo: descritor do arquivo (-1 se a memória está no heap)
+  //   e quantos valores o arquivo tem (o mapeamento tem 'tam' valores, mas
+  //   só pode ser acessado até o fim do arquivo)
+  int fd;
+  int tam_arquivo;
+  // quem deve ser avisado das escritas
+  mem_f_observa_t f_observa;
+  void *arg_observa;
 };
 
 mem_t *mem_cria(int tam)
@@ -22,8 +39,48 @@ mem_t *mem_cria(int tam)
 
   self->conteudo = malloc(tam * sizeof(*(self->conteudo)));
   assert(self->conteudo != NULL);
+  // a memória começa zerada (como a mapeada de um arquivo novo), para o
+  //   conteúdo gravado num instantâneo não depender do malloc
+  memset(self->conteudo, 0, tam * sizeof(*(self->conteudo)));
+
+  self->tam = tam;
+  self->fd = -1;
+  self->tam_arquivo = tam;
+  self->f_observa = NULL;
+  self->arg_observa = NULL;
+
+  return self;
+}
+
+mem_t *mem_cria_arquivo(char *nome, int tam)
+{
+  int fd = open(nome, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  // reserva o espaço de endereçamento para a memória toda; as páginas só
+  //   ocupam memória do hospedeiro (e disco) quando são usadas
+  void *conteudo = mmap(NULL, (size_t)tam * sizeof(int), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+  if (conteudo == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
 
+  mem_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
   self->tam = tam;
+  self->conteudo = conteudo;
+  self->fd = fd;
+  // o que já tinha no arquivo (de uma execução anterior) é mantido
+  self->tam_arquivo = st.st_size / sizeof(int);
+  if (self->tam_arquivo > tam) self->tam_arquivo = tam;
+  self->f_observa = NULL;
+  self->arg_observa = NULL;
 
   return self;
 }
@@ -31,13 +88,29 @@ mem_t *mem_cria(int tam)
 void mem_destroi(mem_t *self)
 {
   if (self != NULL) {
-    if (self->conteudo != NULL) {
+    if (self->fd != -1) {
+      munmap(self->conteudo, (size_t)self->tam * sizeof(int));
+      close(self->fd);
+    } else if (self->conteudo != NULL) {
       free(self->conteudo);
     }
     free(self);
   }
 }
 
+// função auxiliar, aumenta o arquivo (em pedaços) para conter pelo menos
+//   'tam' valores; o arquivo é esparso, a parte nova não ocupa disco até ser
+//   escrita, e é lida como zero
+static err_t garante_arquivo(mem_t *self, int tam)
+{
+  if (tam <= self->tam_arquivo) return ERR_OK;
+  int novo = (tam + MEM_ARQUIVO_PEDACO - 1) / MEM_ARQUIVO_PEDACO * MEM_ARQUIVO_PEDACO;
+  if (novo > self->tam) novo = self->tam;
+  if (ftruncate(self->fd, (off_t)novo * sizeof(int)) != 0) return ERR_END_INV;
+  self->tam_arquivo = novo;
+  return ERR_OK;
+}
+
 int mem_tam(mem_t *self)
 {
   return self->tam;
@@ -49,7 +122,7 @@ static err_t verifica_permissao(mem_t *self, int endereco)
   if (endereco < 0 || endereco >= self->tam) {
     return ERR_END_INV;
   }
-  return ERR_OK;
+  return garante_arquivo(self, endereco + 1);
 }
 
 err_t mem_le(mem_t *self, int endereco, int *pvalor)
@@ -65,7 +138,83 @@ err_t mem_escreve(mem_t *self, int endereco, int valor)
 {
   err_t err = verifica_permissao(self, endereco);
   if (err == ERR_OK) {
+    // escrever o mesmo valor não altera nada que o observador tenha guardado
+    if (self->conteudo[endereco] == valor) return ERR_OK;
     self->conteudo[endereco] = valor;
+    if (self->f_observa != NULL) self->f_observa(self->arg_observa, endereco);
+  }
+  return err;
+}
+
+// função auxiliar, verifica se todo o intervalo de endereços é válido
+static err_t verifica_permissao_bloco(mem_t *self, int endereco, int tam)
+{
+  if (tam < 0 || endereco < 0 || endereco > self->tam - tam) {
+    return ERR_END_INV;
+  }
+  return garante_arquivo(self, endereco + tam);
+}
+
+// função auxiliar, avisa o observador de cada endereço alterado
+static void avisa_observador(mem_t *self, int endereco, int tam)
+{
+  if (self->f_observa == NULL) return;
+  for (int i = 0; i < tam; i++) {
+    self->f_observa(self->arg_observa, endereco + i);
+  }
+}
+
+err_t mem_le_bloco(mem_t *self, int endereco, int tam, int *valores)
+{
+  err_t err = verifica_permissao_bloco(self, endereco, tam);
+  if (err == ERR_OK) {
+    memcpy(valores, &self->conteudo[endereco], tam * sizeof(*valores));
+  }
+  return err;
+}
+
+err_t mem_escreve_bloco(mem_t *self, int endereco, int tam, const int *valores)
+{
+  err_t err = verifica_permissao_bloco(self, endereco, tam);
+  if (err == ERR_OK) {
+    memcpy(&self->conteudo[endereco], valores, tam * sizeof(*valores));
+    avisa_observador(self, endereco, tam);
   }
   return err;
 }
+
+err_t mem_copia(mem_t *self, int endereco, mem_t *origem, int end_origem, int tam)
+{
+  assert(self != origem || endereco + tam <= end_origem || end_origem + tam <= endereco);
+  err_t err = verifica_permissao_bloco(origem, end_origem, tam);
+  if (err == ERR_OK) {
+    err = mem_escreve_bloco(self, endereco, tam, &origem->conteudo[end_origem]);
+  }
+  return err;
+}
+
+void mem_define_observador(mem_t *self, mem_f_observa_t f_observa, void *arg)
+{
+  self->f_observa = f_observa;
+  self->arg_observa = arg;
+}
+
+bool mem_salva(mem_t *self, FILE *arq)
+{
+  // de uma memória em arquivo, só a parte que já foi usada
+  return inst_escreve_marca(arq, "MEM ")
+         && inst_escreve_int(arq, self->tam)
+         && inst_escreve_int(arq, self->tam_arquivo)
+         && inst_escreve_vetor(arq, self->conteudo, self->tam_arquivo);
+}
+
+bool mem_restaura(mem_t *self, FILE *arq)
+{
+  int usado;
+  if (!inst_confere_marca(arq, "MEM ") || !inst_confere_int(arq, self->tam)
+      || !inst_le_int(arq, &usado) || usado < 0 || usado > self->tam) {
+    return false;
+  }
+  if (garante_arquivo(self, usado) != ERR_OK) return false;
+  return inst_le_vetor(arq, self->conteudo, usado);
+}
@@ -7,6 +7,8 @@
 #define MEMORIA_H
 
 #include "err.h"
+#include <stdbool.h>
+#include <stdio.h>
 
 // tipo opaco que representa a memória
 typedef struct mem_t mem_t;
@@ -16,6 +18,16 @@ typedef struct mem_t mem_t;
 //   as operações sobre essa memória
 mem_t *mem_cria(int tam);
 
+// cria uma região de memória com capacidade para 'tam' valores, guardados no
+//   arquivo 'nome' (mapeado na memória do hospedeiro)
+// o arquivo é criado se não existir, e cresce sob demanda, esparso, à medida
+//   que os endereços são usados; se já existir, o conteúdo é mantido, e a
+//   memória começa com os valores de uma execução anterior
+// serve para memórias grandes (a memória secundária) que são pouco usadas:
+//   a parte não usada não ocupa memória do hospedeiro nem tempo na criação
+// retorna NULL se não conseguir abrir ou mapear o arquivo
+mem_t *mem_cria_arquivo(char *nome, int tam);
+
 // destrói uma região de memória
 // nenhuma outra operação pode ser realizada na região após esta chamada
 void mem_destroi(mem_t *self);
@@ -31,4 +43,38 @@ err_t mem_le(mem_t *self, int endereco, int *pvalor);
 // retorna erro ERR_END_INV se endereço inválido
 err_t mem_escreve(mem_t *self, int endereco, int valor);
 
+// operações em bloco: transferem 'tam' valores consecutivos a partir de
+//   'endereco', validando o intervalo todo de uma vez
+// retornam erro ERR_END_INV (e não transferem nada) se alguma parte do
+//   intervalo for inválida
+
+// coloca em 'valores' os 'tam' valores a partir de 'endereco'
+err_t mem_le_bloco(mem_t *self, int endereco, int tam, int *valores);
+
+// coloca os 'tam' valores de 'valores' na memória a partir de 'endereco'
+err_t mem_escreve_bloco(mem_t *self, int endereco, int tam, const int *valores);
+
+// copia 'tam' valores da memória 'origem' a partir de 'end_origem' para
+//   a memória 'self' a partir de 'endereco'
+// as memórias podem ser a mesma, desde que os dois intervalos não se sobreponham
+err_t mem_copia(mem_t *self, int endereco, mem_t *origem, int end_origem, int tam);
+
+// tipo da função chamada após cada escrita na memória, com o endereço alterado
+typedef void (*mem_f_observa_t)(void *arg, int endereco);
+
+// define uma função a ser chamada (com o argumento 'arg') após cada escrita
+//   bem sucedida na memória que altera o seu conteúdo -- usado pela CPU para
+//   saber quando uma instrução que ela já decodificou é alterada
+// se 'f_observa' for NULL, não chama nada
+void mem_define_observador(mem_t *self, mem_f_observa_t f_observa, void *arg);
+
+// grava o conteúdo da memória no arquivo 'arq' (ver instantaneo.h)
+// de uma memória em arquivo, grava só a parte que já foi usada
+bool mem_salva(mem_t *self, FILE *arq);
+
+// recupera o conteúdo gravado por mem_salva numa memória do mesmo tamanho
+// o observador não é avisado: quem guarda algo que depende do conteúdo
+//   deve ser restaurado (ou esvaziado) depois
+bool mem_restaura(mem_t *self, FILE *arq);
+
 #endif // MEMORIA_H
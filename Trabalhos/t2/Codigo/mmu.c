@@ -4,17 +4,55 @@
 // so24b
 
 #include "mmu.h"
+#include "instantaneo.h"
 #include <stdlib.h>
 #include <assert.h>
 
+_Static_assert(TAM_PAGINA > 0 && (TAM_PAGINA & (TAM_PAGINA - 1)) == 0,
+               "TAM_PAGINA deve ser potência de 2");
+
+// ASID da tabela definida sem identificação (mmu_define_tabpag)
+#define SEM_ASID -1
+
+// uma entrada da TLB
+typedef struct {
+  // a entrada contém uma tradução
+  bool valida;
+  // espaço de endereçamento e página traduzida
+  int asid;
+  int pagina;
+  // quadro correspondente à página
+  int quadro;
+  // os bits de acesso e alteração já estão marcados na tabela de páginas
+  bool acessada;
+  bool alterada;
+  // a página está protegida contra escrita
+  bool protegida;
+} tlb_t;
+
 // tipo de dados opaco para representar uma MMU
 struct mmu_t {
   // memória física
   mem_t *mem;
   // tabela de páginas
   tabpag_t *tabpag;
+  // ASID da tabela de páginas
+  int asid;
+  // TLB, indexada pelo número da página
+  tlb_t tlb[MMU_TAM_TLB];
+  // estatísticas da TLB
+  long acertos;
+  long falhas;
 };
 
+// invalida todas as entradas da TLB
+static void mmu__esvazia_tlb(mmu_t *self)
+{
+  for (int i = 0; i < MMU_TAM_TLB; i++) {
+    self->tlb[i].valida = false;
+  }
+}
+
 mmu_t *mmu_cria(mem_t *mem)
 {
   mmu_t *self;
@@ -22,6 +60,13 @@ mmu_t *mmu_cria(mem_t *mem)
   assert(self != NULL);
   self->mem = mem;
   self->tabpag = NULL;
+  self->asid = SEM_ASID;
+  // todos os campos começam definidos, porque são gravados nos instantâneos
+  for (int i = 0; i < MMU_TAM_TLB; i++) {
+    self->tlb[i] = (tlb_t){ .valida = false };
+  }
+  self->acertos = 0;
+  self->falhas = 0;
   return self;
 }
 
@@ -36,21 +81,105 @@ void mmu_destroi(mmu_t *self)
 void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag)
 {
   self->tabpag = tabpag;
+  self->asid = SEM_ASID;
+  mmu__esvazia_tlb(self);
+}
+
+void mmu_define_tabpag_asid(mmu_t *self, tabpag_t *tabpag, int asid)
+{
+  assert(asid >= 0);
+  // as entradas sem ASID podem ser de qualquer tabela
+  if (self->asid == SEM_ASID) mmu__esvazia_tlb(self);
+  self->tabpag = tabpag;
+  self->asid = asid;
+}
+
+void mmu_invalida_pagina(mmu_t *self, int asid, int pagina)
+{
+  tlb_t *e = &self->tlb[pagina & (MMU_TAM_TLB - 1)];
+  if (e->valida && e->asid == asid && e->pagina == pagina) {
+    e->valida = false;
+  }
+}
+
+void mmu_invalida_asid(mmu_t *self, int asid)
+{
+  for (int i = 0; i < MMU_TAM_TLB; i++) {
+    if (self->tlb[i].asid == asid) self->tlb[i].valida = false;
+  }
+}
+
+int mmu_asid(mmu_t *self)
+{
+  return self->asid;
+}
+
+long mmu_tlb_acertos(mmu_t *self)
+{
+  return self->acertos;
+}
+
+long mmu_tlb_falhas(mmu_t *self)
+{
+  return self->falhas;
 }
 
-// tradur o endereço virtual 'endvirt', colocando o endereço físico
-//   correspondente em 'pendfis'.
+// traduz o endereço virtual 'endvirt', colocando o endereço físico
+//   correspondente em 'pendfis' e a entrada da TLB usada em 'pe'
+// usa a TLB, e a preenche em caso de falha
 // retorna ERR_OK ou um erro se a tradução não for possível
-static err_t mmu__traduz(mmu_t *self, int endvirt, int *pendfis)
+static err_t mmu__traduz(mmu_t *self, int endvirt, int *pendfis, tlb_t **pe)
 {
-  int pagina = endvirt / TAM_PAGINA;
-  int deslocamento = endvirt % TAM_PAGINA;
-  int quadro;
-  err_t err = tabpag_traduz(self->tabpag, pagina, &quadro);
-  if (err == ERR_OK) {
-    *pendfis = quadro * TAM_PAGINA + deslocamento;
+  int pagina = PAGINA_DO_END(endvirt);
+  int deslocamento = DESLOC_DO_END(endvirt);
+  tlb_t *e = &self->tlb[pagina & (MMU_TAM_TLB - 1)];
+  if (e->valida && e->pagina == pagina && e->asid == self->asid) {
+    self->acertos++;
+  } else {
+    self->falhas++;
+    int quadro;
+    err_t err = tabpag_traduz(self->tabpag, pagina, &quadro);
+    if (err != ERR_OK) return err;
+    e->valida = true;
+    e->asid = self->asid;
+    e->pagina = pagina;
+    e->quadro = quadro;
+    e->acessada = false;
+    e->alterada = false;
+    e->protegida = tabpag_pagina_protegida(self->tabpag, pagina);
+  }
+  *pendfis = END_DA_PAGINA(e->quadro) | deslocamento;
+  *pe = e;
+  return ERR_OK;
+}
+
+// marca o acesso à página da entrada 'e' da TLB (e a alteração, se
+//   'alteracao' for true)
+// só altera a tabela de páginas se os bits ainda não estiverem marcados
+static void mmu__marca_acesso(mmu_t *self, tlb_t *e, bool alteracao)
+{
+  if (!e->acessada || (alteracao && !e->alterada)) {
+    tabpag_marca_bit_acesso(self->tabpag, e->pagina, alteracao);
+    e->acessada = true;
+    if (alteracao) e->alterada = true;
   }
-  return err;
+}
+
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo)
+{
+  bool traduz = modo != supervisor && self->tabpag != NULL;
+  int endfis = endvirt;
+  tlb_t *e = NULL;
+  if (traduz) {
+    err_t err = mmu__traduz(self, endvirt, &endfis, &e);
+    if (err != ERR_OK) return err;
+  }
+  if (endfis < 0 || endfis >= mem_tam(self->mem)) return ERR_END_INV;
+  if (traduz) {
+    mmu__marca_acesso(self, e, false);
+  }
+  *pendfis = endfis;
+  return ERR_OK;
 }
 
 err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
@@ -61,11 +190,12 @@ err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
     return mem_le(self->mem, endvirt, pvalor);
   }
   int endfis;
-  err_t err = mmu__traduz(self, endvirt, &endfis);
+  tlb_t *e = NULL;
+  err_t err = mmu__traduz(self, endvirt, &endfis, &e);
   if (err == ERR_OK) {
     err = mem_le(self->mem, endfis, pvalor);
     if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, false);
+      mmu__marca_acesso(self, e, false);
     }
   }
   return err;
@@ -79,12 +209,74 @@ err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo)
     return mem_escreve(self->mem, endvirt, valor);
   }
   int endfis;
-  err_t err = mmu__traduz(self, endvirt, &endfis);
+  tlb_t *e = NULL;
+  err_t err = mmu__traduz(self, endvirt, &endfis, &e);
+  if (err == ERR_OK && e->protegida) err = ERR_PAG_PROTEGIDA;
   if (err == ERR_OK) {
     err = mem_escreve(self->mem, endfis, valor);
     if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, true);
+      mmu__marca_acesso(self, e, true);
     }
   }
   return err;
 }
+
+// as entradas da TLB são gravadas campo a campo (tlb_t tem preenchimento)
+static bool mmu__salva_entrada(tlb_t *e, FILE *arq)
+{
+  return inst_escreve_int(arq, e->valida)
+         && inst_escreve_int(arq, e->asid)
+         && inst_escreve_int(arq, e->pagina)
+         && inst_escreve_int(arq, e->quadro)
+         && inst_escreve_int(arq, e->acessada)
+         && inst_escreve_int(arq, e->alterada)
+         && inst_escreve_int(arq, e->protegida);
+}
+
+static bool mmu__restaura_entrada(tlb_t *e, FILE *arq)
+{
+  int valida, acessada, alterada, protegida;
+  if (!inst_le_int(arq, &valida)
+      || !inst_le_int(arq, &e->asid)
+      || !inst_le_int(arq, &e->pagina)
+      || !inst_le_int(arq, &e->quadro)
+      || !inst_le_int(arq, &acessada)
+      || !inst_le_int(arq, &alterada)
+      || !inst_le_int(arq, &protegida)) {
+    return false;
+  }
+  e->valida = valida;
+  e->acessada = acessada;
+  e->alterada = alterada;
+  e->protegida = protegida;
+  return true;
+}
+
+bool mmu_salva(mmu_t *self, FILE *arq)
+{
+  if (!inst_escreve_marca(arq, "MMU ")
+      || !inst_escreve_int(arq, self->asid)
+      || !inst_escreve_int(arq, MMU_TAM_TLB)) {
+    return false;
+  }
+  for (int i = 0; i < MMU_TAM_TLB; i++) {
+    if (!mmu__salva_entrada(&self->tlb[i], arq)) return false;
+  }
+  return inst_escreve(arq, &self->acertos, sizeof(self->acertos))
+         && inst_escreve(arq, &self->falhas, sizeof(self->falhas));
+}
+
+bool mmu_restaura(mmu_t *self, FILE *arq)
+{
+  self->tabpag = NULL;
+  if (!inst_confere_marca(arq, "MMU ")
+      || !inst_le_int(arq, &self->asid)
+      || !inst_confere_int(arq, MMU_TAM_TLB)) {
+    return false;
+  }
+  for (int i = 0; i < MMU_TAM_TLB; i++) {
+    if (!mmu__restaura_entrada(&self->tlb[i], arq)) return false;
+  }
+  return inst_le(arq, &self->acertos, sizeof(self->acertos))
+         && inst_le(arq, &self->falhas, sizeof(self->falhas));
+}
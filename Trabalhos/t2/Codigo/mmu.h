@@ -10,6 +10,16 @@
 // realiza a tradução de endereços virtuais do espaço de endereçamento
 //   de um processo em endereços físicos da memória principal
 // implementa memória virtual por paginação
+// as traduções recentes são mantidas em uma TLB (em software), mapeada
+//   diretamente pelo número da página; cada entrada é identificada pelo
+//   ASID (identificador do espaço de endereçamento) da tabela de páginas
+//   que a gerou, para não ser necessário esvaziar a TLB a cada troca de
+//   tabela
+// a TLB guarda também se os bits de acesso e alteração da página já foram
+//   marcados na tabela, e se ela está protegida contra escrita; quem alterar
+//   uma tabela de páginas que pode estar em uso (invalidar página, mudar
+//   quadro, zerar bit, mudar a proteção) deve invalidar a página
+//   correspondente na MMU (mmu_invalida_pagina)
 
 // tipo opaco que representa a MMU
 typedef struct mmu_t mmu_t;
@@ -20,8 +30,23 @@ typedef struct mmu_t mmu_t;
 #include "cpu.h"
 
 // tamanho de uma página, em palavras de memória
-// t2: pode ser alterado para comparar configurações diferentes
-#define TAM_PAGINA 10
+// deve ser uma potência de 2, para a tradução ser feita com deslocamento e
+//   máscara de bits em vez de divisão
+// t2: pode ser alterado para comparar configurações diferentes, inclusive
+//   na compilação (-DTAM_PAGINA=16, ver o alvo 'paginas' no Makefile)
+#ifndef TAM_PAGINA
+#define TAM_PAGINA 8
+#endif
+#define LOG2_TAM_PAGINA __builtin_ctz(TAM_PAGINA)
+
+// número da página e deslocamento na página de um endereço,
+//   e endereço do início de uma página
+#define PAGINA_DO_END(end) ((end) >> LOG2_TAM_PAGINA)
+#define DESLOC_DO_END(end) ((end) & (TAM_PAGINA - 1))
+#define END_DA_PAGINA(pag) ((pag) << LOG2_TAM_PAGINA)
+
+// número de entradas na TLB (deve ser potência de 2)
+#define MMU_TAM_TLB 64
 
 // cria uma MMU para gerenciar acessos à memória
 // retorna um ponteiro para um descritor, que deverá ser usado em todas
@@ -36,8 +61,33 @@ void mmu_destroi(mmu_t *self);
 
 // define a tabela de páginas a usar nas próximas traduções
 // se tabpag for NULL, os acessos serão repassados sem alteração à memória
+// esvazia a TLB
 void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag);
 
+// define a tabela de páginas a usar nas próximas traduções, identificada
+//   pelo ASID 'asid' (>= 0, único para cada tabela, e.g. o pid do processo)
+// as entradas na TLB de outros ASIDs são mantidas, para serem reaproveitadas
+//   quando sua tabela voltar a ser usada
+void mmu_define_tabpag_asid(mmu_t *self, tabpag_t *tabpag, int asid);
+
+// invalida a tradução da página 'pagina' do ASID 'asid' na TLB
+// deve ser chamada quando a página for alterada na tabela de páginas
+void mmu_invalida_pagina(mmu_t *self, int asid, int pagina);
+
+// invalida todas as traduções do ASID 'asid' na TLB
+// deve ser chamada antes de a tabela correspondente ser destruída, caso o
+//   ASID possa vir a ser reutilizado
+void mmu_invalida_asid(mmu_t *self, int asid);
+
+// retorna o ASID da tabela de páginas em uso, -1 se ela foi definida sem ASID
+//   (ou não foi definida)
+int mmu_asid(mmu_t *self);
+
+// retorna o número de traduções feitas pela TLB (acertos) e o número de
+//   traduções que precisaram consultar a tabela de páginas (falhas)
+long mmu_tlb_acertos(mmu_t *self);
+long mmu_tlb_falhas(mmu_t *self);
+
 // coloca na posição apontada por 'pvalor' o valor que está na memória
 //   no endereço físico correspondente ao endereço virtual 'endvirt'
 // marca a página como acessada se o acesso for bem sucedido
@@ -48,14 +98,33 @@ void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag);
 //   à memória sem tradução
 err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo);
 
+// traduz o endereço virtual 'endvirt' no endereço físico correspondente,
+//   colocado na posição apontada por 'pendfis'
+// a tradução é a mesma de mmu_le, e marca a página como acessada da mesma
+//   forma; é usada pela CPU para buscar instruções
+// retorna erro se a tradução não for possível (ver tabpag_traduz) ou se o
+//   endereço físico resultante não existir na memória (ERR_END_INV)
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo);
+
 // coloca 'valor' no endereço físico da memória correspondente ao endereço
 //   virtual 'endvirt'
 // marca a página como acessada e alterada se o acesso for bem sucedido
 // retorna erro se acesso não for possível, por um erro de tradução
-//   (ver tabpag_traduz) ou de memória (ver mem_escreve)
+//   (ver tabpag_traduz), por a página estar protegida contra escrita
+//   (ERR_PAG_PROTEGIDA) ou de memória (ver mem_escreve)
 // se o acesso for feito em modo supervisor, ou se a mmu não tiver tabela de
 //   página definida, trata 'endvirt' como endereço físico, repassa o acesso
 //   à memória sem tradução
 err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo);
 
+// grava no arquivo 'arq' o ASID em uso, a TLB e as suas estatísticas (ver
+//   instantaneo.h)
+bool mmu_salva(mmu_t *self, FILE *arq);
+
+// recupera o estado gravado por mmu_salva
+// a tabela de páginas não é gravada (é de quem a criou): depois de restaurar,
+//   quem usa a MMU deve definir de novo a tabela do ASID em uso (mmu_asid)
+//   com mmu_define_tabpag_asid, que mantém a TLB
+bool mmu_restaura(mmu_t *self, FILE *arq);
+
 #endif // MMU_H
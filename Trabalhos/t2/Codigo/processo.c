@@ -1,5 +1,6 @@
 #include "processo.h"
 #include "console.h"
+#include "instantaneo.h"
 #include <stdlib.h>
 
 #define NUM_TERMINAIS 4
@@ -12,6 +13,16 @@ typedef struct
     int entradas_estado[N_ESTADO];
     int tempo_total_estado[N_ESTADO];
     float tempo_medio_resposta;
+    int tempo_bloqueado[N_BLOQUEIO]; // por motivo de bloqueio
+
+    // paginação
+    int falhas_pagina;
+    int paginas_lidas;     // trazidas do disco para o processo, inclusive por pré-busca
+    int paginas_retiradas; // páginas privadas do processo tiradas da memória principal
+    int paginas_salvas;    // dessas, as alteradas, escritas na memória secundária
+    int paginas_perdidas;  // dessas, as substituídas numa falta de outro processo
+    int quadros;           // quadros com páginas privadas do processo
+    int pico_quadros;
 } metricas_processo_t;
 
 struct processo
@@ -28,11 +39,33 @@ struct processo
     motivo_bloqueio_t motivo_bloq;
     float prioridade_exec;
 
-    int endereco_mem_sec;
+    int endereco_mem_sec; // extensão com as cópias privadas das páginas da imagem
+    int paginas_mem_sec; // tamanho da imagem na memória secundária
+    int imagem; // imagem compartilhada do executável (ver imagens.h)
+    int n_paginas; // páginas da imagem (tamanho dos vetores por página)
+    bool *paginas_privadas; // páginas em que o processo já escreveu (cópia na escrita)
+    // quadro reservado para cada página privada que está sendo lida do disco, -1
+    //   se não tem (mantido pelo gerenciador de blocos, ver gere_blocos_reserva_bloco)
+    int *quadros_reservados;
+    // conjunto de trabalho: o tempo virtual conta as interrupções do relógio em
+    //   que o processo estava executando, e cada página guarda o tempo virtual
+    //   do último uso visto (-1 se nunca)
+    int tempo_virtual;
+    int *ultimo_uso;
+    int conjunto_trabalho;
+    int janela_prebusca; // quantas páginas seguintes trazer junto numa falta
     tabpag_t *tabpag;
 
     int tempo_desbloquio;
     metricas_processo_t *metricas;
+
+    // Encadeamento na fila em que o processo está (prontos ou bloqueados)
+    processo_t *ant;
+    processo_t *prox;
+    struct fila_processos *fila;
+    // Posição e ordem de chegada, nas filas de prioridade
+    int pos_fila;
+    long ordem_fila;
 };
 
 static metricas_processo_t *cria_metricas_processo()
@@ -51,6 +84,16 @@ static metricas_processo_t *cria_metricas_processo()
         metricas->entradas_estado[i] = 0;
         metricas->tempo_total_estado[i] = 0;
     }
+    for (int i = 0; i < N_BLOQUEIO; i++) {
+        metricas->tempo_bloqueado[i] = 0;
+    }
+    metricas->falhas_pagina = 0;
+    metricas->paginas_lidas = 0;
+    metricas->paginas_retiradas = 0;
+    metricas->paginas_salvas = 0;
+    metricas->paginas_perdidas = 0;
+    metricas->quadros = 0;
+    metricas->pico_quadros = 0;
 
     // Processo começa em PRONTO
     metricas->entradas_estado[PRONTO] = 1;
@@ -78,6 +121,15 @@ processo_t *processo_cria(int pid, int pc)
 
     p->prioridade_exec = 0.5;
     p->endereco_mem_sec = 0;
+    p->paginas_mem_sec = 0;
+    p->imagem = -1;
+    p->n_paginas = 0;
+    p->paginas_privadas = NULL;
+    p->quadros_reservados = NULL;
+    p->tempo_virtual = 0;
+    p->ultimo_uso = NULL;
+    p->conjunto_trabalho = 0;
+    p->janela_prebusca = 0;
     p->tempo_desbloquio = 0;
 
     p->tabpag = tabpag_cria();
@@ -87,12 +139,22 @@ processo_t *processo_cria(int pid, int pc)
 
     p->metricas = cria_metricas_processo();
 
+    p->ant = NULL;
+    p->prox = NULL;
+    p->fila = NULL;
+    p->pos_fila = -1;
+    p->ordem_fila = 0;
+
     return p;
 }
 
 void processo_destroi(processo_t *processo)
 {
     if (processo != NULL) {
+        tabpag_destroi(processo->tabpag);
+        free(processo->paginas_privadas);
+        free(processo->quadros_reservados);
+        free(processo->ultimo_uso);
         free(processo->metricas);
         free(processo);
     }
@@ -112,7 +174,16 @@ float processo_get_prioridade(processo_t *processo) { return processo->prioridad
 tabpag_t *processo_get_tabpag(processo_t *processo) { return processo->tabpag; }
 int processo_get_preempcoes(processo_t *processo) { return processo->metricas->preempcoes; }
 int processo_get_end_mem_sec(processo_t *processo) { return processo->endereco_mem_sec; }
+int processo_get_paginas_mem_sec(processo_t *processo) { return processo->paginas_mem_sec; }
+int processo_get_imagem(processo_t *processo) { return processo->imagem; }
+int processo_get_conjunto_trabalho(processo_t *processo) { return processo->conjunto_trabalho; }
+int processo_get_janela_prebusca(processo_t *processo) { return processo->janela_prebusca; }
 int processo_get_tempo_desbloqueio(processo_t *processo) { return processo->tempo_desbloquio; }
+processo_t *processo_get_ant(processo_t *processo) { return processo->ant; }
+processo_t *processo_get_prox(processo_t *processo) { return processo->prox; }
+struct fila_processos *processo_get_fila(processo_t *processo) { return processo->fila; }
+int processo_get_pos_fila(processo_t *processo) { return processo->pos_fila; }
+long processo_get_ordem_fila(processo_t *processo) { return processo->ordem_fila; }
 int processo_get_tempo_em_estado(processo_t *processo, estado_processo_t estado)
 {
     return processo->metricas->tempo_total_estado[estado];
@@ -132,6 +203,67 @@ void processo_set_tempo_desbloqueio(processo_t *processo, int tempo_desbloqueio)
     processo->tempo_desbloquio = tempo_desbloqueio;
 }
 void processo_set_end_mem_sec(processo_t *processo, int endereco) { processo->endereco_mem_sec = endereco; }
+void processo_set_paginas_mem_sec(processo_t *processo, int paginas) { processo->paginas_mem_sec = paginas; }
+void processo_set_janela_prebusca(processo_t *processo, int janela) { processo->janela_prebusca = janela; }
+void processo_set_ant(processo_t *processo, processo_t *ant) { processo->ant = ant; }
+void processo_set_prox(processo_t *processo, processo_t *prox) { processo->prox = prox; }
+void processo_set_fila(processo_t *processo, struct fila_processos *fila) { processo->fila = fila; }
+void processo_set_pos_fila(processo_t *processo, int pos) { processo->pos_fila = pos; }
+void processo_set_ordem_fila(processo_t *processo, long ordem) { processo->ordem_fila = ordem; }
+
+bool processo_define_imagem(processo_t *processo, int imagem, int n_paginas)
+{
+    bool *paginas_privadas = calloc(n_paginas, sizeof(bool));
+    int *quadros_reservados = malloc(n_paginas * sizeof(int));
+    int *ultimo_uso = malloc(n_paginas * sizeof(int));
+    if (paginas_privadas == NULL || quadros_reservados == NULL || ultimo_uso == NULL) {
+        console_printf("Erro ao alocar memória para as páginas do processo %d\n", processo->pid);
+        free(paginas_privadas);
+        free(quadros_reservados);
+        free(ultimo_uso);
+        return false;
+    }
+    for (int pagina = 0; pagina < n_paginas; pagina++) {
+        quadros_reservados[pagina] = -1;
+        ultimo_uso[pagina] = -1;
+    }
+    free(processo->paginas_privadas);
+    free(processo->quadros_reservados);
+    free(processo->ultimo_uso);
+    processo->paginas_privadas = paginas_privadas;
+    processo->quadros_reservados = quadros_reservados;
+    processo->ultimo_uso = ultimo_uso;
+    processo->imagem = imagem;
+    processo->n_paginas = n_paginas;
+    return true;
+}
+
+bool processo_pagina_privada(processo_t *processo, int pagina) { return processo->paginas_privadas[pagina]; }
+void processo_marca_pagina_privada(processo_t *processo, int pagina) { processo->paginas_privadas[pagina] = true; }
+int *processo_get_quadros_reservados(processo_t *processo) { return processo->quadros_reservados; }
+int processo_quadro_reservado(processo_t *processo, int pagina) { return processo->quadros_reservados[pagina]; }
+
+void processo_incrementa_tempo_virtual(processo_t *processo) { processo->tempo_virtual++; }
+void processo_registra_uso_pagina(processo_t *processo, int pagina)
+{
+    processo->ultimo_uso[pagina] = processo->tempo_virtual;
+}
+
+bool processo_pagina_no_conjunto_trabalho(processo_t *processo, int pagina, int janela)
+{
+    return processo->ultimo_uso[pagina] != -1 && processo->ultimo_uso[pagina] > processo->tempo_virtual - janela;
+}
+
+int processo_calcula_conjunto_trabalho(processo_t *processo, int janela)
+{
+    processo->conjunto_trabalho = 0;
+    for (int pagina = 0; pagina < processo->paginas_mem_sec; pagina++) {
+        if (processo_pagina_no_conjunto_trabalho(processo, pagina, janela)) {
+            processo->conjunto_trabalho++;
+        }
+    }
+    return processo->conjunto_trabalho;
+}
 
 // Métodos de estado
 void processo_bloqueia(processo_t *processo, motivo_bloqueio_t motivo)
@@ -165,52 +297,67 @@ void processo_atualiza_metricas(processo_t *processo, int tempo_percorrido)
     }
 
     processo->metricas->tempo_total_estado[processo->estado_atual] += tempo_percorrido;
+    if (processo->estado_atual == BLOQUEADO) {
+        processo->metricas->tempo_bloqueado[processo->motivo_bloq] += tempo_percorrido;
+    }
     processo->metricas->tempo_medio_resposta =
         (processo->metricas->tempo_total_estado[PRONTO] / processo->metricas->entradas_estado[PRONTO]);
 }
 
-int tempo_exec_processo_corrente(int quantum) { return QUANTUM_INICIAL - quantum; }
+void processo_registra_falha_pagina(processo_t *processo) { processo->metricas->falhas_pagina++; }
 
-void processo_atualiza_prioridade(processo_t *processo, int quantum)
-{
-    if (processo == NULL)
-        return;
+void processo_registra_pagina_lida(processo_t *processo) { processo->metricas->paginas_lidas++; }
 
-    processo->prioridade_exec =
-        (processo->prioridade_exec + (float)tempo_exec_processo_corrente(quantum) / (float)QUANTUM_INICIAL) / 2;
+void processo_registra_pagina_retirada(processo_t *processo, bool salva, bool por_outro)
+{
+    processo->metricas->paginas_retiradas++;
+    if (salva) {
+        processo->metricas->paginas_salvas++;
+    }
+    if (por_outro) {
+        processo->metricas->paginas_perdidas++;
+    }
 }
 
-bool processo_verifica_todos_mortos(processo_t **tabela_processos, int n_processos)
+void processo_define_quadros(processo_t *processo, int quadros)
 {
-    for (int i = 0; i < n_processos; i++) {
-        processo_t *processo = tabela_processos[i];
-        if (processo != NULL && processo->estado_atual != MORTO) {
-            return false;
-        }
+    processo->metricas->quadros = quadros;
+    if (quadros > processo->metricas->pico_quadros) {
+        processo->metricas->pico_quadros = quadros;
     }
-    return true;
 }
 
-processo_t *processo_busca_primeiro_em_estado(processo_t **tabela_processos, int n_processos, estado_processo_t estado)
+void processo_conta_quadro(processo_t *processo, int variacao)
 {
-    for (int i = 0; i < n_processos; i++) {
-        processo_t *processo = tabela_processos[i];
-        if (processo != NULL && processo->estado_atual == estado) {
-            return processo;
-        }
-    }
-    return NULL;
+    processo_define_quadros(processo, processo->metricas->quadros + variacao);
+}
+
+int processo_get_quadros(processo_t *processo) { return processo->metricas->quadros; }
+
+void processo_imprime_paginacao(processo_t *processo, FILE *arq)
+{
+    metricas_processo_t *m = processo->metricas;
+    fprintf(arq, "%d falhas, %d lidas, %d retiradas (%d salvas, %d por outros), %d quadros (pico %d), %d esperando página",
+            m->falhas_pagina, m->paginas_lidas, m->paginas_retiradas, m->paginas_salvas, m->paginas_perdidas,
+            m->quadros, m->pico_quadros, m->tempo_bloqueado[ESPERANDO_PAGINA]);
+}
+
+int tempo_exec_processo_corrente(int quantum) { return QUANTUM_INICIAL - quantum; }
+
+void processo_atualiza_prioridade(processo_t *processo, int quantum)
+{
+    if (processo == NULL)
+        return;
+
+    processo->prioridade_exec =
+        (processo->prioridade_exec + (float)tempo_exec_processo_corrente(quantum) / (float)QUANTUM_INICIAL) / 2;
 }
 
 processo_t *processo_busca_por_pid(processo_t **tabela_processos, int n_processos, int pid)
 {
-    for (int i = 0; i < n_processos; i++) {
-        processo_t *processo = tabela_processos[i];
-        if (processo != NULL && processo->pid == pid) {
-            return processo;
-        }
-    }
-    return NULL;
+    if (pid < 1 || pid > n_processos)
+        return NULL;
+    return tabela_processos[pid - 1];
 }
 
 int processo_calcula_terminal(int dispositivo, int terminal_base) { return dispositivo + terminal_base; }
@@ -228,6 +375,9 @@ void processo_imprime_metricas(processo_t *processo, FILE *arq)
         fprintf(arq, "  Entradas no estado %s: %d\n", processo_estado_para_string(j),
                 processo->metricas->entradas_estado[j]);
     }
+    fprintf(arq, "  Paginação: ");
+    processo_imprime_paginacao(processo, arq);
+    fprintf(arq, "\n");
 }
 
 // Métodos de utilitário
@@ -256,6 +406,8 @@ char *processo_motivo_para_string(motivo_bloqueio_t motivo)
         return "ESPERANDO_PROCESSO";
     case ESPERANDO_PAGINA:
         return "ESPERANDO_PAGINA";
+    case ESPERANDO_MEMORIA:
+        return "ESPERANDO_MEMORIA";
     case SEM_BLOQUEIO:
         return "SEM_BLOQUEIO";
     default:
@@ -263,6 +415,63 @@ char *processo_motivo_para_string(motivo_bloqueio_t motivo)
     }
 }
 
+// Instantâneo
+
+bool processo_salva(processo_t *processo, FILE *arq)
+{
+    bool tem_imagem = processo->paginas_privadas != NULL;
+    return inst_escreve_marca(arq, "PROC") && inst_escreve_int(arq, processo->pid) &&
+           inst_escreve_int(arq, processo->pc) && inst_escreve_int(arq, processo->reg_A) &&
+           inst_escreve_int(arq, processo->reg_X) && inst_escreve_int(arq, processo->complemento) &&
+           inst_escreve_int(arq, processo->erro) && inst_escreve_int(arq, processo->terminal) &&
+           inst_escreve_int(arq, processo->estado_atual) && inst_escreve_int(arq, processo->motivo_bloq) &&
+           inst_escreve(arq, &processo->prioridade_exec, sizeof(processo->prioridade_exec)) &&
+           inst_escreve_int(arq, processo->endereco_mem_sec) && inst_escreve_int(arq, processo->paginas_mem_sec) &&
+           inst_escreve_int(arq, processo->imagem) && inst_escreve_int(arq, tem_imagem ? processo->n_paginas : -1) &&
+           (!tem_imagem ||
+            (inst_escreve(arq, processo->paginas_privadas, processo->n_paginas * sizeof(bool)) &&
+             inst_escreve(arq, processo->ultimo_uso, processo->n_paginas * sizeof(int)))) &&
+           inst_escreve_int(arq, processo->tempo_virtual) && inst_escreve_int(arq, processo->conjunto_trabalho) &&
+           inst_escreve_int(arq, processo->janela_prebusca) && inst_escreve_int(arq, processo->tempo_desbloquio) &&
+           inst_escreve(arq, processo->metricas, sizeof(*processo->metricas)) &&
+           tabpag_salva(processo->tabpag, arq);
+}
+
+processo_t *processo_restaura(FILE *arq)
+{
+    int pid, pc;
+    if (!inst_confere_marca(arq, "PROC") || !inst_le_int(arq, &pid) || !inst_le_int(arq, &pc))
+        return NULL;
+    processo_t *p = processo_cria(pid, pc);
+    if (p == NULL)
+        return NULL;
+
+    int estado, motivo, n_paginas;
+    bool ok = inst_le_int(arq, &p->reg_A) && inst_le_int(arq, &p->reg_X) && inst_le_int(arq, &p->complemento) &&
+              inst_le_int(arq, &p->erro) && inst_le_int(arq, &p->terminal) && inst_le_int(arq, &estado) &&
+              inst_le_int(arq, &motivo) && inst_le(arq, &p->prioridade_exec, sizeof(p->prioridade_exec)) &&
+              inst_le_int(arq, &p->endereco_mem_sec) && inst_le_int(arq, &p->paginas_mem_sec) &&
+              inst_le_int(arq, &p->imagem) && inst_le_int(arq, &n_paginas) && estado >= 0 && estado < N_ESTADO &&
+              motivo >= 0 && motivo < N_BLOQUEIO;
+    if (ok && n_paginas >= 0) {
+        // a imagem é definida de novo só para alocar os vetores das páginas
+        ok = processo_define_imagem(p, p->imagem, n_paginas) &&
+             inst_le(arq, p->paginas_privadas, n_paginas * sizeof(bool)) &&
+             inst_le(arq, p->ultimo_uso, n_paginas * sizeof(int));
+    }
+    ok = ok && inst_le_int(arq, &p->tempo_virtual) && inst_le_int(arq, &p->conjunto_trabalho) &&
+         inst_le_int(arq, &p->janela_prebusca) && inst_le_int(arq, &p->tempo_desbloquio) &&
+         inst_le(arq, p->metricas, sizeof(*p->metricas)) && tabpag_restaura(p->tabpag, arq);
+    if (!ok) {
+        console_printf("Erro ao restaurar o processo %d\n", pid);
+        processo_destroi(p);
+        return NULL;
+    }
+    p->estado_atual = estado;
+    p->motivo_bloq = motivo;
+    return p;
+}
+
 void debug_tabela_processos(processo_t **tabela_processos, int limite_processos)
 {
     console_printf("==== Tabela de Processos ====\n");
@@ -20,12 +20,15 @@ typedef enum
     ESPERANDO_LEITURA,
     ESPERANDO_PROCESSO,
     ESPERANDO_PAGINA,
+    ESPERANDO_MEMORIA, // suspenso pelo controle de carga
     SEM_BLOQUEIO,
     N_BLOQUEIO
 } motivo_bloqueio_t;
 
 // Estrutura do processo
 typedef struct processo processo_t;
+// Fila de processos (ver fila_processos.h), encadeada no próprio processo
+struct fila_processos;
 
 // Funções de criação e destruição
 processo_t *processo_cria(int pid, int pc);
@@ -46,7 +49,16 @@ int processo_get_complemento(processo_t *processo);
 int processo_get_erro(processo_t *processo);
 tabpag_t *processo_get_tabpag(processo_t *processo);
 int processo_get_end_mem_sec(processo_t *processo);
+int processo_get_paginas_mem_sec(processo_t *processo);
+int processo_get_imagem(processo_t *processo);
+int processo_get_conjunto_trabalho(processo_t *processo);
+int processo_get_janela_prebusca(processo_t *processo);
 int processo_get_tempo_desbloqueio(processo_t *processo);
+processo_t *processo_get_ant(processo_t *processo);
+processo_t *processo_get_prox(processo_t *processo);
+struct fila_processos *processo_get_fila(processo_t *processo);
+int processo_get_pos_fila(processo_t *processo);
+long processo_get_ordem_fila(processo_t *processo);
 
 // Setters
 void processo_set_pc(processo_t *processo, int pc);
@@ -58,7 +70,37 @@ void processo_set_prioridade(processo_t *processo, float prioridade);
 void processo_set_complemento(processo_t *processo, int complemento);
 void processo_set_erro(processo_t *processo, int erro);
 void processo_set_end_mem_sec(processo_t *processo, int endereco);
+void processo_set_paginas_mem_sec(processo_t *processo, int paginas);
+void processo_set_janela_prebusca(processo_t *processo, int janela);
 void processo_set_tempo_desbloqueio(processo_t *processo, int tempo_desbloqueio);
+// Encadeamento nas filas, para uso somente por fila_processos.c
+void processo_set_ant(processo_t *processo, processo_t *ant);
+void processo_set_prox(processo_t *processo, processo_t *prox);
+void processo_set_fila(processo_t *processo, struct fila_processos *fila);
+void processo_set_pos_fila(processo_t *processo, int pos);
+void processo_set_ordem_fila(processo_t *processo, long ordem);
+
+// Imagem compartilhada (ver imagens.h): o processo passa a executar a imagem
+//   'imagem', de 'n_paginas' páginas, sem nenhuma cópia privada e sem nenhuma
+//   página usada; false se faltar memória
+bool processo_define_imagem(processo_t *processo, int imagem, int n_paginas);
+// a página já foi escrita pelo processo, que tem a sua própria cópia
+bool processo_pagina_privada(processo_t *processo, int pagina);
+void processo_marca_pagina_privada(processo_t *processo, int pagina);
+// índice, por página, dos quadros reservados para páginas privadas que estão
+//   sendo lidas do disco (passado para gere_blocos_reserva_bloco)
+int *processo_get_quadros_reservados(processo_t *processo);
+// quadro reservado para a página privada que está sendo lida, -1 se não tem
+int processo_quadro_reservado(processo_t *processo, int pagina);
+
+// Conjunto de trabalho: as páginas usadas nas últimas 'janela' unidades do tempo
+//   virtual do processo (o tempo em que ele está executando, contado pelo SO)
+void processo_incrementa_tempo_virtual(processo_t *processo);
+// registra que a página foi usada no tempo virtual atual
+void processo_registra_uso_pagina(processo_t *processo, int pagina);
+bool processo_pagina_no_conjunto_trabalho(processo_t *processo, int pagina, int janela);
+// recalcula (e retorna) o tamanho do conjunto de trabalho, em páginas
+int processo_calcula_conjunto_trabalho(processo_t *processo, int janela);
 
 // Métodos de estado
 void processo_bloqueia(processo_t *processo, motivo_bloqueio_t motivo);
@@ -69,14 +111,34 @@ void processo_mata(processo_t *processo);
 void processo_atualiza_metricas(processo_t *processo, int tempo_percorrido);
 void processo_imprime_metricas(processo_t *processo, FILE *arq);
 
+// Métricas de paginação
+void processo_registra_falha_pagina(processo_t *processo);
+void processo_registra_pagina_lida(processo_t *processo);
+// uma página privada do processo saiu da memória principal; 'salva' se foi
+//   escrita na memória secundária, 'por_outro' se saiu numa falta de outro processo
+void processo_registra_pagina_retirada(processo_t *processo, bool salva, bool por_outro);
+// o processo passou a ter 'quadros' quadros com páginas privadas (atualiza o pico)
+void processo_define_quadros(processo_t *processo, int quadros);
+// o processo ganhou (variacao 1) ou perdeu (-1) um quadro com página privada
+void processo_conta_quadro(processo_t *processo, int variacao);
+// quadros com páginas privadas do processo, carregadas ou chegando
+int processo_get_quadros(processo_t *processo);
+// imprime as métricas de paginação numa linha, sem o fim de linha
+void processo_imprime_paginacao(processo_t *processo, FILE *arq);
+
+// Instantâneo (ver instantaneo.h): grava o processo, com a tabela de páginas
+//   e as métricas; o encadeamento nas filas é gravado pelas filas
+bool processo_salva(processo_t *processo, FILE *arq);
+// cria um processo com o estado gravado por processo_salva, NULL se der erro
+processo_t *processo_restaura(FILE *arq);
+
 // Métodos de utilitário
 char *processo_estado_para_string(estado_processo_t estado);
 char *processo_motivo_para_string(motivo_bloqueio_t motivo);
 
 // Métodos adicionais
+// A tabela de processos é indexada pelo PID: o processo com PID p está na posição p - 1
 processo_t *processo_busca_por_pid(processo_t **tabela_processos, int n_processos, int pid);
-processo_t *processo_busca_primeiro_em_estado(processo_t **tabela_processos, int n_processos, estado_processo_t estado);
-bool processo_verifica_todos_mortos(processo_t **tabela_processos, int n_processos);
 void processo_atualiza_prioridade(processo_t *processo, int quantum);
 int processo_calcula_terminal(int dispositivo, int terminal_base);
 void incrementa_preempcoes_processo(processo_t *processo);
@@ -0,0 +1,259 @@
+// registro.c
+// gravação e reprodução dos eventos externos da simulação
+// simulador de computador
+// so24b
+
+#include "registro.h"
+#include "console.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// tamanho máximo de uma linha do arquivo (o texto de um terminal é menor)
+#define TAM_LINHA 256
+
+struct registro_t {
+  relogio_t *relogio;
+  bool reproduz;
+
+  // gravação
+  FILE *arq;
+  // tics de espera ainda não gravados, todos no instante 'instante_espera'
+  int n_espera;
+  int instante_espera;
+
+  // reprodução: os eventos de entrada e as leituras do relógio real, em ordem,
+  //   e o próximo de cada um a ser reproduzido
+  registro_evento_t *entradas;
+  int n_entradas;
+  int prox_entrada;
+  registro_evento_t *relogio_real;
+  int n_relogio_real;
+  int prox_relogio_real;
+  // instante em que a execução deixou de ser igual à gravada, -1 se não deixou
+  int divergencia;
+};
+
+static registro_t *registro_cria(relogio_t *relogio, bool reproduz)
+{
+  registro_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+
+  self->relogio = relogio;
+  self->reproduz = reproduz;
+  self->arq = NULL;
+  self->n_espera = 0;
+  self->instante_espera = 0;
+  self->entradas = NULL;
+  self->n_entradas = 0;
+  self->prox_entrada = 0;
+  self->relogio_real = NULL;
+  self->n_relogio_real = 0;
+  self->prox_relogio_real = 0;
+  self->divergencia = -1;
+
+  return self;
+}
+
+registro_t *registro_cria_gravacao(char *nome, relogio_t *relogio)
+{
+  FILE *arq = fopen(nome, "w");
+  if (arq == NULL) {
+    perror(nome);
+    return NULL;
+  }
+  registro_t *self = registro_cria(relogio, false);
+  self->arq = arq;
+  fprintf(arq, "# so24b: eventos externos (instante tipo dados)\n");
+  return self;
+}
+
+// GRAVAÇÃO
+
+// grava os tics de espera juntados até agora
+static void grava_espera_pendente(registro_t *self)
+{
+  if (self->n_espera > 0) {
+    fprintf(self->arq, "%d %c %d\n",
+            self->instante_espera, EV_ESPERA, self->n_espera);
+    self->n_espera = 0;
+  }
+}
+
+// grava um evento no instante atual; 'dados' pode ser NULL
+static void grava(registro_t *self, registro_tipo_t tipo, char *dados)
+{
+  if (self->reproduz) return;
+  grava_espera_pendente(self);
+  fprintf(self->arq, "%d %c", relogio_agora(self->relogio), tipo);
+  if (dados != NULL) fprintf(self->arq, " %s", dados);
+  fputc('\n', self->arq);
+}
+
+void registro_grava_terminal(registro_t *self, char id_terminal, char *texto)
+{
+  char dados[TAM_LINHA];
+  snprintf(dados, sizeof(dados), "%c %s", id_terminal, texto);
+  grava(self, EV_TERMINAL, dados);
+}
+
+void registro_grava_limpeza(registro_t *self, char id_terminal)
+{
+  char dados[2] = { id_terminal, '\0' };
+  grava(self, EV_LIMPA, dados);
+}
+
+void registro_grava_comando(registro_t *self, char comando)
+{
+  char dados[2] = { comando, '\0' };
+  grava(self, EV_COMANDO, dados);
+}
+
+void registro_grava_espera(registro_t *self)
+{
+  if (self->reproduz) return;
+  int agora = relogio_agora(self->relogio);
+  if (self->n_espera > 0 && self->instante_espera != agora) {
+    grava_espera_pendente(self);
+  }
+  self->instante_espera = agora;
+  self->n_espera++;
+}
+
+// REPRODUÇÃO
+
+static void insere_evento(registro_evento_t **peventos, int *pn,
+                          registro_evento_t *evento)
+{
+  // o vetor cresce de potência em potência de 2
+  if ((*pn & (*pn - 1)) == 0) {
+    int cap = *pn == 0 ? 1 : *pn * 2;
+    *peventos = realloc(*peventos, cap * sizeof(registro_evento_t));
+    assert(*peventos != NULL);
+  }
+  (*peventos)[(*pn)++] = *evento;
+}
+
+// interpreta uma linha do arquivo (sem o '\n'), retorna false se for inválida
+static bool le_evento(registro_t *self, char *linha)
+{
+  registro_evento_t ev = { 0, 0, '\0', 0, NULL };
+  char tipo;
+  int pos;
+  if (sscanf(linha, "%d %c%n", &ev.instante, &tipo, &pos) != 2) return false;
+  ev.tipo = tipo;
+  char *dados = linha + pos;
+  if (*dados == ' ') dados++;
+  switch (ev.tipo) {
+    case EV_TERMINAL:
+      if (dados[0] == '\0') return false;
+      ev.id = dados[0];
+      ev.texto = strdup(dados[1] == ' ' ? &dados[2] : &dados[1]);
+      assert(ev.texto != NULL);
+      break;
+    case EV_LIMPA:
+    case EV_COMANDO:
+      if (dados[0] == '\0') return false;
+      ev.id = dados[0];
+      break;
+    case EV_ESPERA:
+    case EV_RELOGIO_REAL:
+      if (sscanf(dados, "%d", &ev.valor) != 1) return false;
+      break;
+    default:
+      return false;
+  }
+  if (ev.tipo == EV_RELOGIO_REAL) {
+    insere_evento(&self->relogio_real, &self->n_relogio_real, &ev);
+  } else {
+    insere_evento(&self->entradas, &self->n_entradas, &ev);
+  }
+  return true;
+}
+
+registro_t *registro_cria_reproducao(char *nome, relogio_t *relogio)
+{
+  FILE *arq = fopen(nome, "r");
+  if (arq == NULL) {
+    perror(nome);
+    return NULL;
+  }
+  registro_t *self = registro_cria(relogio, true);
+  char linha[TAM_LINHA];
+  int n_linha = 0;
+  while (fgets(linha, sizeof(linha), arq) != NULL) {
+    n_linha++;
+    linha[strcspn(linha, "\n")] = '\0';
+    if (linha[0] == '#' || linha[0] == '\0') continue;
+    if (!le_evento(self, linha)) {
+      fprintf(stderr, "%s:%d: evento inválido\n", nome, n_linha);
+      fclose(arq);
+      registro_destroi(self);
+      return NULL;
+    }
+  }
+  fclose(arq);
+  return self;
+}
+
+registro_evento_t *registro_proxima_entrada(registro_t *self)
+{
+  if (self->prox_entrada >= self->n_entradas) return NULL;
+  registro_evento_t *ev = &self->entradas[self->prox_entrada];
+  if (ev->instante > relogio_agora(self->relogio)) return NULL;
+  self->prox_entrada++;
+  return ev;
+}
+
+int registro_tempo_ate_entrada(registro_t *self)
+{
+  if (!self->reproduz || self->prox_entrada >= self->n_entradas) return -1;
+  return self->entradas[self->prox_entrada].instante
+         - relogio_agora(self->relogio);
+}
+
+int registro_relogio_real(registro_t *self, int valor)
+{
+  int agora = relogio_agora(self->relogio);
+  if (!self->reproduz) {
+    char dados[20];
+    sprintf(dados, "%d", valor);
+    grava(self, EV_RELOGIO_REAL, dados);
+    return valor;
+  }
+  if (self->divergencia >= 0) return valor;
+  // as leituras têm que acontecer nos mesmos instantes da gravação
+  if (self->prox_relogio_real >= self->n_relogio_real
+      || self->relogio_real[self->prox_relogio_real].instante != agora) {
+    self->divergencia = agora;
+    console_printf("registro: leitura do relógio real fora do gravado"
+                   " no instante %d", agora);
+    return valor;
+  }
+  return self->relogio_real[self->prox_relogio_real++].valor;
+}
+
+bool registro_reproduzindo(registro_t *self)
+{
+  return self->reproduz;
+}
+
+void registro_destroi(registro_t *self)
+{
+  if (self->arq != NULL) {
+    grava_espera_pendente(self);
+    fclose(self->arq);
+  }
+  if (self->divergencia >= 0) {
+    fprintf(stderr, "registro: a execução divergiu da gravada no instante %d\n",
+            self->divergencia);
+  }
+  for (int i = 0; i < self->n_entradas; i++) {
+    free(self->entradas[i].texto);
+  }
+  free(self->entradas);
+  free(self->relogio_real);
+  free(self);
+}
@@ -0,0 +1,81 @@
+// registro.h
+// gravação e reprodução dos eventos externos da simulação
+// simulador de computador
+// so24b
+
+#ifndef REGISTRO_H
+#define REGISTRO_H
+
+// A simulação só não é determinística por causa do que vem de fora dela: os
+//   comandos do operador na console, o que é digitado nos terminais (ou lido
+//   dos arquivos de entrada, no modo lote), o tempo que passa para os terminais
+//   com a simulação parada e a leitura do relógio real (o tempo de CPU do
+//   simulador). O registro grava esses eventos num arquivo, cada um com o
+//   instante (relogio_agora) em que aconteceu, e depois os reproduz nos mesmos
+//   instantes, para que outra execução (inclusive em modo lote, sem tela) seja
+//   idêntica à gravada.
+// O arquivo é texto, um evento por linha: o instante, o tipo e os dados do
+//   evento (ver registro_evento_t); linhas começando com '#' são ignoradas.
+
+typedef struct registro_t registro_t;
+
+#include "relogio.h"
+
+#include <stdbool.h>
+
+// tipos de evento, com o caractere que os identifica no arquivo
+typedef enum {
+  EV_TERMINAL = 'T',     // texto entrado no terminal 'id' (em 'texto')
+  EV_LIMPA = 'Z',        // limpeza da saída do terminal 'id'
+  EV_ESPERA = 'Q',       // 'valor' tics dos terminais com a simulação parada
+  EV_COMANDO = 'C',      // comando 'id' do operador para o controlador
+  EV_RELOGIO_REAL = 'R', // leitura do relógio real, que resultou em 'valor'
+} registro_tipo_t;
+
+typedef struct {
+  int instante;
+  registro_tipo_t tipo;
+  char id;
+  int valor;
+  char *texto;
+} registro_evento_t;
+
+// cria um registro que grava no arquivo 'nome' os eventos da simulação cujo
+//   tempo é contado por 'relogio'
+// retorna NULL (com a mensagem em stderr) se não conseguir criar o arquivo
+registro_t *registro_cria_gravacao(char *nome, relogio_t *relogio);
+
+// cria um registro que reproduz os eventos gravados no arquivo 'nome'
+// retorna NULL (com a mensagem em stderr) se não conseguir ler o arquivo
+registro_t *registro_cria_reproducao(char *nome, relogio_t *relogio);
+
+// termina a gravação (ou a reprodução, avisando em stderr se ela divergiu)
+void registro_destroi(registro_t *self);
+
+// true se o registro reproduz os eventos, false se grava
+bool registro_reproduzindo(registro_t *self);
+
+// Gravação dos eventos que chegam à console, no instante atual
+// não fazem nada se o registro estiver reproduzindo
+void registro_grava_terminal(registro_t *self, char id_terminal, char *texto);
+void registro_grava_limpeza(registro_t *self, char id_terminal);
+void registro_grava_comando(registro_t *self, char comando);
+// um tic dos terminais com a simulação parada (os de um mesmo instante são
+//   juntados num evento só)
+void registro_grava_espera(registro_t *self);
+
+// Reprodução dos eventos que chegam à console
+// retorna o próximo evento de entrada (qualquer tipo menos EV_RELOGIO_REAL)
+//   se o instante dele já chegou, ou NULL
+registro_evento_t *registro_proxima_entrada(registro_t *self);
+// retorna quanto tempo falta para o próximo evento de entrada, -1 se não tem
+//   (o controlador não deve deixar o relógio passar desse instante sem
+//   dar à console a chance de reproduzi-lo)
+int registro_tempo_ate_entrada(registro_t *self);
+
+// leitura do relógio real, que resultou em 'valor'
+// na gravação, grava e retorna 'valor'; na reprodução, retorna o valor gravado
+//   (ou 'valor', se a execução divergiu da gravada)
+int registro_relogio_real(registro_t *self, int valor);
+
+#endif // REGISTRO_H
@@ -4,6 +4,7 @@
 // so24b
 
 #include "relogio.h"
+#include "instantaneo.h"
 
 #include <stdlib.h>
 #include <time.h>
@@ -16,6 +17,8 @@ struct relogio_t {
   int t_ate_interrupcao;
   // 1 se está gerando interrupção, 0 se não
   int interrupcao;
+  // grava ou reproduz as leituras do relógio real, se não for NULL
+  registro_t *registro;
 };
 
 relogio_t *relogio_cria(void)
@@ -25,6 +28,9 @@ relogio_t *relogio_cria(void)
   assert(self != NULL);
 
   self->agora = 0;
+  self->t_ate_interrupcao = 0;
+  self->interrupcao = 0;
+  self->registro = NULL;
 
   return self;
 }
@@ -46,6 +52,20 @@ void relogio_tictac(relogio_t *self)
   }
 }
 
+void relogio_avanca(relogio_t *self, int n)
+{
+  self->agora += n;
+  // a interrupção é gerada se o tempo até ela chega a zero nesses n tics
+  if (self->t_ate_interrupcao != 0) {
+    if (self->t_ate_interrupcao > n) {
+      self->t_ate_interrupcao -= n;
+    } else {
+      self->t_ate_interrupcao = 0;
+      self->interrupcao = 1;
+    }
+  }
+}
+
 int relogio_agora(relogio_t *self)
 {
   return self->agora;
@@ -61,6 +81,9 @@ err_t relogio_leitura(void *disp, int id, int *pvalor)
       break;
     case 1:
       *pvalor = clock()/(CLOCKS_PER_SEC/1000);
+      if (self->registro != NULL) {
+        *pvalor = registro_relogio_real(self->registro, *pvalor);
+      }
       break;
     case 2:
       *pvalor = self->t_ate_interrupcao;
@@ -90,3 +113,24 @@ err_t relogio_escrita(void *disp, int id, int pvalor)
   }
   return err;
 }
+
+void relogio_define_registro(relogio_t *self, registro_t *registro)
+{
+  self->registro = registro;
+}
+
+bool relogio_salva(relogio_t *self, FILE *arq)
+{
+  return inst_escreve_marca(arq, "RELO")
+         && inst_escreve_int(arq, self->agora)
+         && inst_escreve_int(arq, self->t_ate_interrupcao)
+         && inst_escreve_int(arq, self->interrupcao);
+}
+
+bool relogio_restaura(relogio_t *self, FILE *arq)
+{
+  return inst_confere_marca(arq, "RELO")
+         && inst_le_int(arq, &self->agora)
+         && inst_le_int(arq, &self->t_ate_interrupcao)
+         && inst_le_int(arq, &self->interrupcao);
+}
@@ -9,10 +9,13 @@
 // simulador do relógio
 // registra a passagem do tempo
 
-#include "err.h"
-
 typedef struct relogio_t relogio_t;
 
+#include "err.h"
+#include "registro.h"
+#include <stdbool.h>
+#include <stdio.h>
+
 // cria e inicializa um relógio
 relogio_t *relogio_cria(void);
 
@@ -24,6 +27,10 @@ void relogio_destroi(relogio_t *self);
 // esta função é chamada pelo controlador após a execução de cada instrução
 void relogio_tictac(relogio_t *self);
 
+// registra a passagem de 'n' unidades de tempo, como 'n' chamadas a tictac
+// usada pelo controlador quando executa várias instruções de uma vez
+void relogio_avanca(relogio_t *self, int n);
+
 // retorna a hora atual do sistema, em unidades de tempo
 int relogio_agora(relogio_t *self);
 
@@ -36,4 +43,13 @@ int relogio_agora(relogio_t *self);
 err_t relogio_leitura(void *disp, int id, int *pvalor);
 err_t relogio_escrita(void *disp, int id, int pvalor);
 
+// define o registro que grava ou reproduz as leituras do relógio real (o
+//   único valor do relógio que não é determinado pela simulação); NULL se não tem
+void relogio_define_registro(relogio_t *self, registro_t *registro);
+
+// grava no arquivo 'arq' a hora e o estado do timer (ver instantaneo.h)
+bool relogio_salva(relogio_t *self, FILE *arq);
+// recupera o estado gravado por relogio_salva
+bool relogio_restaura(relogio_t *self, FILE *arq);
+
 #endif // RELOGIO_H
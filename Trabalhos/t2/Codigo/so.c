@@ -6,10 +6,14 @@
 
 // INCLUDES {{{1
 #include "so.h"
+#include "disco.h"
 #include "dispositivos.h"
 #include "err.h"
 #include "fila_processos.h"
 #include "gere_blocos.h"
+#include "gere_mem_sec.h"
+#include "imagens.h"
+#include "instantaneo.h"
 #include "instrucao.h"
 #include "irq.h"
 #include "memoria.h"
@@ -23,13 +27,32 @@
 #include <stdbool.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 // CONSTANTES E TIPOS {{{1
 
 #define INTERVALO_INTERRUPCAO 50
 #define QUANTUM_INICIAL 10
-#define ESCALONADOR_ATUAL FIFO
-#define ALGORITMO_SUBSTITUICAO_ATUAL SIMPLES
+#define ESCALONADOR_ATUAL ROUND_ROBIN
+#define ALGORITMO_SUBSTITUICAO_ATUAL SEGUNDA_CHANCE
+// Pré-busca: numa falta de página, as páginas seguintes do processo também são
+//   pedidas ao disco, enquanto tiver quadro livre. A janela de cada processo
+//   começa em PREBUSCA_JANELA_INICIAL, cresce (até PREBUSCA_JANELA_MAX) quando
+//   uma página pré-buscada é usada e cai à metade quando sai sem ser usada.
+//   Com PREBUSCA_JANELA_MAX 0 não tem pré-busca.
+#define PREBUSCA_JANELA_INICIAL 4
+#define PREBUSCA_JANELA_MAX 8
+// Conjunto de trabalho: as páginas usadas por um processo nas últimas
+//   JANELA_CONJUNTO_TRABALHO interrupções do relógio em que ele estava executando.
+//   Um processo que já tem mais quadros que o seu conjunto de trabalho (mais
+//   FOLGA_COTA, e no mínimo COTA_MINIMA) substitui uma página sua numa falta, e
+//   quando a soma dos conjuntos de trabalho não cabe na memória o controle de
+//   carga suspende processos; um suspenso volta quando sobram FOLGA_CARGA quadros
+//   além do seu conjunto de trabalho. Com JANELA_CONJUNTO_TRABALHO 0 não tem nada disso.
+#define JANELA_CONJUNTO_TRABALHO 4
+#define FOLGA_COTA 2
+#define COTA_MINIMA 4
+#define FOLGA_CARGA 4
 
 #define FILA_PROCESSOS_INICIAL 5
 #define MAX_PROCESSOS 4
@@ -37,8 +60,6 @@
 #define FATOR_MULTIPLICADOR_LIMITE_PROCESSOS 2
 #define FATOR_CRESCIMENTO_FILA 2
 
-#define TAMANHO_MEMORIA_SECUNDARIA = 10000
-#define TEMPO_MUDANCA_PAGINA_CPU 2
 #define ERR_PAGINA_INVALIDA -1
 
 // Não tem processos nem memória virtual, mas é preciso usar a paginação,
@@ -68,36 +89,94 @@ typedef struct
     int interrupcoes[N_IRQ]; // Reset, Sistema, CPU Error, Timer
     int tempo_total_execucao;
     int tempo_sistema_ocioso;
+    int falhas_pagina;
+    int paginas_prebuscadas;
+    int prebuscadas_usadas;
+    int prebuscadas_nao_usadas;
+    int mapeamentos_compartilhados; // faltas atendidas com um quadro de outro processo
+    int copias_na_escrita;
+    int substituicoes_locais; // faltas em que o processo estava na cota e perdeu uma página sua
+    int paginas_lidas;        // do disco para a memória principal, inclusive por pré-busca
+    int paginas_retiradas;    // tiradas da memória principal, privadas ou compartilhadas
+    int paginas_salvas;       // dessas, as alteradas, escritas na memória secundária
+    int pico_quadros;         // quadros com páginas de processos, carregadas ou chegando
+    int processos_pegos;      // por um núcleo sem processo pronto, da fila de outro
 } metricas_so_t;
 
-struct so_t
+// Decisão do controle de carga, registrada no relatório
+typedef struct
+{
+    int tempo;
+    int pid;
+    bool suspensao; // senão, retomada
+    int demanda;    // soma dos conjuntos de trabalho dos processos ativos, em páginas
+} evento_carga_t;
+
+// Um núcleo: a CPU, com a sua MMU e a área onde ela salva o estado na interrupção,
+//   e o que o SO escalona nela
+typedef struct
 {
+    so_t *so; // o argumento de so_trata_interrupcao, que identifica o núcleo
+    int id;
     cpu_t *cpu;
-    mem_t *mem;
     mmu_t *mmu;
+    int end_irq; // IRQ_END_AREA do núcleo
+    processo_t *processo_corrente;
+    fila_processos_t *fila_prontos; // inclui o processo corrente, se estiver pronto
+    int quantum;
+    int tempo_ocioso;
+} nucleo_t;
+
+struct so_t
+{
+    mem_t *mem;
     es_t *es;
     console_t *console;
     bool erro_interno;
+    bool encerrado; // todos os processos morreram, o SO não tem mais o que fazer
+
+    // o núcleo 0 é o da CPU dada na criação; 'nucleo' é aquele em que o SO está
+    //   executando (o que foi interrompido), e é dele o processo corrente
+    nucleo_t nucleos[IRQ_MAX_NUCLEOS];
+    int n_nucleos;
+    nucleo_t *nucleo;
 
+    // indexada pelo PID (o processo com PID p está na posição p - 1)
     processo_t **tabela_processos;
-    processo_t *processo_corrente;
-    fila_processos_t *fila_prontos;
+    // cada processo bloqueado fica na fila daquilo que ele espera
+    fila_processos_t *fila_espera_leitura[NUM_TERMINAIS];
+    fila_processos_t *fila_espera_escrita[NUM_TERMINAIS];
+    fila_processos_t *fila_espera_processo;
+    fila_processos_t *fila_espera_pagina; // desbloqueados pela interrupção do disco
+    fila_processos_t *fila_espera_memoria; // suspensos pelo controle de carga, em ordem de suspensão
+    int n_processos_bloqueados;
 
     int limite_processos;
     int n_processos;
+    int n_processos_vivos;
     int proximo_pid;
-    int quantum;
     int t_relogio_atual;
 
     mem_t *memoria_secundaria;
-    int prox_endereco_mem_sec; // Próximo endereço disponível na memória secundária
+    gere_mem_sec_t *gere_mem_sec; // Espaço livre na memória secundária
+    imagens_t *imagens;           // Imagens dos executáveis, compartilhadas pelos processos
 
     gere_blocos_t *gere_blocos;
     int n_paginas_fisica;
     int quadro_livre_inicial;
     int quadro_livre;
+    algoritmo_substituicao_t algoritmo_substituicao;
+    int n_prebuscadas_pendentes; // blocos pré-buscados que ainda não se sabe se foram usados
 
     metricas_so_t *metricas;
+    // métricas de paginação escritas a cada 'intervalo_metricas' instruções
+    //   (0 se não), em "../metricas_periodicas.txt"
+    int intervalo_metricas;
+    int proximas_metricas;
+    FILE *arq_metricas_periodicas;
+    evento_carga_t *eventos_carga;
+    int n_eventos_carga;
+    int cap_eventos_carga;
 };
 
 typedef enum escalonador_t
@@ -107,12 +186,6 @@ typedef enum escalonador_t
     PRIORIDADE,
 } escalonador_t;
 
-typedef enum algoritmo_substituicao_t
-{
-    FIFO,
-    SEGUNDA_CHANCE,
-} algoritmo_substituicao_t;
-
 // função de tratamento de interrupção (entrada no SO)
 static int so_trata_interrupcao(void *argC, int reg_A);
 
@@ -126,6 +199,15 @@ static bool so_copia_str_do_processo(so_t *self, int tam, char str[tam], int end
 // CRIAÇÃO {{{1
 
 static metricas_so_t *cria_metricas_so();
+static char *nome_algoritmo_substituicao(so_t *self);
+static void atualiza_algoritmo_substituicao(so_t *self);
+static void so_confere_prebuscadas(so_t *self, int pid_morto);
+static void so_larga_imagem(so_t *self, processo_t *processo);
+static bool so_ativo(processo_t *processo);
+static void so_conta_conjunto_trabalho(so_t *self, processo_t *processo, int variacao);
+static int so_quadros_usuario(so_t *self);
+static int so_quadros_em_uso(so_t *self);
+static void so_retoma_suspensos(so_t *self);
 static void gera_relatorio_final(so_t *self);
 static void finaliza_metricas(so_t *self);
 
@@ -142,10 +224,32 @@ static processo_t **tabela_cria(so_t *self)
     return tabela;
 }
 
+static fila_processos_t *cria_fila_prontos(void)
+{
+    if (ESCALONADOR_ATUAL == PRIORIDADE) {
+        return fila_processos_cria_prioridade();
+    }
+    return fila_processos_cria();
+}
+
+static void inicializa_nucleo(so_t *self, int id, cpu_t *cpu, mmu_t *mmu)
+{
+    nucleo_t *nucleo = &self->nucleos[id];
+    nucleo->so = self;
+    nucleo->id = id;
+    nucleo->cpu = cpu;
+    nucleo->mmu = mmu;
+    nucleo->end_irq = IRQ_END_AREA(id);
+    nucleo->processo_corrente = NULL;
+    nucleo->fila_prontos = cria_fila_prontos();
+    nucleo->quantum = QUANTUM_INICIAL;
+    nucleo->tempo_ocioso = 0;
+    //   so_trata_interrupcao, com primeiro argumento um ptr para o núcleo
+    cpu_define_chamaC(cpu, so_trata_interrupcao, nucleo);
+}
+
 static void configura_cpu(so_t *self)
 {
-    //   so_trata_interrupcao, com primeiro argumento um ptr para o SO
-    cpu_define_chamaC(self->cpu, so_trata_interrupcao, self);
 
     // coloca o tratador de interrupção na memória
     int ender = so_carrega_programa(self, NENHUM_PROCESSO, "trata_int.maq");
@@ -161,73 +265,323 @@ static void configura_cpu(so_t *self)
     }
 }
 
-so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu, es_t *es, console_t *console)
+so_t *so_cria(cpu_t *cpu, mem_t *mem, mem_t *mem_sec, mmu_t *mmu, es_t *es, console_t *console)
 {
     so_t *self = malloc(sizeof(*self));
     assert(self != NULL);
 
-    self->cpu = cpu;
     self->mem = mem;
-    self->memoria_secundaria = mem_cria(10000);
-    self->mmu = mmu;
+    self->memoria_secundaria = mem_sec;
     self->es = es;
     self->console = console;
     self->erro_interno = false;
+    self->encerrado = false;
 
     self->proximo_pid = 1;
     self->n_processos = 0;
+    self->n_processos_vivos = 0;
+    self->n_processos_bloqueados = 0;
     self->t_relogio_atual = -1;
 
-    self->processo_corrente = NULL;
-    self->quantum = QUANTUM_INICIAL;
+    inicializa_nucleo(self, 0, cpu, mmu);
+    self->n_nucleos = 1;
+    self->nucleo = &self->nucleos[0];
     self->limite_processos = MAX_PROCESSOS;
 
-    self->prox_endereco_mem_sec = 0;
-    self->n_paginas_fisica = mem_tam(self->mem) / TAM_PAGINA;
-    self->quadro_livre_inicial = 99 / TAM_PAGINA + 1;
+    self->gere_mem_sec = gere_mem_sec_cria(PAGINA_DO_END(mem_tam(self->memoria_secundaria)));
+    self->imagens = imagens_cria();
+    self->n_paginas_fisica = PAGINA_DO_END(mem_tam(self->mem));
+    self->quadro_livre_inicial = PAGINA_DO_END(99) + 1;
     self->quadro_livre = 0;
+    self->algoritmo_substituicao = ALGORITMO_SUBSTITUICAO_ATUAL;
+    self->n_prebuscadas_pendentes = 0;
 
     self->tabela_processos = tabela_cria(self);
-    self->fila_prontos = fila_processos_cria();
+    for (int t = 0; t < NUM_TERMINAIS; t++) {
+        self->fila_espera_leitura[t] = fila_processos_cria();
+        self->fila_espera_escrita[t] = fila_processos_cria();
+    }
+    self->fila_espera_processo = fila_processos_cria();
+    self->fila_espera_pagina = fila_processos_cria();
+    self->fila_espera_memoria = fila_processos_cria();
     self->metricas = cria_metricas_so();
+    self->intervalo_metricas = 0;
+    self->proximas_metricas = 0;
+    self->arq_metricas_periodicas = NULL;
+    self->eventos_carga = NULL;
+    self->n_eventos_carga = 0;
+    self->cap_eventos_carga = 0;
     self->gere_blocos = gere_blocos_cria(self->n_paginas_fisica);
     configura_cpu(self);
 
     return self;
 }
 
+bool so_adiciona_nucleo(so_t *self, cpu_t *cpu, mmu_t *mmu)
+{
+    if (self->n_nucleos == IRQ_MAX_NUCLEOS) {
+        console_printf("SO: não cabem mais núcleos");
+        return false;
+    }
+    inicializa_nucleo(self, self->n_nucleos, cpu, mmu);
+    self->n_nucleos++;
+    return true;
+}
+
 static void so_encerra_atividade(so_t *self)
 {
     console_printf("SO: encerrando atividades");
     finaliza_metricas(self);
     gera_relatorio_final(self);
-    so_destroi(self);
+
+    // desliga o timer: sem processos, não tem por que ser interrompido de novo
+    //   e a CPU pode ficar parada para sempre (o controlador em modo lote usa
+    //   isso para saber que a simulação terminou)
+    if (es_escreve(self->es, D_RELOGIO_TIMER, 0) != ERR_OK ||
+        es_escreve(self->es, D_RELOGIO_INTERRUPCAO, 0) != ERR_OK) {
+        console_printf("SO: problema ao desligar o timer");
+        self->erro_interno = true;
+    }
+    self->encerrado = true;
 }
 
 static void destroi_tabela_processos(so_t *self)
 {
-    for (int i = 0; i < self->limite_processos; i++) {
-        if (self->tabela_processos[i] != NULL) {
-            free(self->tabela_processos[i]);
-        }
+    for (int i = 0; i < self->n_processos; i++) {
+        processo_destroi(self->tabela_processos[i]);
     }
     free(self->tabela_processos);
 }
 
 void so_destroi(so_t *self)
 {
-    // if (self->fila_prontos != NULL) fila_destroi(self->fila_prontos);
+    // as filas desencadeiam os processos, são destruídas antes deles
+    for (int i = 0; i < self->n_nucleos; i++) {
+        fila_processos_destroi(self->nucleos[i].fila_prontos);
+    }
+    for (int t = 0; t < NUM_TERMINAIS; t++) {
+        fila_processos_destroi(self->fila_espera_leitura[t]);
+        fila_processos_destroi(self->fila_espera_escrita[t]);
+    }
+    fila_processos_destroi(self->fila_espera_processo);
+    fila_processos_destroi(self->fila_espera_pagina);
+    fila_processos_destroi(self->fila_espera_memoria);
+
     if (self->tabela_processos != NULL)
         destroi_tabela_processos(self);
-
-    if (self->fila_prontos != NULL) {
-        fila_processos_destroi(self->fila_prontos);
+    gere_blocos_destroi(self->gere_blocos);
+    gere_mem_sec_destroi(self->gere_mem_sec);
+    imagens_destroi(self->imagens);
+    free(self->eventos_carga);
+    if (self->arq_metricas_periodicas != NULL) {
+        fclose(self->arq_metricas_periodicas);
     }
 
-    cpu_define_chamaC(self->cpu, NULL, NULL);
+    for (int i = 0; i < self->n_nucleos; i++) {
+        cpu_define_chamaC(self->nucleos[i].cpu, NULL, NULL);
+    }
     free(self);
 }
 
+// INSTANTÂNEO {{{1
+
+// O instantâneo é de um SO com um núcleo só, o 0
+// as filas na ordem em que são gravadas: prontos, leitura e escrita de cada
+//   terminal, espera por processo, por página e por memória
+#define N_FILAS (1 + 2 * NUM_TERMINAIS + 3)
+static int so_filas(so_t *self, fila_processos_t *filas[N_FILAS])
+{
+    int n = 0;
+    filas[n++] = self->nucleos[0].fila_prontos;
+    for (int t = 0; t < NUM_TERMINAIS; t++) {
+        filas[n++] = self->fila_espera_leitura[t];
+        filas[n++] = self->fila_espera_escrita[t];
+    }
+    filas[n++] = self->fila_espera_processo;
+    filas[n++] = self->fila_espera_pagina;
+    filas[n++] = self->fila_espera_memoria;
+    return n;
+}
+
+// os eventos do controle de carga são gravados campo a campo (evento_carga_t
+//   tem preenchimento)
+static bool so_salva_eventos_carga(so_t *self, FILE *arq)
+{
+    for (int i = 0; i < self->n_eventos_carga; i++) {
+        evento_carga_t *evento = &self->eventos_carga[i];
+        if (!inst_escreve_int(arq, evento->tempo) || !inst_escreve_int(arq, evento->pid) ||
+            !inst_escreve_int(arq, evento->suspensao) || !inst_escreve_int(arq, evento->demanda)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool so_restaura_eventos_carga(so_t *self, FILE *arq)
+{
+    for (int i = 0; i < self->n_eventos_carga; i++) {
+        evento_carga_t *evento = &self->eventos_carga[i];
+        int suspensao;
+        if (!inst_le_int(arq, &evento->tempo) || !inst_le_int(arq, &evento->pid) || !inst_le_int(arq, &suspensao) ||
+            !inst_le_int(arq, &evento->demanda)) {
+            return false;
+        }
+        evento->suspensao = suspensao;
+    }
+    return true;
+}
+
+bool so_salva(so_t *self, FILE *arq)
+{
+    bool ok = inst_escreve_marca(arq, "SO  ") && inst_escreve_int(arq, self->erro_interno) &&
+              inst_escreve_int(arq, self->encerrado) && inst_escreve_int(arq, self->n_processos_bloqueados) &&
+              inst_escreve_int(arq, self->limite_processos) && inst_escreve_int(arq, self->n_processos) &&
+              inst_escreve_int(arq, self->n_processos_vivos) && inst_escreve_int(arq, self->proximo_pid) &&
+              inst_escreve_int(arq, self->nucleos[0].quantum) && inst_escreve_int(arq, self->t_relogio_atual) &&
+              inst_escreve_int(arq, self->n_paginas_fisica) && inst_escreve_int(arq, self->quadro_livre_inicial) &&
+              inst_escreve_int(arq, self->quadro_livre) && inst_escreve_int(arq, self->algoritmo_substituicao) &&
+              inst_escreve_int(arq, self->n_prebuscadas_pendentes) &&
+              inst_escreve(arq, self->metricas, sizeof(*self->metricas)) &&
+              inst_escreve_int(arq, self->n_eventos_carga) && so_salva_eventos_carga(self, arq);
+
+    for (int i = 0; ok && i < self->n_processos; i++) {
+        processo_t *processo = self->tabela_processos[i];
+        ok = inst_escreve_int(arq, processo != NULL) && (processo == NULL || processo_salva(processo, arq));
+    }
+    processo_t *processo_corrente = self->nucleos[0].processo_corrente;
+    int pid_corrente = processo_corrente != NULL ? processo_get_pid(processo_corrente) : 0;
+    ok = ok && inst_escreve_int(arq, pid_corrente);
+
+    fila_processos_t *filas[N_FILAS];
+    int n_filas = so_filas(self, filas);
+    for (int i = 0; ok && i < n_filas; i++) {
+        ok = fila_processos_salva(filas[i], arq);
+    }
+
+    return ok && gere_blocos_salva(self->gere_blocos, arq) && gere_mem_sec_salva(self->gere_mem_sec, arq) &&
+           imagens_salva(self->imagens, arq);
+}
+
+bool so_restaura(so_t *self, FILE *arq)
+{
+    int erro_interno, encerrado, limite_processos, n_processos, algoritmo, n_paginas_fisica, n_eventos;
+    if (!inst_confere_marca(arq, "SO  ") || !inst_le_int(arq, &erro_interno) || !inst_le_int(arq, &encerrado) ||
+        !inst_le_int(arq, &self->n_processos_bloqueados) || !inst_le_int(arq, &limite_processos) ||
+        !inst_le_int(arq, &n_processos) || !inst_le_int(arq, &self->n_processos_vivos) ||
+        !inst_le_int(arq, &self->proximo_pid) || !inst_le_int(arq, &self->nucleos[0].quantum) ||
+        !inst_le_int(arq, &self->t_relogio_atual) || !inst_le_int(arq, &n_paginas_fisica) ||
+        !inst_le_int(arq, &self->quadro_livre_inicial) || !inst_le_int(arq, &self->quadro_livre) ||
+        !inst_le_int(arq, &algoritmo) || !inst_le_int(arq, &self->n_prebuscadas_pendentes) ||
+        !inst_le(arq, self->metricas, sizeof(*self->metricas)) || !inst_le_int(arq, &n_eventos)) {
+        return false;
+    }
+    if (n_paginas_fisica != self->n_paginas_fisica || algoritmo < 0 || algoritmo >= N_ALGORITMO_SUBSTITUICAO ||
+        n_processos < 0 || n_processos > limite_processos || n_eventos < 0 || self->n_processos != 0) {
+        console_printf("SO: instantâneo incompatível com este SO");
+        return false;
+    }
+    self->erro_interno = erro_interno;
+    self->encerrado = encerrado;
+    self->algoritmo_substituicao = algoritmo;
+
+    if (n_eventos > 0) {
+        evento_carga_t *eventos = realloc(self->eventos_carga, n_eventos * sizeof(evento_carga_t));
+        if (eventos == NULL) {
+            console_printf("Erro ao alocar memória para os eventos do controle de carga\n");
+            return false;
+        }
+        self->eventos_carga = eventos;
+        self->cap_eventos_carga = n_eventos;
+    }
+    self->n_eventos_carga = n_eventos;
+    if (!so_restaura_eventos_carga(self, arq)) {
+        return false;
+    }
+
+    // a tabela tem o tamanho que tinha quando foi gravada
+    free(self->tabela_processos);
+    self->limite_processos = limite_processos;
+    self->tabela_processos = tabela_cria(self);
+    for (int i = 0; i < n_processos; i++) {
+        int existe;
+        if (!inst_le_int(arq, &existe)) {
+            return false;
+        }
+        if (existe) {
+            processo_t *processo = processo_restaura(arq);
+            if (processo == NULL) {
+                return false;
+            }
+            self->tabela_processos[i] = processo;
+        }
+        // conta já o restaurado, para que seja destruído com o SO se der erro depois
+        self->n_processos = i + 1;
+    }
+
+    int pid_corrente;
+    if (!inst_le_int(arq, &pid_corrente) || pid_corrente < 0 || pid_corrente > n_processos) {
+        return false;
+    }
+    self->nucleos[0].processo_corrente = pid_corrente > 0 ? self->tabela_processos[pid_corrente - 1] : NULL;
+
+    fila_processos_t *filas[N_FILAS];
+    int n_filas = so_filas(self, filas);
+    for (int i = 0; i < n_filas; i++) {
+        if (!fila_processos_restaura(filas[i], arq, self->tabela_processos, n_processos)) {
+            return false;
+        }
+    }
+
+    if (!gere_blocos_restaura(self->gere_blocos, arq) || !gere_mem_sec_restaura(self->gere_mem_sec, arq) ||
+        !imagens_restaura(self->imagens, arq)) {
+        return false;
+    }
+
+    // os blocos reservados para páginas privadas voltam para o índice do dono
+    for (int quadro = 0; quadro < self->gere_blocos->total_blocos; quadro++) {
+        bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+        if (gere_blocos_reservado(self->gere_blocos, quadro) && bloco->imagem == -1) {
+            processo_t *dono = processo_busca_por_pid(self->tabela_processos, self->n_processos, bloco->processo_pid);
+            if (dono == NULL || processo_get_quadros_reservados(dono) == NULL) {
+                return false;
+            }
+            gere_blocos_registra_reserva(self->gere_blocos, quadro, processo_get_quadros_reservados(dono));
+        }
+    }
+
+    // os mapeadores das páginas compartilhadas não são gravados: são os processos
+    //   vivos que têm a página mapeada no quadro que está na imagem; as contagens
+    //   dos conjuntos de trabalho também são refeitas
+    for (int i = 0; i < n_processos; i++) {
+        processo_t *processo = self->tabela_processos[i];
+        if (processo == NULL || processo_get_estado(processo) == MORTO || processo_get_imagem(processo) < 0) {
+            continue;
+        }
+        int indice = processo_get_imagem(processo);
+        imagem_t *imagem = &self->imagens->imagens[indice];
+        for (int pagina = 0; pagina < imagem->n_paginas; pagina++) {
+            int quadro;
+            if (imagem->quadros[pagina] != -1 && !processo_pagina_privada(processo, pagina) &&
+                tabpag_traduz(processo_get_tabpag(processo), pagina, &quadro) == ERR_OK &&
+                quadro == imagem->quadros[pagina] &&
+                !imagens_adiciona_mapeador(self->imagens, indice, pagina, processo_get_pid(processo))) {
+                return false;
+            }
+        }
+        if (so_ativo(processo)) {
+            so_conta_conjunto_trabalho(self, processo, 1);
+        }
+    }
+
+    // a MMU (restaurada antes) volta a usar a tabela de páginas do processo
+    //   cujo espaço de endereçamento estava em uso
+    int asid = mmu_asid(self->nucleos[0].mmu);
+    if (asid >= 1 && asid <= n_processos && self->tabela_processos[asid - 1] != NULL) {
+        mmu_define_tabpag_asid(self->nucleos[0].mmu, processo_get_tabpag(self->tabela_processos[asid - 1]), asid);
+    }
+    return true;
+}
+
 // METRICAS {{{1
 
 static metricas_so_t *cria_metricas_so()
@@ -242,6 +596,18 @@ static metricas_so_t *cria_metricas_so()
     metricas->preempcoes = 0;
     metricas->tempo_total_execucao = 0;
     metricas->tempo_sistema_ocioso = 0;
+    metricas->falhas_pagina = 0;
+    metricas->paginas_prebuscadas = 0;
+    metricas->prebuscadas_usadas = 0;
+    metricas->prebuscadas_nao_usadas = 0;
+    metricas->mapeamentos_compartilhados = 0;
+    metricas->copias_na_escrita = 0;
+    metricas->substituicoes_locais = 0;
+    metricas->paginas_lidas = 0;
+    metricas->paginas_retiradas = 0;
+    metricas->paginas_salvas = 0;
+    metricas->pico_quadros = 0;
+    metricas->processos_pegos = 0;
 
     for (int i = 0; i < N_IRQ; i++) {
         metricas->interrupcoes[i] = 0;
@@ -249,11 +615,20 @@ static metricas_so_t *cria_metricas_so()
     return metricas;
 }
 
+// O tempo total já foi lido do relógio; distribui o tempo percorrido desde a
+//   última interrupção (em qualquer núcleo)
+// o sistema está ocioso quando nenhum núcleo tem processo
 static void so_atualiza_metricas(so_t *self, int tempo_percorrido)
 {
-    self->metricas->tempo_total_execucao += tempo_percorrido;
-
-    if (self->processo_corrente == NULL) {
+    bool ocioso = true;
+    for (int i = 0; i < self->n_nucleos; i++) {
+        if (self->nucleos[i].processo_corrente == NULL) {
+            self->nucleos[i].tempo_ocioso += tempo_percorrido;
+        } else {
+            ocioso = false;
+        }
+    }
+    if (ocioso) {
         self->metricas->tempo_sistema_ocioso += tempo_percorrido;
     }
 
@@ -327,6 +702,60 @@ static void gera_relatorio_final(so_t *self)
         fprintf(arq, "Interrupções de %s: %d\n", irq_nome(i), self->metricas->interrupcoes[i]);
     }
 
+    fprintf(arq, "Algoritmo de substituição de páginas: %s\n", nome_algoritmo_substituicao(self));
+    fprintf(arq, "Falhas de página: %d\n", self->metricas->falhas_pagina);
+    fprintf(arq, "Páginas lidas do disco: %d\n", self->metricas->paginas_lidas);
+    fprintf(arq, "Páginas retiradas da memória: %d (%d salvas na memória secundária)\n",
+            self->metricas->paginas_retiradas, self->metricas->paginas_salvas);
+    fprintf(arq, "Quadros em uso: %d de %d no final, pico %d\n", so_quadros_em_uso(self), so_quadros_usuario(self),
+            self->metricas->pico_quadros);
+    fprintf(arq, "Pré-busca: %d páginas, %d usadas, %d não usadas\n", self->metricas->paginas_prebuscadas,
+            self->metricas->prebuscadas_usadas, self->metricas->prebuscadas_nao_usadas);
+    fprintf(arq, "Páginas compartilhadas: %d faltas atendidas sem o disco, %d cópias na escrita\n",
+            self->metricas->mapeamentos_compartilhados, self->metricas->copias_na_escrita);
+    fprintf(arq, "Conjunto de trabalho: janela %d, %d substituições locais\n", JANELA_CONJUNTO_TRABALHO,
+            self->metricas->substituicoes_locais);
+    fprintf(arq, "Controle de carga: %d decisões (memória para %d páginas)\n", self->n_eventos_carga,
+            so_quadros_usuario(self));
+    for (int i = 0; i < self->n_eventos_carga; i++) {
+        evento_carga_t *evento = &self->eventos_carga[i];
+        fprintf(arq, "  %d: processo %d %s, conjuntos de trabalho somam %d páginas\n", evento->tempo, evento->pid,
+                evento->suspensao ? "suspenso" : "retomado", evento->demanda);
+    }
+    fprintf(arq, "Memória secundária: %d páginas, pico de uso %d páginas\n", self->gere_mem_sec->total_paginas,
+            self->gere_mem_sec->pico_paginas_em_uso);
+    fprintf(arq, "Fragmentação da memória secundária: %.2f no final, %.2f no pico\n",
+            gere_mem_sec_fragmentacao(self->gere_mem_sec), self->gere_mem_sec->pico_fragmentacao);
+    int atendidas, trilhas;
+    if (es_le(self->es, D_DISCO_ATENDIDAS, &atendidas) == ERR_OK &&
+        es_le(self->es, D_DISCO_TRILHAS, &trilhas) == ERR_OK) {
+        fprintf(arq, "Disco: %d requisições atendidas, %d trilhas percorridas\n", atendidas, trilhas);
+    }
+    // as TLBs e as fusões de todos os núcleos
+    long acertos_tlb = 0, falhas_tlb = 0;
+    for (int n = 0; n < self->n_nucleos; n++) {
+        acertos_tlb += mmu_tlb_acertos(self->nucleos[n].mmu);
+        falhas_tlb += mmu_tlb_falhas(self->nucleos[n].mmu);
+    }
+    fprintf(arq, "Acertos na TLB: %ld\n", acertos_tlb);
+    fprintf(arq, "Falhas na TLB: %ld\n", falhas_tlb);
+    for (int i = 0; i < cpu_n_fusoes(); i++) {
+        long execucoes = 0;
+        for (int n = 0; n < self->n_nucleos; n++) {
+            execucoes += cpu_fusao_execucoes(self->nucleos[n].cpu, i);
+        }
+        if (execucoes > 0) {
+            fprintf(arq, "Instruções fundidas %s: %ld execuções\n", cpu_fusao_nome(i), execucoes);
+        }
+    }
+    if (self->n_nucleos > 1) {
+        fprintf(arq, "Núcleos: %d, %d processos pegos da fila de outro núcleo\n", self->n_nucleos,
+                self->metricas->processos_pegos);
+        for (int n = 0; n < self->n_nucleos; n++) {
+            fprintf(arq, "  núcleo %d: tempo ocioso %d\n", n, self->nucleos[n].tempo_ocioso);
+        }
+    }
+
     for (int i = 0; i < self->n_processos; i++) {
         processo_t *proc = self->tabela_processos[i];
         if (proc != NULL) {
@@ -337,16 +766,157 @@ static void gera_relatorio_final(so_t *self)
     fclose(arq);
 }
 
+void so_define_intervalo_metricas(so_t *self, int intervalo)
+{
+    self->intervalo_metricas = intervalo;
+    self->proximas_metricas = intervalo;
+}
+
+// Escreve as métricas de paginação globais e de cada processo, se já passou o
+//   intervalo desde a última vez; uma linha por processo, começando pelo tempo
+static void so_escreve_metricas_periodicas(so_t *self)
+{
+    if (self->intervalo_metricas <= 0 || self->t_relogio_atual < self->proximas_metricas) {
+        return;
+    }
+    while (self->proximas_metricas <= self->t_relogio_atual) {
+        self->proximas_metricas += self->intervalo_metricas;
+    }
+    if (self->arq_metricas_periodicas == NULL) {
+        self->arq_metricas_periodicas = fopen("../metricas_periodicas.txt", "w");
+        if (self->arq_metricas_periodicas == NULL) {
+            console_printf("SO: problema na abertura do arquivo de métricas periódicas");
+            self->intervalo_metricas = 0;
+            return;
+        }
+    }
+    FILE *arq = self->arq_metricas_periodicas;
+    fprintf(arq, "%d: total: %d falhas, %d lidas, %d retiradas (%d salvas), %d quadros\n", self->t_relogio_atual,
+            self->metricas->falhas_pagina, self->metricas->paginas_lidas, self->metricas->paginas_retiradas,
+            self->metricas->paginas_salvas, so_quadros_em_uso(self));
+    for (int i = 0; i < self->n_processos; i++) {
+        processo_t *processo = self->tabela_processos[i];
+        if (processo_get_estado(processo) == MORTO) {
+            continue;
+        }
+        fprintf(arq, "%d: processo %d: ", self->t_relogio_atual, processo_get_pid(processo));
+        processo_imprime_paginacao(processo, arq);
+        fprintf(arq, "\n");
+    }
+}
+
+// NÚCLEOS {{{1
+
+// Os núcleos executam em sequência (ver controle.h), e o SO executa em um de cada
+//   vez: as estruturas do SO são compartilhadas sem exclusão mútua. Quando o SO
+//   muda algo que outro núcleo está usando, avisa o núcleo com IRQ_NUCLEO.
+
+// true se o processo está executando em algum núcleo
+static bool so_executando(so_t *self, processo_t *processo)
+{
+    for (int i = 0; i < self->n_nucleos; i++) {
+        if (self->nucleos[i].processo_corrente == processo) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// true se o processo está executando em outro núcleo que não o do SO
+static bool so_em_outro_nucleo(so_t *self, processo_t *processo)
+{
+    for (int i = 0; i < self->n_nucleos; i++) {
+        if (&self->nucleos[i] != self->nucleo && self->nucleos[i].processo_corrente == processo) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// O processo morreu (pode ter sido morto por um processo de outro núcleo): o
+//   núcleo que o executava deixa de executá-lo e é interrompido para escolher
+//   outro; se o núcleo não aceita a interrupção, já está entrando no SO
+static void so_retira_de_outro_nucleo(so_t *self, processo_t *processo)
+{
+    for (int i = 0; i < self->n_nucleos; i++) {
+        nucleo_t *nucleo = &self->nucleos[i];
+        if (nucleo != self->nucleo && nucleo->processo_corrente == processo) {
+            nucleo->processo_corrente = NULL;
+            cpu_interrompe(nucleo->cpu, IRQ_NUCLEO);
+        }
+    }
+}
+
+// Um processo ficou pronto: acorda um núcleo parado, se tiver, para pegá-lo sem
+//   esperar pela próxima interrupção do relógio
+static void so_acorda_nucleo_ocioso(so_t *self)
+{
+    for (int i = 0; i < self->n_nucleos; i++) {
+        nucleo_t *nucleo = &self->nucleos[i];
+        if (nucleo != self->nucleo && nucleo->processo_corrente == NULL && cpu_interrompe(nucleo->cpu, IRQ_NUCLEO)) {
+            return;
+        }
+    }
+}
+
+// A entrada da página na TLB tem que sair da MMU de todos os núcleos, o processo
+//   pode ter executado em qualquer um
+static void so_invalida_tlb(so_t *self, int pid, int pagina)
+{
+    for (int i = 0; i < self->n_nucleos; i++) {
+        mmu_invalida_pagina(self->nucleos[i].mmu, pid, pagina);
+    }
+}
+
+// As entradas do processo que morreu saem da TLB de todos os núcleos; o pid não
+//   é reutilizado, mas assim elas não ficam esquecidas ocupando a TLB
+static void so_invalida_tlb_processo(so_t *self, int pid)
+{
+    for (int i = 0; i < self->n_nucleos; i++) {
+        mmu_invalida_asid(self->nucleos[i].mmu, pid);
+    }
+}
+
 // PROCESSOS {{{1
 
+// Índice do terminal do processo, os dispositivos de cada terminal estão em sequência
+static int so_indice_terminal(processo_t *processo)
+{
+    return processo_get_terminal(processo) / (D_TERM_B_TECLADO - D_TERM_A_TECLADO);
+}
+
+// Fila em que fica um processo bloqueado pelo motivo dado
+static fila_processos_t *so_fila_de_espera(so_t *self, processo_t *processo, motivo_bloqueio_t motivo)
+{
+    switch (motivo) {
+    case ESPERANDO_LEITURA:
+        return self->fila_espera_leitura[so_indice_terminal(processo)];
+    case ESPERANDO_ESCRITA:
+        return self->fila_espera_escrita[so_indice_terminal(processo)];
+    case ESPERANDO_PROCESSO:
+        return self->fila_espera_processo;
+    case ESPERANDO_PAGINA:
+        return self->fila_espera_pagina;
+    case ESPERANDO_MEMORIA:
+        return self->fila_espera_memoria;
+    default:
+        return NULL;
+    }
+}
+
 static void so_processa_desbloqueio_proc(so_t *self, processo_t *processo, bool insere_fim_fila)
 {
     console_printf("SO: processo %d desbloqueado\n", processo_get_pid(processo));
+    fila_processos_t *fila_espera = so_fila_de_espera(self, processo, processo_get_motivo_bloqueio(processo));
+    if (fila_espera != NULL && fila_processos_deleta_processo(fila_espera, processo)) {
+        self->n_processos_bloqueados--;
+    }
     processo_desbloqueia(processo);
     debug_tabela_processos(self->tabela_processos, self->limite_processos);
 
     if (insere_fim_fila) {
-        fila_processos_insere(self->fila_prontos, processo);
+        fila_processos_insere(self->nucleo->fila_prontos, processo);
+        so_acorda_nucleo_ocioso(self);
     }
 }
 
@@ -358,26 +928,78 @@ static void so_processa_bloqueio_proc(so_t *self, processo_t *processo, motivo_b
     console_printf("SO: processo %d bloqueado por motivo %s\n", processo_get_pid(processo),
                    processo_motivo_para_string(motivo));
 
+    fila_processos_t *fila_espera = so_fila_de_espera(self, processo, motivo);
+    if (fila_espera == NULL) {
+        console_printf("SO: motivo de bloqueio desconhecido");
+        self->erro_interno = true;
+        return;
+    }
+
     processo_bloqueia(processo, motivo);
     debug_tabela_processos(self->tabela_processos, self->limite_processos);
 
-    fila_processos_remove(self->fila_prontos);
-    processo_atualiza_prioridade(processo, self->quantum);
+    // sai da fila de prontos do núcleo em que estiver
+    fila_processos_t *fila_prontos = processo_get_fila(processo);
+    if (fila_prontos != NULL) {
+        fila_processos_deleta_processo(fila_prontos, processo);
+    }
+    fila_processos_insere(fila_espera, processo);
+    self->n_processos_bloqueados++;
+    processo_atualiza_prioridade(processo, self->nucleo->quantum);
+}
+
+// Desbloqueia os processos que esperam pela morte do processo 'pid'
+static void so_acorda_espera_processo(so_t *self, int pid)
+{
+    processo_t *proximo;
+    for (processo_t *processo = fila_processos_primeiro(self->fila_espera_processo); processo != NULL;
+         processo = proximo) {
+        proximo = processo_get_prox(processo);
+        if (processo_get_reg_X(processo) == pid) {
+            console_printf("SO: processo esperado %d morreu", pid);
+            so_processa_desbloqueio_proc(self, processo, true);
+        }
+    }
 }
 
 static void so_processa_morte_proc(so_t *self, processo_t *processo)
 {
-    if (processo == NULL)
+    if (processo == NULL || processo_get_estado(processo) == MORTO)
         return;
 
+    // Sai da fila em que estiver, de prontos ou de espera
+    fila_processos_t *fila = processo_get_fila(processo);
+    if (fila != NULL) {
+        fila_processos_deleta_processo(fila, processo);
+    }
+    if (processo_get_estado(processo) == BLOQUEADO) {
+        self->n_processos_bloqueados--;
+    }
+    // As pré-buscadas são conferidas antes, enquanto o processo ainda conta como
+    //   usuário das páginas compartilhadas
+    so_confere_prebuscadas(self, processo_get_pid(processo));
+    if (so_ativo(processo)) {
+        so_conta_conjunto_trabalho(self, processo, -1);
+    }
     processo_mata(processo);
-    fila_processos_deleta_processo(self->fila_prontos, processo);
+    self->n_processos_vivos--;
+    gere_blocos_libera_processo(self->gere_blocos, processo_get_pid(processo));
+    processo_define_quadros(processo, 0);
+    gere_mem_sec_libera(self->gere_mem_sec, PAGINA_DO_END(processo_get_end_mem_sec(processo)),
+                        processo_get_paginas_mem_sec(processo));
+    processo_set_paginas_mem_sec(processo, 0);
+    so_invalida_tlb_processo(self, processo_get_pid(processo));
+    so_larga_imagem(self, processo);
+    so_retira_de_outro_nucleo(self, processo);
+
+    so_acorda_espera_processo(self, processo_get_pid(processo));
+    so_retoma_suspensos(self);
 }
 
 static void so_verifica_e_redimensiona_tabela(so_t *self)
 {
     if (self->n_processos < self->limite_processos)
-        return; // Não precisa redimensionar
+        return; // Não precisa redimensionar, ainda tem posição para o próximo PID
 
     int novo_limite = self->limite_processos * FATOR_MULTIPLICADOR_LIMITE_PROCESSOS;
 
@@ -396,19 +1018,17 @@ static void so_verifica_e_redimensiona_tabela(so_t *self)
     self->limite_processos = novo_limite;
 }
 
-// Procura possição livre na tabela de processos para o novo processo criado
+// Coloca o novo processo na posição da tabela de processos correspondente ao seu PID
+// Os PIDs são dados em sequência e não são reutilizados, a tabela não tem buracos
 static void so_adiciona_processo_tabela(so_t *self, processo_t *processo)
 {
-    for (int i = 0; i < self->limite_processos; i++) {
-        if (self->tabela_processos[i] == NULL) {
-            console_printf("SO: adicionando processo %d na posição %d da tabela de processos\n",
-                           processo_get_pid(processo), i);
-            self->tabela_processos[i] = processo;
-            return;
-        }
-    }
-    console_printf("SO: Erro ao adicionar processo na tabela\n");
-    processo_set_reg_A(self->processo_corrente, -1);
+    int i = processo_get_pid(processo) - 1;
+    assert(i == self->n_processos && i < self->limite_processos);
+    console_printf("SO: adicionando processo %d na posição %d da tabela de processos\n", processo_get_pid(processo),
+                   i);
+    self->tabela_processos[i] = processo;
+    self->n_processos++;
+    self->n_processos_vivos++;
 }
 
 // Instancia e adiciona na tabela um novo processo
@@ -416,8 +1036,8 @@ static processo_t *so_adiciona_novo_processo(so_t *self, char *nome_do_executave
 {
     so_verifica_e_redimensiona_tabela(self);
 
-    // Cria o processo e incrementa o PID
-    int pid = self->proximo_pid++;
+    // Cria o processo; o PID só é consumido se a criação der certo
+    int pid = self->proximo_pid;
     processo_t *processo = processo_cria(pid, 0);
     if (processo == NULL) {
         console_printf("SO: Erro ao criar o processo para '%s'\n", nome_do_executavel);
@@ -434,15 +1054,16 @@ static processo_t *so_adiciona_novo_processo(so_t *self, char *nome_do_executave
     // Define o PC
     processo_set_pc(processo, pc);
 
+    processo_set_janela_prebusca(processo, PREBUSCA_JANELA_MAX > 0 ? PREBUSCA_JANELA_INICIAL : 0);
+
     // Adiciona novo processo na tabela
+    self->proximo_pid++;
     so_adiciona_processo_tabela(self, processo);
-    fila_processos_insere(self->fila_prontos, processo);
-
-    self->processo_corrente = processo;
-    self->n_processos++;
+    fila_processos_insere(self->nucleo->fila_prontos, processo);
+    so_acorda_nucleo_ocioso(self);
 
     /* debug_tabela_processos(self->tabela_processos, self->limite_processos); */
-    /* debug_fila_processos(self->fila_prontos); */
+    /* debug_fila_processos(self->nucleo->fila_prontos); */
     return processo;
 }
 
@@ -478,8 +1099,8 @@ static int so_despacha(so_t *self);
 //   a instrução CHAMAC
 // a instrução CHAMAC só deve ser executada pelo tratador de interrupção
 //
-// o primeiro argumento é um ponteiro para o SO, o segundo é a identificação
-//   da interrupção
+// o primeiro argumento é um ponteiro para o núcleo interrompido (que aponta
+//   para o SO), o segundo é a identificação da interrupção
 // o valor retornado por esta função é colocado no registrador A, e pode ser
 //   testado pelo código que está após o CHAMAC. No tratador de interrupção em
 //   assembly esse valor é usado para decidir se a CPU deve retornar da interrupção
@@ -488,7 +1109,9 @@ static int so_despacha(so_t *self);
 
 static int so_trata_interrupcao(void *argC, int reg_A)
 {
-    so_t *self = argC;
+    nucleo_t *nucleo = argC;
+    so_t *self = nucleo->so;
+    self->nucleo = nucleo;
     irq_t irq = reg_A;
 
     // Atualizo todas as métricas do simulador e dos processos atuais.
@@ -498,288 +1121,1060 @@ static int so_trata_interrupcao(void *argC, int reg_A)
     // salva o estado da cpu no descritor do processo que foi interrompido
     so_salva_estado_da_cpu(self);
     // faz o atendimento da interrupção
-    so_trata_irq(self, irq);
+    // a chamada de sistema ou o erro de um processo que foi morto por outro
+    //   núcleo antes de o SO ser executado neste não são mais atendidos
+    if (self->nucleo->processo_corrente != NULL || (irq != IRQ_SISTEMA && irq != IRQ_ERR_CPU)) {
+        so_trata_irq(self, irq);
+    }
     // faz o processamento independente da interrupção
     so_trata_pendencias(self);
     // escolhe o próximo processo a executar
     so_escolhe_e_executa_escalonador(self, ESCALONADOR_ATUAL);
 
-    if (processo_verifica_todos_mortos(self->tabela_processos, self->n_processos)) {
-        so_encerra_atividade(self);
+    if (!self->encerrado && self->n_processos_vivos == 0) {
+        so_encerra_atividade(self);
+    }
+
+    if (self->erro_interno) {
+        console_printf("SO: erro interno detectado, encerrando atividades");
+        exit(-1);
+    }
+    return so_despacha(self);
+}
+
+static void so_salva_estado_da_cpu(so_t *self)
+{
+    processo_t *processo_corrente = self->nucleo->processo_corrente;
+    if (processo_corrente == NULL)
+        return;
+
+    // Obtem os registradores salvos da interrupção anterior (na área do núcleo) e
+    //   atualiza o estado do processo
+    int area = self->nucleo->end_irq;
+    int pc, reg_A, reg_X, complemento, err;
+    mem_le(self->mem, area + IRQ_END_A, &reg_A);
+    mem_le(self->mem, area + IRQ_END_X, &reg_X);
+    mem_le(self->mem, area + IRQ_END_PC, &pc);
+    mem_le(self->mem, area + IRQ_END_complemento, &complemento);
+    mem_le(self->mem, area + IRQ_END_erro, &err);
+
+    processo_set_pc(processo_corrente, pc);
+    processo_set_reg_A(processo_corrente, reg_A);
+    processo_set_reg_X(processo_corrente, reg_X);
+    processo_set_complemento(processo_corrente, complemento);
+    processo_set_erro(processo_corrente, err);
+}
+
+// Percorre os processos que têm mapeada a página que está no quadro: o dono, se
+//   a página é privada, ou os mapeadores registrados na imagem (processos vivos
+//   que a mapeiam nesse quadro), se é compartilhada
+// '*pos' começa em 0; retorna NULL quando não tem mais
+static processo_t *so_proximo_mapeador(so_t *self, int quadro, int *pos)
+{
+    bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+    if (bloco->imagem == -1) {
+        if ((*pos)++ > 0) {
+            return NULL;
+        }
+        return processo_busca_por_pid(self->tabela_processos, self->n_processos, bloco->processo_pid);
+    }
+    imagem_t *imagem = &self->imagens->imagens[bloco->imagem];
+    if (*pos >= imagem->n_mapeadores[bloco->pagina]) {
+        return NULL;
+    }
+    return self->tabela_processos[imagem->mapeadores[bloco->pagina][(*pos)++] - 1];
+}
+
+// A página que está no quadro foi acessada por algum dos processos que a mapeiam,
+//   desde que o bit foi zerado pela última vez (o bit recolhido para o conjunto
+//   de trabalho conta)
+static bool so_quadro_acessado(so_t *self, int quadro)
+{
+    if (self->gere_blocos->blocos[quadro].acessada) {
+        return true;
+    }
+    int pagina = self->gere_blocos->blocos[quadro].pagina;
+    int pos = 0;
+    processo_t *processo;
+    while ((processo = so_proximo_mapeador(self, quadro, &pos)) != NULL) {
+        if (tabpag_bit_acesso(processo_get_tabpag(processo), pagina)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A página que está no quadro foi alterada; só a privada pode ter sido, a
+//   compartilhada é protegida contra escrita
+static bool so_quadro_alterado(so_t *self, int quadro)
+{
+    bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+    if (bloco->imagem != -1) {
+        return false;
+    }
+    int pos = 0;
+    processo_t *dono = so_proximo_mapeador(self, quadro, &pos);
+    return dono != NULL && tabpag_bit_alteracao(processo_get_tabpag(dono), bloco->pagina);
+}
+
+// Registra se a página pré-buscada no bloco foi usada, e ajusta a janela de
+//   pré-busca do processo dono
+static void so_registra_uso_prebusca(so_t *self, bloco_t *bloco, bool usada)
+{
+    bloco->prebuscada = false;
+    self->n_prebuscadas_pendentes--;
+    processo_t *dono = processo_busca_por_pid(self->tabela_processos, self->n_processos, bloco->processo_pid);
+    int janela = dono != NULL ? processo_get_janela_prebusca(dono) : 0;
+    if (usada) {
+        self->metricas->prebuscadas_usadas++;
+        janela = janela < PREBUSCA_JANELA_MAX ? janela + 1 : PREBUSCA_JANELA_MAX;
+    } else {
+        self->metricas->prebuscadas_nao_usadas++;
+        janela = janela > 1 ? janela / 2 : 1;
+    }
+    if (dono != NULL) {
+        processo_set_janela_prebusca(dono, janela);
+    }
+}
+
+// Confere as páginas pré-buscadas já carregadas que ainda não se sabe se foram
+//   usadas: as com o bit de acesso ligado foram. Se 'pid_morto' não for 0, as
+//   páginas privadas desse processo que não foram usadas contam como não usadas
+//   (ele morreu); as compartilhadas ainda podem ser usadas pelos outros processos.
+static void so_confere_prebuscadas(so_t *self, int pid_morto)
+{
+    if (self->n_prebuscadas_pendentes == 0) {
+        return;
+    }
+    for (int quadro = gere_blocos_mais_antigo(self->gere_blocos); quadro != -1;
+         quadro = gere_blocos_proximo_carregado(self->gere_blocos, quadro)) {
+        bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+        if (!bloco->prebuscada) {
+            continue;
+        }
+        if (so_quadro_acessado(self, quadro)) {
+            so_registra_uso_prebusca(self, bloco, true);
+        } else if (bloco->processo_pid == pid_morto && bloco->imagem == -1) {
+            so_registra_uso_prebusca(self, bloco, false);
+        }
+    }
+}
+
+// Zera o bit de acesso da página no quadro, em todos os processos que a mapeiam;
+//   a entrada na TLB também é invalidada, senão o próximo acesso não marca o bit
+//   de novo
+// Se a página foi pré-buscada, é aqui (ou quando sai do quadro) que se fica
+//   sabendo se ela foi usada
+static void so_zera_bit_acesso(so_t *self, int quadro)
+{
+    bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+    if (bloco->prebuscada && so_quadro_acessado(self, quadro)) {
+        so_registra_uso_prebusca(self, bloco, true);
+    }
+    bloco->acessada = false;
+    int pos = 0;
+    processo_t *processo;
+    while ((processo = so_proximo_mapeador(self, quadro, &pos)) != NULL) {
+        tabpag_zera_bit_acesso(processo_get_tabpag(processo), bloco->pagina);
+        so_invalida_tlb(self, processo_get_pid(processo), bloco->pagina);
+    }
+}
+
+// Segunda chance: a página mais antiga que foi acessada desde a última passagem
+//   tem o bit de acesso zerado e vai para o fim da fila, como se tivesse acabado
+//   de ser carregada. Depois de uma volta completa todas estão com o bit zerado,
+//   então no máximo n_carregados páginas são renovadas.
+static int escolhe_pagina_segunda_chance(so_t *self)
+{
+    int n_carregados = self->gere_blocos->n_carregados;
+    for (int i = 0; i < n_carregados; i++) {
+        int quadro = gere_blocos_mais_antigo(self->gere_blocos);
+        if (!so_quadro_acessado(self, quadro)) {
+            return quadro;
+        }
+
+        so_zera_bit_acesso(self, quadro);
+        gere_blocos_renova_mais_antigo(self->gere_blocos);
+    }
+    return gere_blocos_mais_antigo(self->gere_blocos);
+}
+
+static int escolhe_pagina_fifo(so_t *self) { return gere_blocos_mais_antigo(self->gere_blocos); }
+
+// NRU: as páginas são classificadas pelos bits de acesso e alteração (0: nem acessada
+//   nem alterada, 1: só alterada, 2: só acessada, 3: as duas), e é escolhida a mais
+//   antiga da menor classe. Os bits de acesso são zerados a cada interrupção do relógio.
+static int escolhe_pagina_nru(so_t *self)
+{
+    int escolhido = -1;
+    int menor_classe = 4;
+    for (int quadro = gere_blocos_mais_antigo(self->gere_blocos); quadro != -1 && menor_classe > 0;
+         quadro = gere_blocos_proximo_carregado(self->gere_blocos, quadro)) {
+        int classe = so_quadro_acessado(self, quadro) * 2 + so_quadro_alterado(self, quadro);
+        if (classe < menor_classe) {
+            menor_classe = classe;
+            escolhido = quadro;
+        }
+    }
+    return escolhido;
+}
+
+static void atualiza_nru(so_t *self)
+{
+    for (int quadro = gere_blocos_mais_antigo(self->gere_blocos); quadro != -1;
+         quadro = gere_blocos_proximo_carregado(self->gere_blocos, quadro)) {
+        if (so_quadro_acessado(self, quadro)) {
+            so_zera_bit_acesso(self, quadro);
+        }
+    }
+}
+
+// Envelhecimento: a cada interrupção do relógio, a idade de cada quadro é deslocada
+//   para a direita e recebe o bit de acesso no bit mais significativo (que é então
+//   zerado). É escolhida a página de menor idade (a usada há mais tempo), e entre
+//   as de mesma idade a mais antiga.
+static int escolhe_pagina_envelhecimento(so_t *self)
+{
+    int escolhido = -1;
+    int menor_idade = 256;
+    for (int quadro = gere_blocos_mais_antigo(self->gere_blocos); quadro != -1 && menor_idade > 0;
+         quadro = gere_blocos_proximo_carregado(self->gere_blocos, quadro)) {
+        int idade = self->gere_blocos->blocos[quadro].idade;
+        if (idade < menor_idade) {
+            menor_idade = idade;
+            escolhido = quadro;
+        }
+    }
+    return escolhido;
+}
+
+static void atualiza_envelhecimento(so_t *self)
+{
+    for (int quadro = gere_blocos_mais_antigo(self->gere_blocos); quadro != -1;
+         quadro = gere_blocos_proximo_carregado(self->gere_blocos, quadro)) {
+        bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+        bool acessada = so_quadro_acessado(self, quadro);
+        bloco->idade = (bloco->idade >> 1) | (acessada ? 0x80 : 0);
+        if (acessada) {
+            so_zera_bit_acesso(self, quadro);
+        }
+    }
+}
+
+// Os algoritmos de substituição, indexados por algoritmo_substituicao_t: cada um
+//   escolhe o quadro cuja página vai ser substituída e pode ter uma função
+//   chamada a cada interrupção do relógio para atualizar o seu estado
+typedef struct
+{
+    char *nome;
+    int (*escolhe)(so_t *self);
+    void (*atualiza)(so_t *self);
+} substituicao_t;
+
+static substituicao_t substituicoes[N_ALGORITMO_SUBSTITUICAO] = {
+    [FIFO] = {"fifo", escolhe_pagina_fifo, NULL},
+    [SEGUNDA_CHANCE] = {"segunda_chance", escolhe_pagina_segunda_chance, NULL},
+    [NRU] = {"nru", escolhe_pagina_nru, atualiza_nru},
+    [ENVELHECIMENTO] = {"envelhecimento", escolhe_pagina_envelhecimento, atualiza_envelhecimento},
+};
+
+algoritmo_substituicao_t so_algoritmo_substituicao(char *nome)
+{
+    for (int i = 0; i < N_ALGORITMO_SUBSTITUICAO; i++) {
+        if (strcmp(nome, substituicoes[i].nome) == 0) {
+            return i;
+        }
+    }
+    return N_ALGORITMO_SUBSTITUICAO;
+}
+
+void so_define_algoritmo_substituicao(so_t *self, algoritmo_substituicao_t algoritmo)
+{
+    self->algoritmo_substituicao = algoritmo;
+}
+
+static char *nome_algoritmo_substituicao(so_t *self) { return substituicoes[self->algoritmo_substituicao].nome; }
+
+static void atualiza_algoritmo_substituicao(so_t *self)
+{
+    substituicao_t *substituicao = &substituicoes[self->algoritmo_substituicao];
+    if (substituicao->atualiza != NULL) {
+        substituicao->atualiza(self);
+    }
+}
+
+// Retorna o quadro cuja página deve ser substituída, ou -1
+static int escolhe_pagina_substituir(so_t *self)
+{
+    console_printf("SO: escolhendo página para substituir com %s", nome_algoritmo_substituicao(self));
+    return substituicoes[self->algoritmo_substituicao].escolhe(self);
+}
+
+// Processo suspenso pelo controle de carga
+static bool so_suspenso(processo_t *processo)
+{
+    return processo_get_estado(processo) == BLOQUEADO && processo_get_motivo_bloqueio(processo) == ESPERANDO_MEMORIA;
+}
+
+// Quadros com páginas de processos, carregadas ou chegando
+static int so_quadros_em_uso(so_t *self) { return self->gere_blocos->n_carregados + self->gere_blocos->n_reservados; }
+
+// Atualiza as métricas de quadros depois que um quadro foi ocupado ou liberado;
+//   'variacao' é 1 se o processo ganhou um quadro com página privada, -1 se
+//   perdeu, 0 se o quadro é de página compartilhada (não conta para ninguém)
+static void so_atualiza_quadros(so_t *self, processo_t *processo, int variacao)
+{
+    processo_conta_quadro(processo, variacao);
+    if (so_quadros_em_uso(self) > self->metricas->pico_quadros) {
+        self->metricas->pico_quadros = so_quadros_em_uso(self);
+    }
+}
+
+// Cota de quadros do processo, derivada do seu conjunto de trabalho
+static int so_cota_quadros(processo_t *processo)
+{
+    int cota = processo_get_conjunto_trabalho(processo) + FOLGA_COTA;
+    return cota < COTA_MINIMA ? COTA_MINIMA : cota;
+}
+
+// Substituição local: a página privada do processo carregada há mais tempo que
+//   não foi acessada, ou a mais antiga se todas foram; -1 se ele não tem nenhuma
+static int escolhe_pagina_local(so_t *self, int pid)
+{
+    int mais_antiga = -1;
+    for (int quadro = gere_blocos_mais_antigo(self->gere_blocos); quadro != -1;
+         quadro = gere_blocos_proximo_carregado(self->gere_blocos, quadro)) {
+        bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+        if (bloco->processo_pid != pid || bloco->imagem != -1) {
+            continue;
+        }
+        if (!so_quadro_acessado(self, quadro)) {
+            return quadro;
+        }
+        if (mais_antiga == -1) {
+            mais_antiga = quadro;
+        }
+    }
+    return mais_antiga;
+}
+
+// Coloca na fila do disco a transferência entre a página 'pagina_sec' da memória
+//   secundária e o quadro 'quadro' da principal
+static bool so_requisita_disco(so_t *self, disco_operacao_t operacao, int pagina_sec, int quadro)
+{
+    if (es_escreve(self->es, D_DISCO_PAGINA, pagina_sec) != ERR_OK ||
+        es_escreve(self->es, D_DISCO_QUADRO, quadro) != ERR_OK ||
+        es_escreve(self->es, D_DISCO_COMANDO, operacao) != ERR_OK) {
+        console_printf("SO: problema ao requisitar transferência ao disco");
+        return false;
+    }
+    return true;
+}
+
+// Imagem compartilhada que o processo executa
+static imagem_t *so_imagem_do_processo(so_t *self, processo_t *processo)
+{
+    return &self->imagens->imagens[processo_get_imagem(processo)];
+}
+
+// Página da memória secundária com a página 'pagina' do processo: a cópia privada,
+//   se o processo já escreveu nela, senão a da imagem compartilhada
+static int so_pagina_mem_sec(so_t *self, processo_t *processo, int pagina)
+{
+    if (processo_pagina_privada(processo, pagina)) {
+        return PAGINA_DO_END(processo_get_end_mem_sec(processo)) + pagina;
+    }
+    return so_imagem_do_processo(self, processo)->pagina_mem_sec + pagina;
+}
+
+// Quadro com a página do processo, já carregada ou sendo lida do disco, -1 se
+//   não tem; uma página compartilhada pode ter sido pedida por outro processo
+static int so_quadro_da_pagina(so_t *self, processo_t *processo, int pagina)
+{
+    if (processo_pagina_privada(processo, pagina)) {
+        return processo_quadro_reservado(processo, pagina);
+    }
+    return so_imagem_do_processo(self, processo)->quadros[pagina];
+}
+
+// O processo usa a página que está no quadro: é o dono da página privada, ou
+//   executa a imagem da compartilhada e não tem cópia privada dela
+static bool so_usa_pagina_do_quadro(so_t *self, processo_t *processo, int quadro)
+{
+    bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+    if (processo_get_estado(processo) == MORTO) {
+        return false;
+    }
+    if (bloco->imagem == -1) {
+        return processo_get_pid(processo) == bloco->processo_pid;
+    }
+    return processo_get_imagem(processo) == bloco->imagem && !processo_pagina_privada(processo, bloco->pagina);
+}
+
+// Mapeia a página que está no quadro na tabela do processo; a compartilhada fica
+//   protegida contra escrita, e a primeira escrita nela faz a cópia privada
+//   (so_trata_escrita_protegida); o processo é registrado como mapeador dela
+static void so_mapeia_pagina(so_t *self, processo_t *processo, int quadro)
+{
+    bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+    tabpag_t *tabela = processo_get_tabpag(processo);
+    tabpag_define_quadro(tabela, bloco->pagina, quadro);
+    if (bloco->imagem != -1) {
+        tabpag_protege_pagina(tabela, bloco->pagina, true);
+        if (!imagens_adiciona_mapeador(self->imagens, bloco->imagem, bloco->pagina, processo_get_pid(processo))) {
+            self->erro_interno = true;
+        }
     }
+    so_invalida_tlb(self, processo_get_pid(processo), bloco->pagina);
+}
 
-    if (self->erro_interno) {
-        console_printf("SO: erro interno detectado, encerrando atividades");
-        exit(-1);
+// Pede ao disco a página que contém 'end_causador' do processo, para o quadro
+// O quadro fica reservado para a página, mas só é mapeado (e entra na ordem de
+//   carga, podendo ser escolhido para substituição) quando a leitura termina
+// Uma página compartilhada fica registrada na imagem já na reserva, para os
+//   outros processos que a pedirem esperarem pela mesma leitura
+static bool so_traz_pagina_para_quadro(so_t *self, processo_t *processo, int end_causador, int quadro)
+{
+    int pagina = PAGINA_DO_END(end_causador);
+    if (!so_requisita_disco(self, DISCO_LE, so_pagina_mem_sec(self, processo, pagina), quadro)) {
+        return false;
     }
-    return so_despacha(self);
+    int imagem = processo_pagina_privada(processo, pagina) ? -1 : processo_get_imagem(processo);
+    gere_blocos_reserva_bloco(self->gere_blocos, quadro, processo_get_pid(processo), imagem, pagina,
+                              imagem == -1 ? processo_get_quadros_reservados(processo) : NULL);
+    if (imagem != -1) {
+        self->imagens->imagens[imagem].quadros[pagina] = quadro;
+    }
+    self->metricas->paginas_lidas++;
+    processo_registra_pagina_lida(processo);
+    so_atualiza_quadros(self, processo, imagem == -1 ? 1 : 0);
+    console_printf("SO: página %d pedida ao disco para o quadro %d", pagina, quadro);
+    return true;
 }
 
-static void so_salva_estado_da_cpu(so_t *self)
+// Termina a carga da página que o disco leu para o quadro: mapeia a página nos
+//   processos que a usam e desbloqueia os que esperavam por ela; se o processo
+//   morreu (ou a imagem foi descartada) enquanto isso, o quadro é liberado
+static void so_conclui_carga_pagina(so_t *self, int quadro)
 {
-    processo_t *processo_corrente = self->processo_corrente;
-    if (processo_corrente == NULL)
+    bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+    bool descartada;
+    if (bloco->imagem == -1) {
+        processo_t *dono = processo_busca_por_pid(self->tabela_processos, self->n_processos, bloco->processo_pid);
+        descartada = dono == NULL || processo_get_estado(dono) == MORTO;
+    } else {
+        descartada = self->imagens->imagens[bloco->imagem].n_usuarios == 0;
+    }
+    if (descartada) {
+        if (bloco->prebuscada) {
+            so_registra_uso_prebusca(self, bloco, false);
+        }
+        gere_blocos_libera_bloco(self->gere_blocos, quadro);
         return;
+    }
 
-    // Obtem os registradores salvos da interrupção anterior e atualiza o estado do processo
-    int pc, reg_A, reg_X, complemento, err;
-    mem_le(self->mem, IRQ_END_A, &reg_A);
-    mem_le(self->mem, IRQ_END_X, &reg_X);
-    mem_le(self->mem, IRQ_END_PC, &pc);
-    mem_le(self->mem, IRQ_END_complemento, &complemento);
-    mem_le(self->mem, IRQ_END_erro, &err);
+    int pagina = bloco->pagina;
+    gere_blocos_ativa_bloco(self->gere_blocos, quadro);
+    if (!bloco->prebuscada) {
+        bloco->idade = 0x80;
+    }
+    console_printf("SO: página %d transferida para o quadro %d%s", pagina, quadro,
+                   bloco->prebuscada ? " (pré-busca)" : "");
 
-    processo_set_pc(processo_corrente, pc);
-    processo_set_reg_A(processo_corrente, reg_A);
-    processo_set_reg_X(processo_corrente, reg_X);
-    processo_set_complemento(processo_corrente, complemento);
-    processo_set_erro(processo_corrente, err);
+    for (int i = 0; i < self->n_processos; i++) {
+        processo_t *processo = self->tabela_processos[i];
+        if (!so_usa_pagina_do_quadro(self, processo, quadro)) {
+            continue;
+        }
+        so_mapeia_pagina(self, processo, quadro);
+
+        // Só acorda o processo se era esta a página que ele esperava. Para ele a
+        //   página conta como acessada (e o quadro fica com a idade de quem acabou
+        //   de ser acessado): ele vai acessá-la assim que voltar a executar, e sem
+        //   isso ela seria a primeira escolhida numa substituição enquanto ele
+        //   ainda está bloqueado. A pré-buscada não, se não for usada é a primeira
+        //   a sair.
+        if (processo_get_estado(processo) == BLOQUEADO &&
+            processo_get_motivo_bloqueio(processo) == ESPERANDO_PAGINA &&
+            PAGINA_DO_END(processo_get_complemento(processo)) == pagina) {
+            tabpag_marca_bit_acesso(processo_get_tabpag(processo), pagina, false);
+            so_processa_desbloqueio_proc(self, processo, true);
+        }
+    }
 }
 
-static int escolhe_pagina_substituir(so_t *self)
+// Tira a página que está no quadro: se foi alterada, é mandada para a memória
+//   secundária pelo disco; depois é invalidada nas tabelas de páginas dos
+//   processos que a mapeiam e na TLB
+// A página compartilhada nunca é alterada, e deixa de estar na imagem
+static bool so_remove_pagina_do_quadro(so_t *self, int quadro)
 {
-    switch (ALGORITMO_SUBSTITUICAO_ATUAL) {
-    case FIFO:
-        console_printf("SO: escolhendo página para substituir com FIFO");
-        break;
-    case SEGUNDA_CHANCE:
-        console_printf("SO: escolhendo página para substituir com Segunda Chance");
-        break;
-    default:
-        console_printf("SO: algoritmo de substituição de página não reconhecido");
-        break;
+    bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+    if (bloco->prebuscada) {
+        so_registra_uso_prebusca(self, bloco, so_quadro_acessado(self, quadro));
+    }
+    bool alterada = so_quadro_alterado(self, quadro);
+    if (alterada) {
+        int pos = 0;
+        processo_t *dono = so_proximo_mapeador(self, quadro, &pos);
+        if (!so_requisita_disco(self, DISCO_ESCREVE, so_pagina_mem_sec(self, dono, bloco->pagina), quadro)) {
+            return false;
+        }
     }
-    return -1;
+    int pos = 0;
+    processo_t *processo;
+    while ((processo = so_proximo_mapeador(self, quadro, &pos)) != NULL) {
+        tabpag_invalida_pagina(processo_get_tabpag(processo), bloco->pagina);
+        so_invalida_tlb(self, processo_get_pid(processo), bloco->pagina);
+    }
+    if (bloco->imagem != -1) {
+        self->imagens->imagens[bloco->imagem].quadros[bloco->pagina] = -1;
+        imagens_limpa_mapeadores(self->imagens, bloco->imagem, bloco->pagina);
+    }
+    self->metricas->paginas_retiradas++;
+    if (alterada) {
+        self->metricas->paginas_salvas++;
+    }
+
+    console_printf("SO: página %d %s %d retirada do quadro %d%s", bloco->pagina,
+                   bloco->imagem == -1 ? "do processo" : "da imagem",
+                   bloco->imagem == -1 ? bloco->processo_pid : bloco->imagem, quadro,
+                   alterada ? " (alterada, salva na memória secundária)" : "");
+    int imagem = bloco->imagem;
+    int pid = bloco->processo_pid;
+    gere_blocos_libera_bloco(self->gere_blocos, quadro);
+
+    // A página privada conta para o dono; ela sai por uma falta de outro processo
+    //   se o dono não foi suspenso nem é o que está executando
+    processo_t *dono = processo_busca_por_pid(self->tabela_processos, self->n_processos, pid);
+    if (imagem == -1 && dono != NULL) {
+        bool por_outro = !so_suspenso(dono) && dono != self->nucleo->processo_corrente;
+        processo_registra_pagina_retirada(dono, alterada, por_outro);
+        so_atualiza_quadros(self, dono, -1);
+    }
+    return true;
 }
 
-static bool transf_pag_mem_sec_para_mem_princ(so_t *self, int end_mem_sec, int quadro_livre)
+// Pede ao disco as páginas seguintes a 'pagina' do processo, até o tamanho da
+//   janela de pré-busca, enquanto tiver quadro livre (a pré-busca não tira
+//   página de ninguém); pula as que já estão na memória ou chegando, inclusive
+//   as compartilhadas trazidas por outro processo
+static void so_prebusca(so_t *self, processo_t *processo, int pagina)
 {
-    // Percorro o tamanho da pagina movendo cada posição para mememoria principal
-    for (int dif_end = 0; dif_end < TAM_PAGINA; dif_end++) {
-        int dado;
-        // Leio da memória secundária o valor destino
-        if (mem_le(self->memoria_secundaria, end_mem_sec + dif_end, &dado) != ERR_OK) {
-            console_printf("SO: problema ao ler da memória secundária");
-            return false;
-        }
-        // Calculo o endereço físico da página
-        int end_fisico_pag = (quadro_livre * TAM_PAGINA) + dif_end;
+    tabpag_t *tabela = processo_get_tabpag(processo);
+    int ultima = pagina + processo_get_janela_prebusca(processo);
+    if (ultima >= processo_get_paginas_mem_sec(processo)) {
+        ultima = processo_get_paginas_mem_sec(processo) - 1;
+    }
 
-        // Escrevo o valor na memória principal
-        if (mem_escreve(self->mem, end_fisico_pag, dado) != ERR_OK) {
-            // Escrevo na memória principal o valor lido da memória secundaria
-            console_printf("SO: problema ao escrever na memória principal");
-            return false;
+    for (int seguinte = pagina + 1; seguinte <= ultima && gere_blocos_tem_disponivel(self->gere_blocos); seguinte++) {
+        int quadro;
+        if (tabpag_traduz(tabela, seguinte, &quadro) == ERR_OK || so_quadro_da_pagina(self, processo, seguinte) != -1) {
+            continue;
+        }
+        quadro = gere_blocos_buscar_proximo(self->gere_blocos);
+        if (!so_traz_pagina_para_quadro(self, processo, END_DA_PAGINA(seguinte), quadro)) {
+            self->erro_interno = true;
+            return;
         }
+        self->gere_blocos->blocos[quadro].prebuscada = true;
+        self->n_prebuscadas_pendentes++;
+        self->metricas->paginas_prebuscadas++;
     }
-    return true;
 }
 
-/* static bool transf_mem_princ_para_mem_sec(so_t *self, int quadro, int end_mem_sec) */
-/* { */
-/*     // Percorro o tamanho da pagina movendo cada posição para mememoria secundaria */
-/*     for (int dif_end = 0; dif_end < TAM_PAGINA; dif_end++) { */
-/*         int dado; */
-/*         int end_fisico_pag = (quadro * TAM_PAGINA + dif_end; */
-/*         int end_mem_sec_pagina = end_mem_sec + dif_end; */
-/**/
-/*         // Leio da memória principal o valor destino */
-/*         if (mem_le(self->mem, end_fisico_pag, &dado) != ERR_OK) { */
-/*             console_printf("SO: problema ao ler da memória principal"); */
-/*             return false; */
-/*         } */
-/**/
-/*         // Escrevo o valor na memória secundária */
-/*         if (mem_escreve(self->memoria_secundaria, end_mem_sec_pagina, dado) != ERR_OK) { */
-/*             console_printf("SO: problema ao escrever na memória secundária"); */
-/*             return false; */
-/*         } */
-/*     } */
-/*     return true; */
-/* } */
-
-static void so_trata_page_fault_bloco_livre(so_t *self, int end_causador)
-{
-    processo_t *processo = self->processo_corrente;
+static bool so_trata_page_fault_bloco_livre(so_t *self, int end_causador)
+{
     int quadro_livre = gere_blocos_buscar_proximo(self->gere_blocos);
     if (quadro_livre == ERR_PAGINA_INVALIDA) {
-        self->erro_interno = true;
         console_printf("SO: problema ao buscar página livre na memória principal");
-        return;
-    }
-
-    int end_disk_ini = processo_get_end_mem_sec(processo) + end_causador - (end_causador % TAM_PAGINA);
-    int end_disk = end_disk_ini;
-
-    // Transfere a página da memória secundária para a memória principal
-    int pagina = end_causador / TAM_PAGINA;
-    if (transf_pag_mem_sec_para_mem_princ(self, end_disk, quadro_livre)) {
-        // Atualiza a tabela de páginas e o gerenciador de blocos
-        tabpag_t *tabela = processo_get_tabpag(processo);
-        tabpag_define_quadro(tabela, pagina, quadro_livre);
-
-        gere_blocos_atualiza_bloco(self->gere_blocos, quadro_livre, processo_get_pid(processo), pagina);
-        console_printf("SO: página %d transferida para o quadro %d", pagina, quadro_livre);
-        return;
+        return false;
     }
 
-    console_printf("SO: problema ao transferir página da memória secundária para a memória principal");
-    self->erro_interno = true;
+    return so_traz_pagina_para_quadro(self, self->nucleo->processo_corrente, end_causador, quadro_livre);
 }
 
-static void trata_falha_pagina_substituicao(so_t *self, int end_ausente)
+static bool trata_falha_pagina_substituicao(so_t *self, int end_ausente)
 {
     console_printf("SO: SUBSTUTUICAO de pagina necessaria");
 
-    int pagina_removida = escolhe_pagina_substituir(self);
-
-    if (pagina_removida == -1) {
+    // O processo que já está na sua cota perde uma página sua, não dos outros
+    int quadro = -1;
+    processo_t *processo = self->nucleo->processo_corrente;
+    int pid = processo_get_pid(processo);
+    if (JANELA_CONJUNTO_TRABALHO > 0 && processo_get_quadros(processo) >= so_cota_quadros(processo)) {
+        quadro = escolhe_pagina_local(self, pid);
+        if (quadro != -1) {
+            self->metricas->substituicoes_locais++;
+        }
+    }
+    if (quadro == -1) {
+        quadro = escolhe_pagina_substituir(self);
+    }
+    if (quadro == -1) {
         console_printf("SO: PROBLEMA AO ESCOLHER PAGINA");
-        return;
+        return false;
+    }
+
+    if (!so_remove_pagina_do_quadro(self, quadro)) {
+        return false;
     }
+
+    // O quadro pode ser reutilizado logo em seguida: o disco copia o conteúdo de
+    //   uma escrita quando recebe a requisição
+    return so_traz_pagina_para_quadro(self, self->nucleo->processo_corrente, end_ausente, quadro);
 }
 
 static void so_trata_falha_pagina(so_t *self)
 {
     console_printf("SO: tratando página ausente");
-    int end_ausente = processo_get_complemento(self->processo_corrente);
+    self->metricas->falhas_pagina++;
+    processo_t *processo = self->nucleo->processo_corrente;
+    processo_registra_falha_pagina(processo);
+    int end_ausente = processo_get_complemento(processo);
+    int pagina = PAGINA_DO_END(end_ausente);
+
+    // Fora da imagem não tem de onde trazer a página
+    if (end_ausente < 0 || pagina >= processo_get_paginas_mem_sec(processo)) {
+        console_printf("SO: processo %d acessou o endereço %d, fora da sua memória", processo_get_pid(processo),
+                       end_ausente);
+        so_processa_morte_proc(self, processo);
+        self->nucleo->processo_corrente = NULL;
+        return;
+    }
 
+    // A página compartilhada pode já estar num quadro, trazida para outro processo
+    //   que executa a mesma imagem: basta mapear
+    int quadro = so_quadro_da_pagina(self, processo, pagina);
+    if (quadro != -1 && !gere_blocos_reservado(self->gere_blocos, quadro)) {
+        console_printf("SO: página %d compartilhada, já no quadro %d", pagina, quadro);
+        self->metricas->mapeamentos_compartilhados++;
+        so_mapeia_pagina(self, processo, quadro);
+        return;
+    }
+
+    // A página pode já estar chegando, pedida por uma pré-busca ou por outro processo
+    if (quadro != -1) {
+        console_printf("SO: página %d já pedida ao disco para o quadro %d", pagina, quadro);
+        if (self->gere_blocos->blocos[quadro].prebuscada) {
+            so_registra_uso_prebusca(self, &self->gere_blocos->blocos[quadro], true);
+        }
+        so_processa_bloqueio_proc(self, processo, ESPERANDO_PAGINA);
+        return;
+    }
+
+    bool ok;
     // Verifica se existe bloco disponivel na memoria principal para importar da memoria secundária
     if (gere_blocos_tem_disponivel(self->gere_blocos)) {
         console_printf("SO: BLOCO DISPONIVEL na memória principal");
-        // Transfere a página da memória secundária para o bloco disponivel na memória principal
-        so_trata_page_fault_bloco_livre(self, end_ausente);
+        // Pede a página da memória secundária para o bloco disponivel na memória principal
+        ok = so_trata_page_fault_bloco_livre(self, end_ausente);
     } else {
         console_printf("SO: SUBSTITUINDO página na memória principal");
         // Substitui uma página da memória principal por uma da memória sec
-        trata_falha_pagina_substituicao(self, end_ausente);
+        ok = trata_falha_pagina_substituicao(self, end_ausente);
+    }
+
+    if (!ok) {
+        self->erro_interno = true;
+        return;
     }
+    so_prebusca(self, processo, pagina);
 
-    int tempo_sistema = tempo_atual_sistema(self);
-    so_processa_bloqueio_proc(self, self->processo_corrente, ESPERANDO_PAGINA);
-    processo_set_tempo_desbloqueio(self->processo_corrente, tempo_sistema + TEMPO_MUDANCA_PAGINA_CPU);
+    // O processo espera pelo disco, a interrupção do fim da leitura o desbloqueia
+    //   (so_trata_irq_disco)
+    so_processa_bloqueio_proc(self, processo, ESPERANDO_PAGINA);
 }
 
-static void trata_pendencia_leitura(so_t *self, processo_t *processo)
+// Escrita numa página compartilhada (protegida): o processo passa a ter uma cópia
+//   privada da página (cópia na escrita), que vai para a sua extensão da memória
+//   secundária quando sair da memória principal. Se ele é o único que mapeia o
+//   quadro, o próprio quadro vira a cópia; senão a página é copiada para outro
+//   quadro, livre ou tirado de outra página (que pode ser a própria compartilhada,
+//   e aí não precisa copiar). O processo não bloqueia, refaz a escrita.
+static void so_trata_escrita_protegida(so_t *self)
 {
-    int estado;
-    int terminal_proc = processo_get_terminal(processo);
-    int terminal_teclado_ok = processo_calcula_terminal(D_TERM_A_TECLADO_OK, terminal_proc);
-    if (es_le(self->es, terminal_teclado_ok, &estado) != ERR_OK) {
-        console_printf("SO: problema no acesso ao estado do teclado");
+    processo_t *processo = self->nucleo->processo_corrente;
+    int pagina = PAGINA_DO_END(processo_get_complemento(processo));
+    tabpag_t *tabela = processo_get_tabpag(processo);
+    int quadro;
+    if (tabpag_traduz(tabela, pagina, &quadro) != ERR_OK || !tabpag_pagina_protegida(tabela, pagina)) {
+        console_printf("SO: escrita protegida na página %d, que não é compartilhada", pagina);
         self->erro_interno = true;
         return;
     }
+    self->metricas->copias_na_escrita++;
+    bloco_t *bloco = &self->gere_blocos->blocos[quadro];
 
-    // Se o teclado ainda estiver ocupado retorna
-    if (estado == 0) {
-        return;
+    int pos = 0;
+    so_proximo_mapeador(self, quadro, &pos);
+    int copia;
+    if (so_proximo_mapeador(self, quadro, &pos) == NULL) {
+        if (bloco->prebuscada) {
+            so_registra_uso_prebusca(self, bloco, true);
+        }
+        self->imagens->imagens[bloco->imagem].quadros[pagina] = -1;
+        bloco->imagem = -1;
+        bloco->processo_pid = processo_get_pid(processo);
+        copia = quadro;
+        so_atualiza_quadros(self, processo, 1);
+    } else {
+        copia = gere_blocos_buscar_proximo(self->gere_blocos);
+        if (copia == -1) {
+            copia = escolhe_pagina_substituir(self);
+            if (copia == -1 || !so_remove_pagina_do_quadro(self, copia)) {
+                console_printf("SO: problema ao liberar quadro para a cópia da página %d", pagina);
+                self->erro_interno = true;
+                return;
+            }
+        }
+        // Se o quadro escolhido foi o da própria página, o conteúdo continua lá
+        if (copia != quadro) {
+            mem_copia(self->mem, END_DA_PAGINA(copia), self->mem, END_DA_PAGINA(quadro), TAM_PAGINA);
+        }
+        gere_blocos_reserva_bloco(self->gere_blocos, copia, processo_get_pid(processo), -1, pagina,
+                                  processo_get_quadros_reservados(processo));
+        gere_blocos_ativa_bloco(self->gere_blocos, copia);
+        self->gere_blocos->blocos[copia].idade = 0x80;
+        so_atualiza_quadros(self, processo, 1);
+    }
+    console_printf("SO: cópia na escrita da página %d do processo %d, no quadro %d", pagina,
+                   processo_get_pid(processo), copia);
+
+    // A cópia conta como alterada: ela ainda não está na memória secundária
+    imagens_remove_mapeador(self->imagens, processo_get_imagem(processo), pagina, processo_get_pid(processo));
+    if (processo_pagina_no_conjunto_trabalho(processo, pagina, JANELA_CONJUNTO_TRABALHO)) {
+        imagens_conta_conjunto(self->imagens, processo_get_imagem(processo), pagina, -1);
+    }
+    processo_marca_pagina_privada(processo, pagina);
+    tabpag_define_quadro(tabela, pagina, copia);
+    tabpag_marca_bit_acesso(tabela, pagina, true);
+    so_invalida_tlb(self, processo_get_pid(processo), pagina);
+}
+
+// A cada interrupção do relógio, os bits de acesso de cada processo são recolhidos:
+//   a página acessada é marcada com o tempo virtual do processo, e o bit vai da
+//   tabela de páginas para o bloco, onde o algoritmo de substituição continua
+//   vendo ele até zerá-lo. Os processos que estavam executando (um por núcleo)
+//   avançam o seu tempo virtual, e os conjuntos de trabalho são recalculados.
+// As páginas compartilhadas do conjunto de trabalho de um processo ativo saem da
+//   contagem da imagem antes e voltam depois, com o conjunto novo
+static void so_atualiza_conjuntos_trabalho(so_t *self)
+{
+    for (int i = 0; i < self->n_processos; i++) {
+        processo_t *processo = self->tabela_processos[i];
+        if (processo_get_estado(processo) == MORTO) {
+            continue;
+        }
+        bool ativo = so_ativo(processo);
+        if (ativo) {
+            so_conta_conjunto_trabalho(self, processo, -1);
+        }
+        if (so_executando(self, processo)) {
+            processo_incrementa_tempo_virtual(processo);
+        }
+        tabpag_t *tabela = processo_get_tabpag(processo);
+        for (int pagina = 0; pagina < processo_get_paginas_mem_sec(processo); pagina++) {
+            int quadro;
+            if (!tabpag_bit_acesso(tabela, pagina) || tabpag_traduz(tabela, pagina, &quadro) != ERR_OK) {
+                continue;
+            }
+            processo_registra_uso_pagina(processo, pagina);
+            self->gere_blocos->blocos[quadro].acessada = true;
+            tabpag_zera_bit_acesso(tabela, pagina);
+            so_invalida_tlb(self, processo_get_pid(processo), pagina);
+        }
+        processo_calcula_conjunto_trabalho(processo, JANELA_CONJUNTO_TRABALHO);
+        if (ativo) {
+            so_conta_conjunto_trabalho(self, processo, 1);
+        }
     }
-    console_printf("SO: terminal %d desbloqueado para leitura", processo_get_terminal(processo));
+}
 
-    int dado;
-    int terminal_leitura = processo_calcula_terminal(D_TERM_A_TECLADO, terminal_proc);
-    if (es_le(self->es, terminal_leitura, &dado) != ERR_OK) {
-        console_printf("SO: problema no acesso ao teclado");
-        self->erro_interno = true;
-        return;
+// Soma 'variacao' à contagem, na imagem, de cada página compartilhada que está no
+//   conjunto de trabalho do processo
+static void so_conta_conjunto_trabalho(so_t *self, processo_t *processo, int variacao)
+{
+    for (int pagina = 0; pagina < processo_get_paginas_mem_sec(processo); pagina++) {
+        if (!processo_pagina_privada(processo, pagina) &&
+            processo_pagina_no_conjunto_trabalho(processo, pagina, JANELA_CONJUNTO_TRABALHO)) {
+            imagens_conta_conjunto(self->imagens, processo_get_imagem(processo), pagina, variacao);
+        }
     }
+}
 
-    processo_set_reg_A(processo, dado);
-    so_processa_desbloqueio_proc(self, processo, true);
+// Quadros que os processos podem usar (os primeiros são do SO)
+static int so_quadros_usuario(so_t *self) { return self->n_paginas_fisica - self->quadro_livre_inicial; }
+
+static bool so_ativo(processo_t *processo) { return processo_get_estado(processo) != MORTO && !so_suspenso(processo); }
+
+// Processo ativo que não depende de outro processo para continuar
+static bool so_progride(processo_t *processo)
+{
+    return so_ativo(processo) && !(processo_get_estado(processo) == BLOQUEADO &&
+                                   processo_get_motivo_bloqueio(processo) == ESPERANDO_PROCESSO);
 }
 
-static void trata_pendencia_escrita(so_t *self, processo_t *processo)
+static int so_n_progridem(so_t *self)
 {
-    int estado;
-    int terminal = processo_get_terminal(processo);
+    int n = 0;
+    for (int i = 0; i < self->n_processos; i++) {
+        if (so_progride(self->tabela_processos[i])) {
+            n++;
+        }
+    }
+    return n;
+}
 
-    int terminal_tela_ok = processo_calcula_terminal(D_TERM_A_TELA_OK, terminal);
-    if (es_le(self->es, terminal_tela_ok, &estado) != ERR_OK) {
-        console_printf("SO: problema no acesso ao estado da tela");
-        self->erro_interno = true;
-        return;
+// Soma dos conjuntos de trabalho dos processos ativos (vivos e não suspensos); uma
+//   página compartilhada que está no conjunto de trabalho de vários conta uma vez só
+//   (as repetidas são contadas pelas imagens, ver so_conta_conjunto_trabalho)
+static int so_demanda_memoria(so_t *self)
+{
+    int demanda = 0;
+    for (int i = 0; i < self->n_processos; i++) {
+        processo_t *processo = self->tabela_processos[i];
+        if (so_ativo(processo)) {
+            demanda += processo_get_conjunto_trabalho(processo);
+        }
     }
+    return demanda - self->imagens->paginas_repetidas;
+}
 
-    // Se o dispositivo não estiver disponivel retorna
-    if (estado == 0) {
-        return;
+static void so_registra_evento_carga(so_t *self, processo_t *processo, bool suspensao, int demanda)
+{
+    if (self->n_eventos_carga == self->cap_eventos_carga) {
+        int nova_cap = self->cap_eventos_carga == 0 ? 8 : self->cap_eventos_carga * 2;
+        evento_carga_t *novos = realloc(self->eventos_carga, nova_cap * sizeof(evento_carga_t));
+        if (novos == NULL) {
+            console_printf("SO: sem memória para registrar o controle de carga");
+            return;
+        }
+        self->eventos_carga = novos;
+        self->cap_eventos_carga = nova_cap;
+    }
+    self->eventos_carga[self->n_eventos_carga++] = (evento_carga_t){
+        .tempo = self->t_relogio_atual,
+        .pid = processo_get_pid(processo),
+        .suspensao = suspensao,
+        .demanda = demanda,
+    };
+}
+
+// Suspende o processo e tira as suas páginas da memória principal: as privadas
+//   saem dos quadros (as alteradas vão para a memória secundária), as
+//   compartilhadas só deixam de estar mapeadas nele
+static void so_suspende_processo(so_t *self, processo_t *processo, int demanda)
+{
+    int pid = processo_get_pid(processo);
+    console_printf("SO: processo %d suspenso, conjuntos de trabalho somam %d páginas para %d quadros", pid, demanda,
+                   so_quadros_usuario(self));
+    so_registra_evento_carga(self, processo, true, demanda);
+    so_conta_conjunto_trabalho(self, processo, -1);
+    so_processa_bloqueio_proc(self, processo, ESPERANDO_MEMORIA);
+
+    tabpag_t *tabela = processo_get_tabpag(processo);
+    int proximo;
+    for (int quadro = gere_blocos_mais_antigo(self->gere_blocos); quadro != -1; quadro = proximo) {
+        proximo = gere_blocos_proximo_carregado(self->gere_blocos, quadro);
+        bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+        int quadro_mapeado;
+        if (bloco->imagem == -1 && bloco->processo_pid == pid) {
+            if (!so_remove_pagina_do_quadro(self, quadro)) {
+                self->erro_interno = true;
+                return;
+            }
+        } else if (bloco->imagem != -1 && tabpag_traduz(tabela, bloco->pagina, &quadro_mapeado) == ERR_OK &&
+                   quadro_mapeado == quadro) {
+            tabpag_invalida_pagina(tabela, bloco->pagina);
+            so_invalida_tlb(self, pid, bloco->pagina);
+            imagens_remove_mapeador(self->imagens, bloco->imagem, bloco->pagina, pid);
+        }
     }
-    console_printf("SO: terminal %d desbloqueado para escrita", terminal);
+}
 
-    int dado = processo_get_reg_X(processo);
-    int terminal_tela = processo_calcula_terminal(D_TERM_A_TELA, terminal);
-    if (es_escreve(self->es, terminal_tela, dado) != ERR_OK) {
-        console_printf("SO: problema no acesso à tela");
-        self->erro_interno = true;
-        return;
+// Retoma os suspensos, na ordem em que foram suspensos, enquanto o conjunto de
+//   trabalho do primeiro couber na memória junto com os dos ativos; se nenhum
+//   processo pode continuar sem ele, o primeiro é retomado mesmo que não caiba
+static void so_retoma_suspensos(so_t *self)
+{
+    while (!fila_processos_vazia(self->fila_espera_memoria)) {
+        processo_t *processo = fila_processos_primeiro(self->fila_espera_memoria);
+        int demanda = so_demanda_memoria(self);
+        int sobra = so_quadros_usuario(self) - demanda - processo_get_conjunto_trabalho(processo);
+        if (so_n_progridem(self) > 0 && sobra < FOLGA_CARGA) {
+            return;
+        }
+        console_printf("SO: processo %d retomado", processo_get_pid(processo));
+        so_registra_evento_carga(self, processo, false, demanda + processo_get_conjunto_trabalho(processo));
+        so_processa_desbloqueio_proc(self, processo, true);
+        so_conta_conjunto_trabalho(self, processo, 1);
     }
+}
 
-    processo_set_reg_A(processo, 0);
-    so_processa_desbloqueio_proc(self, processo, true);
+// Controle de carga: enquanto a soma dos conjuntos de trabalho dos processos
+//   ativos não couber na memória, suspende o processo pronto de maior conjunto de
+//   trabalho (o que mais alivia a memória), mas sempre deixa outro processo que
+//   possa continuar sem depender de um suspenso. Depois tenta retomar os suspensos.
+//   Os que estão executando em outro núcleo não são suspensos.
+static void so_controla_carga(so_t *self)
+{
+    if (JANELA_CONJUNTO_TRABALHO == 0) {
+        return;
+    }
+    // só tem o que aliviar se tem processo esperando página
+    for (int demanda = so_demanda_memoria(self);
+         demanda > so_quadros_usuario(self) && !fila_processos_vazia(self->fila_espera_pagina);
+         demanda = so_demanda_memoria(self)) {
+        processo_t *escolhido = NULL;
+        for (int i = 0; i < self->n_processos; i++) {
+            processo_t *processo = self->tabela_processos[i];
+            if (processo_get_estado(processo) == PRONTO && !so_em_outro_nucleo(self, processo) &&
+                (escolhido == NULL ||
+                 processo_get_conjunto_trabalho(processo) > processo_get_conjunto_trabalho(escolhido))) {
+                escolhido = processo;
+            }
+        }
+        if (escolhido == NULL || so_n_progridem(self) < 2) {
+            break;
+        }
+        so_suspende_processo(self, escolhido, demanda);
+        if (self->erro_interno) {
+            return;
+        }
+    }
+    so_retoma_suspensos(self);
 }
 
-static void trata_pendencia_espera_morte(so_t *self, processo_t *processo)
+// Atende, na ordem de chegada, os processos esperando para ler do terminal 't',
+//   enquanto o teclado tiver dado
+static void trata_pendencia_leitura(so_t *self, int t)
 {
-    pid_t pid_esperado = processo_get_reg_X(processo);
-    processo_t *proc_esperado = processo_busca_por_pid(self->tabela_processos, self->n_processos, pid_esperado);
+    fila_processos_t *fila = self->fila_espera_leitura[t];
+    while (!fila_processos_vazia(fila)) {
+        processo_t *processo = fila_processos_primeiro(fila);
+        int terminal_proc = processo_get_terminal(processo);
+
+        int estado;
+        int terminal_teclado_ok = processo_calcula_terminal(D_TERM_A_TECLADO_OK, terminal_proc);
+        if (es_le(self->es, terminal_teclado_ok, &estado) != ERR_OK) {
+            console_printf("SO: problema no acesso ao estado do teclado");
+            self->erro_interno = true;
+            return;
+        }
+
+        // Se o teclado ainda estiver ocupado retorna
+        if (estado == 0) {
+            return;
+        }
+        console_printf("SO: terminal %d desbloqueado para leitura", terminal_proc);
+
+        int dado;
+        int terminal_leitura = processo_calcula_terminal(D_TERM_A_TECLADO, terminal_proc);
+        if (es_le(self->es, terminal_leitura, &dado) != ERR_OK) {
+            console_printf("SO: problema no acesso ao teclado");
+            self->erro_interno = true;
+            return;
+        }
 
-    if (processo_get_estado(proc_esperado) == MORTO) {
-        console_printf("SO: processo esperado %d morreu", pid_esperado);
+        processo_set_reg_A(processo, dado);
         so_processa_desbloqueio_proc(self, processo, true);
     }
 }
 
-static void trata_pendencia_pagina(so_t *self, processo_t *processo)
+// Atende, na ordem de chegada, os processos esperando para escrever no terminal 't',
+//   enquanto a tela estiver livre
+static void trata_pendencia_escrita(so_t *self, int t)
 {
-    int tempo_desbloqueio = processo_get_tempo_desbloqueio(processo);
-    int tempo_sistema = tempo_atual_sistema(self);
+    fila_processos_t *fila = self->fila_espera_escrita[t];
+    while (!fila_processos_vazia(fila)) {
+        processo_t *processo = fila_processos_primeiro(fila);
+        int terminal = processo_get_terminal(processo);
+
+        int estado;
+        int terminal_tela_ok = processo_calcula_terminal(D_TERM_A_TELA_OK, terminal);
+        if (es_le(self->es, terminal_tela_ok, &estado) != ERR_OK) {
+            console_printf("SO: problema no acesso ao estado da tela");
+            self->erro_interno = true;
+            return;
+        }
+
+        // Se o dispositivo não estiver disponivel retorna
+        if (estado == 0) {
+            return;
+        }
+        console_printf("SO: terminal %d desbloqueado para escrita", terminal);
 
-    console_printf("SO: tempo proc: %d, tempo sistema: %d", tempo_desbloqueio, tempo_sistema);
+        int dado = processo_get_reg_X(processo);
+        int terminal_tela = processo_calcula_terminal(D_TERM_A_TELA, terminal);
+        if (es_escreve(self->es, terminal_tela, dado) != ERR_OK) {
+            console_printf("SO: problema no acesso à tela");
+            self->erro_interno = true;
+            return;
+        }
 
-    if (tempo_sistema >= tempo_desbloqueio) {
-        so_processa_desbloqueio_proc(self, processo, true);
         processo_set_reg_A(processo, 0);
+        so_processa_desbloqueio_proc(self, processo, true);
     }
 }
 
 static void so_trata_pendencias(so_t *self)
 {
-    for (int i = 0; i < self->n_processos; i++) {
-        processo_t *processo = self->tabela_processos[i];
+    // Só são examinados os processos cuja espera pode ter terminado: os primeiros de
+    //   cada terminal. Os que esperam outro processo são desbloqueados quando ele
+    //   morre (so_processa_morte_proc), e os que esperam página quando o disco
+    //   termina a leitura (so_trata_irq_disco)
+    for (int t = 0; t < NUM_TERMINAIS; t++) {
+        trata_pendencia_escrita(self, t);
+        trata_pendencia_leitura(self, t);
+    }
+}
 
-        if (processo_get_estado(processo) == BLOQUEADO) {
-            motivo_bloqueio_t motivo = processo_get_motivo_bloqueio(processo);
-
-            switch (motivo) {
-            case ESPERANDO_ESCRITA:
-                // Verifica se o terminal está disponível para escrita
-                trata_pendencia_escrita(self, processo);
-                break;
-            case ESPERANDO_LEITURA:
-                // Verifica se o terminal está disponível para leitura
-                trata_pendencia_leitura(self, processo);
-                break;
-            case ESPERANDO_PROCESSO:
-                // Verifica se o processo esperado já morreu
-                trata_pendencia_espera_morte(self, processo);
-                break;
-            case ESPERANDO_PAGINA:
-                // Verifica se a memória secundária está disponível
-                trata_pendencia_pagina(self, processo);
-                break;
-            case SEM_BLOQUEIO:
-                break;
-            default:
-                console_printf("SO: motivo de bloqueio desconhecido");
-                self->erro_interno = true;
+// Roubo de trabalho: o núcleo sem processo pronto pega um da fila do núcleo que
+//   tem mais processos esperando (os que não estão executando); pega o último,
+//   o que ainda ia esperar mais lá
+static void so_pega_processo_de_outro_nucleo(so_t *self)
+{
+    nucleo_t *escolhido = NULL;
+    processo_t *processo_escolhido = NULL;
+    int max_esperando = 0;
+    for (int i = 0; i < self->n_nucleos; i++) {
+        nucleo_t *nucleo = &self->nucleos[i];
+        if (nucleo == self->nucleo) {
+            continue;
+        }
+        int esperando = 0;
+        processo_t *ultimo = NULL;
+        for (processo_t *processo = fila_processos_primeiro(nucleo->fila_prontos); processo != NULL;
+             processo = processo_get_prox(processo)) {
+            if (processo != nucleo->processo_corrente) {
+                esperando++;
+                ultimo = processo;
             }
         }
+        if (esperando > max_esperando) {
+            max_esperando = esperando;
+            escolhido = nucleo;
+            processo_escolhido = ultimo;
+        }
+    }
+    if (escolhido == NULL) {
+        return;
     }
+    console_printf("SO: núcleo %d pegou o processo %d do núcleo %d", self->nucleo->id,
+                   processo_get_pid(processo_escolhido), escolhido->id);
+    fila_processos_deleta_processo(escolhido->fila_prontos, processo_escolhido);
+    fila_processos_insere(self->nucleo->fila_prontos, processo_escolhido);
+    self->metricas->processos_pegos++;
 }
 
 static void so_escolhe_e_executa_escalonador(so_t *self, escalonador_t escalonador)
 {
+    // o processo corrente, se ainda está pronto, está na fila do núcleo
+    if (fila_processos_vazia(self->nucleo->fila_prontos)) {
+        so_pega_processo_de_outro_nucleo(self);
+    }
+
     switch (escalonador) {
     case SIMPLES:
         so_escalona_simples(self);
@@ -799,22 +2194,22 @@ static void so_escolhe_e_executa_escalonador(so_t *self, escalonador_t escalonad
 static void so_escalona_simples(so_t *self)
 {
     // Verifica se o processo corrente pode continuar executando
-    if (self->processo_corrente != NULL && processo_get_estado(self->processo_corrente) == PRONTO) {
+    if (self->nucleo->processo_corrente != NULL && processo_get_estado(self->nucleo->processo_corrente) == PRONTO) {
         // Continua com o processo corrente;
         return;
     }
 
     // Busca o proximo processo pronto e define como processo corrente
-    processo_t *proximo = processo_busca_primeiro_em_estado(self->tabela_processos, self->n_processos, PRONTO);
+    processo_t *proximo = fila_processos_primeiro(self->nucleo->fila_prontos);
     if (proximo != NULL) {
-        self->processo_corrente = proximo;
+        self->nucleo->processo_corrente = proximo;
         /* debug_tabela_processos(self->tabela_processos, self->limite_processos); */
         return;
     }
 
     // Se não houver processos prontos, verifica se há processos bloqueados
-    if (processo_busca_primeiro_em_estado(self->tabela_processos, self->n_processos, BLOQUEADO) != NULL) {
-        self->processo_corrente = NULL;
+    if (self->n_processos_bloqueados > 0) {
+        self->nucleo->processo_corrente = NULL;
         /* debug_tabela_processos(self->tabela_processos, self->limite_processos); */
         return;
     }
@@ -825,78 +2220,74 @@ static void so_escalona_simples(so_t *self)
 
 static void so_escalona_round_robin(so_t *self)
 {
-    processo_t *processo_corrente = self->processo_corrente;
+    processo_t *processo_corrente = self->nucleo->processo_corrente;
     // Verifica se o processo corrente pode continuar executando e se ainda possui quantum
-    if (processo_corrente != NULL && processo_get_estado(processo_corrente) == PRONTO && self->quantum > 0) {
+    if (processo_corrente != NULL && processo_get_estado(processo_corrente) == PRONTO && self->nucleo->quantum > 0) {
         // Continua com o processo corrente;
         return;
     }
 
     // Se o processo atual ainda não terminou e não possui mais quantum
-    if (processo_corrente != NULL && processo_get_estado(processo_corrente) == PRONTO && self->quantum == 0) {
+    if (processo_corrente != NULL && processo_get_estado(processo_corrente) == PRONTO && self->nucleo->quantum == 0) {
         // Remove o processo da fila antes de reinserir para evitar duplicatas
-        fila_processos_deleta_processo(self->fila_prontos, processo_corrente);
-        fila_processos_insere(self->fila_prontos, processo_corrente);
+        fila_processos_deleta_processo(self->nucleo->fila_prontos, processo_corrente);
+        fila_processos_insere(self->nucleo->fila_prontos, processo_corrente);
 
         // Buscas na fila resultam em preempcoes
         incrementa_preempcoes_processo(processo_corrente);
-        /* debug_fila_processos(self->fila_prontos); */
+        /* debug_fila_processos(self->nucleo->fila_prontos); */
     }
 
     // Busca o proximo processo pronto e define como processo corrente
-    if (!fila_processos_vazia(self->fila_prontos)) {
+    if (!fila_processos_vazia(self->nucleo->fila_prontos)) {
         // Obtem o primeiro processo pronto da fila de prontos e define como processo corrente
-        self->processo_corrente = fila_processos_primeiro(self->fila_prontos);
-        self->quantum = QUANTUM_INICIAL;
-        /* debug_fila_processos(self->fila_prontos); */
+        self->nucleo->processo_corrente = fila_processos_primeiro(self->nucleo->fila_prontos);
+        self->nucleo->quantum = QUANTUM_INICIAL;
+        /* debug_fila_processos(self->nucleo->fila_prontos); */
         return;
     }
 
     // Nenhum processo para executar encontrado
-    self->processo_corrente = NULL;
+    self->nucleo->processo_corrente = NULL;
 }
 
 static void so_escalona_prioridade(so_t *self)
 {
-    processo_t *processo_corrente = self->processo_corrente;
+    processo_t *processo_corrente = self->nucleo->processo_corrente;
     // Verifica se o processo corrente pode continuar executando e se ainda possui quantum
-    if (processo_corrente != NULL && processo_get_estado(processo_corrente) == PRONTO && self->quantum > 0) {
+    if (processo_corrente != NULL && processo_get_estado(processo_corrente) == PRONTO && self->nucleo->quantum > 0) {
         // Continua com o processo corrente;
         console_printf("SO: processo %d continua executando", processo_get_pid(processo_corrente));
         return;
     }
 
     // Se o processo atual ainda não terminou e não possui mais quantum
-    if (processo_corrente != NULL && processo_get_estado(processo_corrente) == PRONTO && self->quantum == 0) {
-        // Atualiza a prioridade do processo corrente quando seu quantum termina
-        processo_atualiza_prioridade(self->processo_corrente, self->quantum);
-
-        // Remove o processo da fila antes de reinserir para evitar duplicatas
-        fila_processos_deleta_processo(self->fila_prontos, processo_corrente);
-        fila_processos_insere(self->fila_prontos, processo_corrente);
+    if (processo_corrente != NULL && processo_get_estado(processo_corrente) == PRONTO && self->nucleo->quantum == 0) {
+        // Atualiza a prioridade do processo corrente quando seu quantum termina,
+        //   e reposiciona ele na fila de prontos conforme a nova prioridade
+        processo_atualiza_prioridade(self->nucleo->processo_corrente, self->nucleo->quantum);
+        fila_processos_atualiza_prioridade(self->nucleo->fila_prontos, processo_corrente);
 
         // Buscas na fila resultam em preempcoes
         incrementa_preempcoes_processo(processo_corrente);
 
         console_printf("SO: preempção no processo %d", processo_get_pid(processo_corrente));
-        /* debug_fila_processos(self->fila_prontos); */
+        /* debug_fila_processos(self->nucleo->fila_prontos); */
     }
 
     // Busca o proximo processo pronto e define como processo corrente
-    if (!fila_processos_vazia(self->fila_prontos)) {
-        fila_processos_ordena_prioridade(self->fila_prontos);
-
+    if (!fila_processos_vazia(self->nucleo->fila_prontos)) {
         console_printf("SO: escalonando por prioridade");
-        /* debug_fila_processos(self->fila_prontos); */
+        /* debug_fila_processos(self->nucleo->fila_prontos); */
 
         //  Obtem o primeiro processo pronto da fila de prontos e define como processo corrente
-        self->processo_corrente = fila_processos_primeiro(self->fila_prontos);
-        self->quantum = QUANTUM_INICIAL;
+        self->nucleo->processo_corrente = fila_processos_primeiro(self->nucleo->fila_prontos);
+        self->nucleo->quantum = QUANTUM_INICIAL;
         return;
     }
 
     // Nenhum processo para executar encontrado
-    self->processo_corrente = NULL;
+    self->nucleo->processo_corrente = NULL;
 }
 
 static int so_despacha(so_t *self)
@@ -904,8 +2295,8 @@ static int so_despacha(so_t *self)
     // t1: se houver processo corrente, coloca o estado desse processo onde ele
     //   será recuperado pela CPU (em IRQ_END_*) e retorna 0, senão retorna 1
     // o valor retornado será o valor de retorno de CHAMAC
-    processo_t *processo_corrente = self->processo_corrente;
-    if (self->erro_interno || processo_corrente == NULL)
+    processo_t *processo_corrente = self->nucleo->processo_corrente;
+    if (self->erro_interno || self->encerrado || processo_corrente == NULL)
         return 1;
 
     // Obtem o estado do processo corrente
@@ -916,15 +2307,17 @@ static int so_despacha(so_t *self)
     complemento = processo_get_complemento(processo_corrente);
     tabpag_t *tabpag = processo_get_tabpag(processo_corrente);
 
-    // Atualiza os registradores do processador
-    mem_escreve(self->mem, IRQ_END_A, a);
-    mem_escreve(self->mem, IRQ_END_X, x);
-    mem_escreve(self->mem, IRQ_END_PC, pc);
-    mem_escreve(self->mem, IRQ_END_complemento, complemento);
-    mem_escreve(self->mem, IRQ_END_erro, ERR_OK);
+    // Atualiza os registradores do processador, na área do núcleo
+    int area = self->nucleo->end_irq;
+    mem_escreve(self->mem, area + IRQ_END_A, a);
+    mem_escreve(self->mem, area + IRQ_END_X, x);
+    mem_escreve(self->mem, area + IRQ_END_PC, pc);
+    mem_escreve(self->mem, area + IRQ_END_complemento, complemento);
+    mem_escreve(self->mem, area + IRQ_END_erro, ERR_OK);
 
     // Atualiza a tabela de páginas do processo corrente
-    mmu_define_tabpag(self->mmu, tabpag);
+    // o pid identifica o espaço de endereçamento na TLB, que não precisa ser esvaziada
+    mmu_define_tabpag_asid(self->nucleo->mmu, tabpag, processo_get_pid(processo_corrente));
 
     return 0;
 }
@@ -936,6 +2329,7 @@ static void so_trata_irq_reset(so_t *self);
 static void so_trata_irq_chamada_sistema(so_t *self);
 static void so_trata_irq_err_cpu(so_t *self);
 static void so_trata_irq_relogio(so_t *self);
+static void so_trata_irq_disco(so_t *self);
 static void so_trata_irq_desconhecida(so_t *self, int irq);
 
 static void so_trata_irq(so_t *self, int irq)
@@ -954,14 +2348,25 @@ static void so_trata_irq(so_t *self, int irq)
     case IRQ_RELOGIO:
         so_trata_irq_relogio(self);
         break;
+    case IRQ_DISCO:
+        so_trata_irq_disco(self);
+        break;
+    case IRQ_NUCLEO:
+        // o núcleo só tem que escolher outro processo
+        break;
     default:
         so_trata_irq_desconhecida(self, irq);
     }
 }
 
 // interrupção gerada uma única vez, quando a CPU inicializa
+// nos outros núcleos, que são inicializados junto com o primeiro, não tem o que
+//   fazer: eles vão executar os processos criados a partir do inicial
 static void so_trata_irq_reset(so_t *self)
 {
+    if (self->nucleo->id != 0) {
+        return;
+    }
     // t2: deveria criar um processo, e programar a tabela de páginas dele
     processo_t *init_processo = so_adiciona_novo_processo(self, "init.maq");
     if (init_processo == NULL) {
@@ -971,9 +2376,10 @@ static void so_trata_irq_reset(so_t *self)
     }
 
     console_printf("SO: processo inicial criado");
+    self->nucleo->processo_corrente = init_processo;
 
     // altera o PC para o endereço de carga (deve ter sido o endereço virtual 0)
-    mem_escreve(self->mem, IRQ_END_PC, processo_get_pc(self->processo_corrente));
+    mem_escreve(self->mem, self->nucleo->end_irq + IRQ_END_PC, processo_get_pc(self->nucleo->processo_corrente));
 
     // passa o processador para modo usuário
     /* mem_escreve(self->mem, IRQ_END_modo, usuario); */
@@ -983,12 +2389,16 @@ static void so_trata_irq_reset(so_t *self)
 static void so_trata_irq_err_cpu(so_t *self)
 {
 
-    int err_int = processo_get_erro(self->processo_corrente);
+    int err_int = processo_get_erro(self->nucleo->processo_corrente);
     if (err_int == ERR_PAG_AUSENTE) {
         console_printf("SO: PÁGINA AUSENTE");
         so_trata_falha_pagina(self);
         return;
     }
+    if (err_int == ERR_PAG_PROTEGIDA) {
+        so_trata_escrita_protegida(self);
+        return;
+    }
 
     // Endereço traduzido pela mmu não foi reconhecido pela memoria
     if (err_int == ERR_INSTR_INV) {
@@ -1002,8 +2412,26 @@ static void so_trata_irq_err_cpu(so_t *self)
 }
 
 // Interrupção gerada quando o timer expira
+// Todos os núcleos são interrompidos pela mesma expiração; cada um conta o seu
+//   quantum, mas só o primeiro a atender (que encontra o sinalizador ligado)
+//   rearma o timer e faz o que é do sistema todo
 static void so_trata_irq_relogio(so_t *self)
 {
+    if (self->nucleo->quantum > 0) {
+        self->nucleo->quantum--;
+        console_printf("SO: decrementando quantum para %d", self->nucleo->quantum);
+    }
+
+    int pendente;
+    if (es_le(self->es, D_RELOGIO_INTERRUPCAO, &pendente) != ERR_OK) {
+        console_printf("SO: problema na leitura do relógio");
+        self->erro_interno = true;
+        return;
+    }
+    if (pendente == 0) {
+        return;
+    }
+
     // Rearma o interruptor do relógio e reinicializa o timer para a próxima interrupção
     err_t e1, e2;
     e1 = es_escreve(self->es, D_RELOGIO_INTERRUPCAO,
@@ -1014,9 +2442,30 @@ static void so_trata_irq_relogio(so_t *self)
         self->erro_interno = true;
     }
 
-    if (self->quantum > 0) {
-        self->quantum--;
-        console_printf("SO: decrementando quantum para %d", self->quantum);
+    if (JANELA_CONJUNTO_TRABALHO > 0) {
+        so_atualiza_conjuntos_trabalho(self);
+    }
+    atualiza_algoritmo_substituicao(self);
+    so_confere_prebuscadas(self, 0);
+    so_controla_carga(self);
+    so_escreve_metricas_periodicas(self);
+}
+
+// O disco terminou uma ou mais leituras de página; a interrupção fica pedida
+//   enquanto tiver leitura concluída na lista do disco
+static void so_trata_irq_disco(so_t *self)
+{
+    int quadro;
+    for (;;) {
+        if (es_le(self->es, D_DISCO_CONCLUIDA, &quadro) != ERR_OK) {
+            console_printf("SO: problema no acesso ao disco");
+            self->erro_interno = true;
+            return;
+        }
+        if (quadro == -1) {
+            return;
+        }
+        so_conclui_carga_pagina(self, quadro);
     }
 }
 
@@ -1039,7 +2488,7 @@ static void so_chamada_espera_proc(so_t *self);
 static void so_trata_irq_chamada_sistema(so_t *self)
 {
     int id_chamada;
-    if (mem_le(self->mem, IRQ_END_A, &id_chamada) != ERR_OK) {
+    if (mem_le(self->mem, self->nucleo->end_irq + IRQ_END_A, &id_chamada) != ERR_OK) {
         console_printf("SO: erro no acesso ao id da chamada de sistema");
         self->erro_interno = true;
         return;
@@ -1063,7 +2512,7 @@ static void so_trata_irq_chamada_sistema(so_t *self)
         break;
     default:
         console_printf("SO: chamada de sistema desconhecida (%d)", id_chamada);
-        so_processa_morte_proc(self, self->processo_corrente);
+        so_processa_morte_proc(self, self->nucleo->processo_corrente);
         self->erro_interno = true;
     }
 }
@@ -1072,7 +2521,7 @@ static void so_trata_irq_chamada_sistema(so_t *self)
 // coloca o dado no reg A
 static void so_chamada_le(so_t *self)
 {
-    processo_t *processo = self->processo_corrente;
+    processo_t *processo = self->nucleo->processo_corrente;
     int terminal = processo_get_terminal(processo);
 
     int estado;
@@ -1106,8 +2555,8 @@ static void so_chamada_le(so_t *self)
 // escreve o valor do reg X na saída corrente do processo
 static void so_chamada_escr(so_t *self)
 {
-    int terminal = processo_get_terminal(self->processo_corrente);
-    processo_t *processo = self->processo_corrente;
+    int terminal = processo_get_terminal(self->nucleo->processo_corrente);
+    processo_t *processo = self->nucleo->processo_corrente;
 
     int estado;
     int terminal_tela_ok = processo_calcula_terminal(D_TERM_A_TELA_OK, terminal);
@@ -1137,7 +2586,7 @@ static void so_chamada_escr(so_t *self)
 
 static void so_chamada_cria_proc(so_t *self)
 {
-    processo_t *processo_corrente = self->processo_corrente;
+    processo_t *processo_corrente = self->nucleo->processo_corrente;
     if (processo_corrente == NULL)
         return;
 
@@ -1166,7 +2615,7 @@ static void so_chamada_cria_proc(so_t *self)
 static void so_chamada_mata_proc(so_t *self)
 {
     // PID do processo a ser morto está no registrador X do precesso corrente
-    processo_t *processo_corrente = self->processo_corrente;
+    processo_t *processo_corrente = self->nucleo->processo_corrente;
     if (processo_corrente == NULL)
         return;
 
@@ -1177,7 +2626,7 @@ static void so_chamada_mata_proc(so_t *self)
     if (pid_alvo == 0) {
         so_processa_morte_proc(self, processo_corrente);
         processo_set_reg_A(processo_corrente, 0);
-        self->processo_corrente = NULL;
+        self->nucleo->processo_corrente = NULL;
         return;
     }
 
@@ -1195,7 +2644,7 @@ static void so_chamada_mata_proc(so_t *self)
 // implementação da chamada se sistema SO_ESPERA_PROC espera o fim do processo com pid X
 static void so_chamada_espera_proc(so_t *self)
 {
-    processo_t *processo_corrente = self->processo_corrente;
+    processo_t *processo_corrente = self->nucleo->processo_corrente;
     if (processo_corrente == NULL)
         return;
     int pid_alvo = processo_get_reg_X(processo_corrente);
@@ -1209,6 +2658,11 @@ static void so_chamada_espera_proc(so_t *self)
 
     // Se o processo alvo não estiver morto, bloqueia o processo corrente
     processo_t *processo_alvo = processo_busca_por_pid(self->tabela_processos, self->n_processos, pid_alvo);
+    if (processo_alvo == NULL) {
+        console_printf("SO: processo %d não encontrado", pid_alvo);
+        processo_set_reg_A(processo_corrente, -1);
+        return;
+    }
     if (processo_get_estado(processo_alvo) != MORTO) {
         so_processa_bloqueio_proc(self, processo_corrente, ESPERANDO_PROCESSO);
         return;
@@ -1223,7 +2677,8 @@ static void so_chamada_espera_proc(so_t *self)
 
 // funções auxiliares
 static int so_carrega_programa_na_memoria_fisica(so_t *self, programa_t *programa);
-static int so_carrega_programa_na_memoria_virtual(so_t *self, programa_t *programa, processo_t *processo);
+static int so_carrega_programa_na_memoria_virtual(so_t *self, programa_t *programa, char *nome);
+static int so_usa_imagem(so_t *self, processo_t *processo, int imagem);
 
 // carrega o programa na memória de um processo ou na memória física se NENHUM_PROCESSO
 // retorna o endereço de carga ou -1
@@ -1231,6 +2686,15 @@ static int so_carrega_programa(so_t *self, processo_t *processo, char *nome_do_e
 {
     console_printf("SO: carga de '%s'", nome_do_executavel);
 
+    // Se outro processo já executa o programa, a imagem dele é compartilhada
+    if (processo != NENHUM_PROCESSO) {
+        int imagem = imagens_busca(self->imagens, nome_do_executavel);
+        if (imagem != -1) {
+            console_printf("SO: programa '%s' compartilhado com a imagem %d", nome_do_executavel, imagem);
+            return so_usa_imagem(self, processo, imagem);
+        }
+    }
+
     programa_t *programa = prog_cria(nome_do_executavel);
     if (programa == NULL) {
         console_printf("Erro na leitura do programa '%s'\n", nome_do_executavel);
@@ -1243,9 +2707,12 @@ static int so_carrega_programa(so_t *self, processo_t *processo, char *nome_do_e
         end_carga = so_carrega_programa_na_memoria_fisica(self, programa);
     } else {
         console_printf("\nSO: carregando programa na memória virtual");
-        end_carga = so_carrega_programa_na_memoria_virtual(self, programa, processo);
-        processo_set_end_mem_sec(processo, end_carga);
-        end_carga = 0;
+        int imagem = so_carrega_programa_na_memoria_virtual(self, programa, nome_do_executavel);
+        end_carga = imagem < 0 ? -1 : so_usa_imagem(self, processo, imagem);
+        if (end_carga < 0) {
+            prog_destroi(programa);
+            return -1;
+        }
     }
 
     console_printf("SO: programa '%s' carregado em %d", nome_do_executavel, end_carga);
@@ -1271,7 +2738,8 @@ static int so_carrega_programa_na_memoria_fisica(so_t *self, programa_t *program
     return end_ini;
 }
 
-static int so_carrega_programa_na_memoria_virtual(so_t *self, programa_t *programa, processo_t *processo)
+// carrega o programa numa imagem nova na memória secundária; retorna a imagem ou -1
+static int so_carrega_programa_na_memoria_virtual(so_t *self, programa_t *programa, char *nome)
 {
     // meu: carregará programa na memória secundária
 
@@ -1281,30 +2749,97 @@ static int so_carrega_programa_na_memoria_virtual(so_t *self, programa_t *progra
     // com memória virtual, a forma mais simples de implementar a carga de um
     //   programa é carregá-lo para a memória secundária, e mapear todas as páginas
     //   da tabela de páginas do processo como inválidas. Assim, as páginas serão
-    //   colocadas na memória principal por demanda. Para simplificar ainda mais, a
-    //   memória secundária pode ser alocada da forma como a principal está sendo
-    //   alocada aqui (sem reuso)
-
-    // carrega o programa na memória secundária
-    int end_disk_ini = self->prox_endereco_mem_sec;
-    int end_disk = end_disk_ini;
+    //   colocadas na memória principal por demanda.
+    // O espaço na memória secundária é alocado em páginas inteiras, e é devolvido
+    //   quando morre o último processo que executa a imagem. A imagem nunca é
+    //   alterada: as páginas em que um processo escreve voltam para a extensão
+    //   dele (so_usa_imagem)
 
     int end_virt_ini = 0;
     int end_virt_fim = end_virt_ini + prog_tamanho(programa) - 1;
 
-    self->prox_endereco_mem_sec = end_disk_ini + end_virt_fim + 1;
+    // reserva o espaço e carrega o programa na memória secundária
+    int n_paginas = PAGINA_DO_END(end_virt_fim) + 1;
+    int pagina_ini = gere_mem_sec_aloca(self->gere_mem_sec, n_paginas);
+    if (pagina_ini < 0) {
+        console_printf("SO: memória secundária sem espaço para %d páginas", n_paginas);
+        return -1;
+    }
+    int end_disk_ini = END_DA_PAGINA(pagina_ini);
+    int end_disk = end_disk_ini;
 
     for (int end_virt = end_virt_ini; end_virt <= end_virt_fim; end_virt++) {
         if (mem_escreve(self->memoria_secundaria, end_disk, prog_dado(programa, end_virt)) != ERR_OK) {
             console_printf("Erro na carga da memória, end virt %d fís %d\n", end_virt, end_disk);
+            gere_mem_sec_libera(self->gere_mem_sec, pagina_ini, n_paginas);
             return -1;
         }
         end_disk++;
     }
+    int imagem = imagens_insere(self->imagens, nome, pagina_ini, n_paginas);
+    if (imagem < 0) {
+        gere_mem_sec_libera(self->gere_mem_sec, pagina_ini, n_paginas);
+        return -1;
+    }
     console_printf("SO: carregado na memória secundária virt:%d a %d, sec: %d a %d", end_virt_ini, end_virt_fim,
                    end_disk_ini, end_disk - 1);
 
-    return end_disk_ini;
+    return imagem;
+}
+
+// Faz o processo executar a imagem, reservando na memória secundária a extensão
+//   para as cópias privadas das páginas em que ele escrever; retorna o endereço
+//   de carga (0) ou -1. Uma imagem nova que não fica com nenhum usuário é descartada.
+static int so_usa_imagem(so_t *self, processo_t *processo, int indice)
+{
+    imagem_t *imagem = &self->imagens->imagens[indice];
+    int pagina_ini = gere_mem_sec_aloca(self->gere_mem_sec, imagem->n_paginas);
+    if (pagina_ini >= 0 && !processo_define_imagem(processo, indice, imagem->n_paginas)) {
+        gere_mem_sec_libera(self->gere_mem_sec, pagina_ini, imagem->n_paginas);
+        pagina_ini = -1;
+    }
+    if (pagina_ini < 0) {
+        console_printf("SO: memória secundária sem espaço para %d páginas", imagem->n_paginas);
+        if (imagem->n_usuarios == 0) {
+            gere_mem_sec_libera(self->gere_mem_sec, imagem->pagina_mem_sec, imagem->n_paginas);
+            imagens_descarta(self->imagens, indice);
+        }
+        return -1;
+    }
+
+    imagem->n_usuarios++;
+    processo_set_end_mem_sec(processo, END_DA_PAGINA(pagina_ini));
+    processo_set_paginas_mem_sec(processo, imagem->n_paginas);
+    return 0;
+}
+
+// O processo (que morreu) deixa de usar a sua imagem e de mapear as páginas dela;
+//   quando sai o último, os quadros com páginas da imagem e a memória secundária são liberados (os que
+//   ainda estão sendo lidos são liberados no fim da leitura)
+static void so_larga_imagem(so_t *self, processo_t *processo)
+{
+    int indice = processo_get_imagem(processo);
+    imagem_t *imagem = &self->imagens->imagens[indice];
+    if (--imagem->n_usuarios > 0) {
+        for (int pagina = 0; pagina < imagem->n_paginas; pagina++) {
+            imagens_remove_mapeador(self->imagens, indice, pagina, processo_get_pid(processo));
+        }
+        return;
+    }
+    for (int pagina = 0; pagina < imagem->n_paginas; pagina++) {
+        int quadro = imagem->quadros[pagina];
+        if (quadro == -1 || gere_blocos_reservado(self->gere_blocos, quadro)) {
+            continue;
+        }
+        bloco_t *bloco = &self->gere_blocos->blocos[quadro];
+        if (bloco->prebuscada) {
+            so_registra_uso_prebusca(self, bloco, false);
+        }
+        gere_blocos_libera_bloco(self->gere_blocos, quadro);
+    }
+    console_printf("SO: imagem %d descartada", indice);
+    gere_mem_sec_libera(self->gere_mem_sec, imagem->pagina_mem_sec, imagem->n_paginas);
+    imagens_descarta(self->imagens, indice);
 }
 
 // ACESSO À MEMÓRIA DOS PROCESSOS {{{1
@@ -1322,11 +2857,17 @@ static bool so_copia_str_do_processo(so_t *self, int tam, char str[tam], int end
 
     for (int indice_str = 0; indice_str < tam; indice_str++) {
         int caractere;
-        if (mmu_le(self->mmu, end_virt + indice_str, &caractere, usuario) != ERR_OK) {
+        if (mmu_le(self->nucleo->mmu, end_virt + indice_str, &caractere, usuario) != ERR_OK) {
             console_printf("Erro ao ler o endereço virtual %d do processo %d\n", end_virt + indice_str,
                            processo_get_pid(processo));
-            mem_le(self->memoria_secundaria, processo_get_end_mem_sec(self->processo_corrente) + end_virt + indice_str,
-                   &caractere);
+            int end = end_virt + indice_str;
+            int pagina = PAGINA_DO_END(end);
+            if (end < 0 || pagina >= processo_get_paginas_mem_sec(processo) ||
+                mem_le(self->memoria_secundaria,
+                       END_DA_PAGINA(so_pagina_mem_sec(self, processo, pagina)) + DESLOC_DO_END(end),
+                       &caractere) != ERR_OK) {
+                return false;
+            }
         }
         if (caractere < 0 || caractere > 255) {
             return false;
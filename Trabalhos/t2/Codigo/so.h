@@ -14,10 +14,55 @@ typedef struct so_t so_t;
 #include "es.h"
 #include "console.h" // só para uma gambiarra
 
-so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu,
+#include <stdbool.h>
+#include <stdio.h>
+
+// 'mem_sec' é a memória secundária, onde o SO coloca as imagens dos processos;
+//   as páginas são transferidas entre ela e 'mem' pelo disco (dispositivos D_DISCO_*)
+so_t *so_cria(cpu_t *cpu, mem_t *mem, mem_t *mem_sec, mmu_t *mmu,
               es_t *es, console_t *console);
 void so_destroi(so_t *self);
 
+// Mais de um núcleo: cada CPU que compartilha a memória com a dada em so_cria
+//   é acrescentada com a sua MMU, antes do início da execução, e salva o estado
+//   na interrupção em IRQ_END_AREA do seu número (1, 2, ..., na ordem em que
+//   foram acrescentados)
+// cada núcleo tem o seu processo em execução e a sua fila de prontos; um
+//   núcleo sem processo pronto pega um da fila de outro
+// retorna false se já tem IRQ_MAX_NUCLEOS núcleos
+bool so_adiciona_nucleo(so_t *self, cpu_t *cpu, mmu_t *mmu);
+
+// Instantâneo (ver instantaneo.h): grava o estado do SO (processos, filas,
+//   tabelas de páginas, quadros, memória secundária e métricas)
+// a restauração é feita num SO recém-criado, depois da restauração do hardware
+//   (a MMU volta a usar a tabela de páginas do processo em uso); as opções
+//   (algoritmo de substituição, intervalo das métricas) podem ser definidas
+//   de novo depois dela
+bool so_salva(so_t *self, FILE *arq);
+bool so_restaura(so_t *self, FILE *arq);
+
+// Algoritmos de substituição de páginas
+typedef enum {
+  FIFO,
+  SEGUNDA_CHANCE,
+  NRU,            // não usada recentemente (classes pelos bits de acesso e alteração)
+  ENVELHECIMENTO, // contador de idade por quadro, atualizado a cada interrupção do relógio
+  N_ALGORITMO_SUBSTITUICAO
+} algoritmo_substituicao_t;
+
+// retorna o algoritmo de substituição com o nome dado ("fifo", "segunda_chance",
+//   "nru", "envelhecimento"), ou N_ALGORITMO_SUBSTITUICAO se não existir
+algoritmo_substituicao_t so_algoritmo_substituicao(char *nome);
+
+// escolhe o algoritmo de substituição de páginas usado pelo SO
+// deve ser chamada antes do início da execução
+void so_define_algoritmo_substituicao(so_t *self, algoritmo_substituicao_t algoritmo);
+
+// faz o SO escrever as métricas de paginação (globais e de cada processo) a
+//   cada 'intervalo' instruções, em "../metricas_periodicas.txt"
+// com 0 (o padrão) elas só saem no relatório final
+void so_define_intervalo_metricas(so_t *self, int intervalo);
+
 // Chamadas de sistema
 // Uma chamada de sistema é realizada colocando a identificação da
 //   chamada (um dos valores abaixo) no registrador A e executando a
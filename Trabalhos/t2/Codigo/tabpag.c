@@ -4,6 +4,7 @@
 // so24b
 
 #include "tabpag.h"
+#include "instantaneo.h"
 #include <stdlib.h>
 #include <assert.h>
 
@@ -17,121 +18,252 @@ typedef struct {
   bool acessada;
   // a página foi alterada ou não
   bool alterada;
+  // a página pode ser lida mas não escrita
+  bool protegida;
 } descritor_t;
 
+// número de descritores em cada folha da tabela
+#define TAM_FOLHA 64
+// número máximo de folhas livres guardadas para reuso
+#define MAX_FOLHAS_LIVRES 64
+
+// folha da tabela, com os descritores de TAM_FOLHA páginas consecutivas
+typedef struct folha_t folha_t;
+struct folha_t {
+  // número de páginas válidas na folha
+  int n_validas;
+  // encadeamento na lista de folhas livres
+  folha_t *prox;
+  descritor_t descritores[TAM_FOLHA];
+};
+
+// tabela em dois níveis: um diretório com ponteiros para folhas, que só
+//   existem se tiverem alguma página válida
+// um espaço de endereçamento esparso ocupa só as folhas que usa, e definir
+//   uma página nunca move os descritores (só o diretório cresce, dobrando)
 struct tabpag_t {
-  // número de descritores na tabela (pode ser 0)
-  int tam_tab;
-  // vetor com os descritores
-  // o último descritor do vetor sempre contém uma página válida
-  // pode ser NULL (se tam_tab == 0)
-  descritor_t *tabela;
+  // número de entradas no diretório (pode ser 0)
+  int tam_dir;
+  // vetor de ponteiros para as folhas, NULL para a folha sem página válida
+  // pode ser NULL (se tam_dir == 0)
+  folha_t **diretorio;
 };
 
+// folhas liberadas pelas tabelas, reusadas por qualquer tabela
+static folha_t *folhas_livres = NULL;
+static int n_folhas_livres = 0;
+
+static folha_t *tabpag__aloca_folha(void)
+{
+  folha_t *folha = folhas_livres;
+  if (folha != NULL) {
+    folhas_livres = folha->prox;
+    n_folhas_livres--;
+  } else {
+    folha = malloc(sizeof(*folha));
+    assert(folha != NULL);
+  }
+  folha->n_validas = 0;
+  for (int i = 0; i < TAM_FOLHA; i++) {
+    folha->descritores[i].valida = false;
+  }
+  return folha;
+}
+
+static void tabpag__libera_folha(folha_t *folha)
+{
+  if (n_folhas_livres >= MAX_FOLHAS_LIVRES) {
+    free(folha);
+    return;
+  }
+  folha->prox = folhas_livres;
+  folhas_livres = folha;
+  n_folhas_livres++;
+}
+
 tabpag_t *tabpag_cria(void)
 {
   tabpag_t *self = malloc(sizeof(*self));
   assert(self != NULL);
-  self->tam_tab = 0;
-  self->tabela = NULL;
+  self->tam_dir = 0;
+  self->diretorio = NULL;
   return self;
 }
 
 void tabpag_destroi(tabpag_t *self)
 {
   if (self != NULL) {
-    if (self->tabela != NULL) free(self->tabela);
+    for (int i = 0; i < self->tam_dir; i++) {
+      if (self->diretorio[i] != NULL) tabpag__libera_folha(self->diretorio[i]);
+    }
+    if (self->diretorio != NULL) free(self->diretorio);
     free(self);
   }
 }
 
-// retorna true se a página for válida (pode ser traduzida em um quadro)
-static bool tabpag__pagina_valida(tabpag_t *self, int pagina)
+// retorna o descritor da página, ou NULL se ela não tiver folha
+static descritor_t *tabpag__descritor(tabpag_t *self, int pagina)
 {
-  if (pagina < 0 || pagina >= self->tam_tab) return false;
-  return self->tabela[pagina].valida;
+  if (pagina < 0) return NULL;
+  int i_dir = pagina / TAM_FOLHA;
+  if (i_dir >= self->tam_dir || self->diretorio[i_dir] == NULL) return NULL;
+  return &self->diretorio[i_dir]->descritores[pagina % TAM_FOLHA];
+}
+
+// retorna o descritor da página se ela for válida (pode ser traduzida em um
+//   quadro), ou NULL
+static descritor_t *tabpag__descritor_valido(tabpag_t *self, int pagina)
+{
+  descritor_t *descritor = tabpag__descritor(self, pagina);
+  if (descritor == NULL || !descritor->valida) return NULL;
+  return descritor;
 }
 
 void tabpag_invalida_pagina(tabpag_t *self, int pagina)
 {
+  descritor_t *descritor = tabpag__descritor_valido(self, pagina);
   // página já é inválida -- não faz nada
-  if (!tabpag__pagina_valida(self, pagina)) return;
-  // página não é a última da tabela -- marca como inválida
-  if (pagina < self->tam_tab - 1) {
-    self->tabela[pagina].valida = false;
-    return;
-  }
-  // última página na tabela -- reduz a tabela até que a última seja válida
-  do {
-    self->tam_tab--;
-  } while (self->tam_tab > 0 && !self->tabela[self->tam_tab - 1].valida);
-  if (self->tam_tab == 0) {
-    free(self->tabela);
-    self->tabela = NULL;
-  } else {
-    self->tabela = realloc(self->tabela, self->tam_tab * sizeof(descritor_t));
-    assert(self->tabela != NULL);
+  if (descritor == NULL) return;
+  descritor->valida = false;
+  // a folha sem nenhuma página válida volta para as livres
+  int i_dir = pagina / TAM_FOLHA;
+  if (--self->diretorio[i_dir]->n_validas == 0) {
+    tabpag__libera_folha(self->diretorio[i_dir]);
+    self->diretorio[i_dir] = NULL;
   }
 }
 
-// aumenta a tabela, se necessário, para que contenha 'pagina'
-static void tabpag__insere_pagina(tabpag_t *self, int pagina)
+// garante que existe a folha que contém 'pagina', aumentando o diretório se
+//   necessário; retorna o descritor da página
+static descritor_t *tabpag__insere_pagina(tabpag_t *self, int pagina)
 {
-  if (pagina < self->tam_tab) return;
-  int novo_tam = pagina + 1;
-  if (self->tam_tab == 0) {
-    self->tabela = malloc(novo_tam * sizeof(descritor_t));
-  } else {
-    self->tabela = realloc(self->tabela, novo_tam * sizeof(descritor_t));
+  int i_dir = pagina / TAM_FOLHA;
+  if (i_dir >= self->tam_dir) {
+    int novo_tam = self->tam_dir == 0 ? 1 : self->tam_dir;
+    while (novo_tam <= i_dir) novo_tam *= 2;
+    self->diretorio = realloc(self->diretorio, novo_tam * sizeof(*self->diretorio));
+    assert(self->diretorio != NULL);
+    while (self->tam_dir < novo_tam) {
+      self->diretorio[self->tam_dir] = NULL;
+      self->tam_dir++;
+    }
   }
-  assert(self->tabela != NULL);
-  // marca as páginas inseridas como não válidas
-  while (self->tam_tab < novo_tam) {
-    self->tabela[self->tam_tab].valida = false;
-    self->tam_tab++;
+  if (self->diretorio[i_dir] == NULL) {
+    self->diretorio[i_dir] = tabpag__aloca_folha();
   }
+  return &self->diretorio[i_dir]->descritores[pagina % TAM_FOLHA];
 }
 
 void tabpag_define_quadro(tabpag_t *self, int pagina, int quadro)
 {
   assert(pagina >= 0);
-  tabpag__insere_pagina(self, pagina);
-  self->tabela[pagina].quadro = quadro;
-  self->tabela[pagina].valida = true;
-  self->tabela[pagina].acessada = false;
-  self->tabela[pagina].alterada = false;
+  descritor_t *descritor = tabpag__insere_pagina(self, pagina);
+  if (!descritor->valida) self->diretorio[pagina / TAM_FOLHA]->n_validas++;
+  descritor->quadro = quadro;
+  descritor->valida = true;
+  descritor->acessada = false;
+  descritor->alterada = false;
+  descritor->protegida = false;
 }
 
 void tabpag_marca_bit_acesso(tabpag_t *self, int pagina, bool alteracao)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return;
-  self->tabela[pagina].acessada = true;
+  descritor_t *descritor = tabpag__descritor_valido(self, pagina);
+  if (descritor == NULL) return;
+  descritor->acessada = true;
   if (alteracao) {
-    self->tabela[pagina].alterada = true;
+    descritor->alterada = true;
   }
 }
 
 void tabpag_zera_bit_acesso(tabpag_t *self, int pagina)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return;
-  self->tabela[pagina].acessada = false;
+  descritor_t *descritor = tabpag__descritor_valido(self, pagina);
+  if (descritor == NULL) return;
+  descritor->acessada = false;
 }
 
 bool tabpag_bit_acesso(tabpag_t *self, int pagina)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return false;
-  return self->tabela[pagina].acessada;
+  descritor_t *descritor = tabpag__descritor_valido(self, pagina);
+  if (descritor == NULL) return false;
+  return descritor->acessada;
 }
 
 bool tabpag_bit_alteracao(tabpag_t *self, int pagina)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return false;
-  return self->tabela[pagina].alterada;
+  descritor_t *descritor = tabpag__descritor_valido(self, pagina);
+  if (descritor == NULL) return false;
+  return descritor->alterada;
+}
+
+void tabpag_protege_pagina(tabpag_t *self, int pagina, bool protegida)
+{
+  descritor_t *descritor = tabpag__descritor_valido(self, pagina);
+  if (descritor == NULL) return;
+  descritor->protegida = protegida;
+}
+
+bool tabpag_pagina_protegida(tabpag_t *self, int pagina)
+{
+  descritor_t *descritor = tabpag__descritor_valido(self, pagina);
+  if (descritor == NULL) return false;
+  return descritor->protegida;
 }
 
 err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return ERR_PAG_AUSENTE;
-  *pquadro = self->tabela[pagina].quadro;
+  descritor_t *descritor = tabpag__descritor_valido(self, pagina);
+  if (descritor == NULL) return ERR_PAG_AUSENTE;
+  *pquadro = descritor->quadro;
   return ERR_OK;
 }
+
+// grava só as páginas válidas, cada uma com o número, o quadro e os bits do
+//   descritor (campo a campo, sem o preenchimento da estrutura)
+bool tabpag_salva(tabpag_t *self, FILE *arq)
+{
+  int n_validas = 0;
+  for (int i = 0; i < self->tam_dir; i++) {
+    if (self->diretorio[i] != NULL) n_validas += self->diretorio[i]->n_validas;
+  }
+  if (!inst_escreve_marca(arq, "TABP") || !inst_escreve_int(arq, n_validas)) {
+    return false;
+  }
+  for (int pagina = 0; pagina < self->tam_dir * TAM_FOLHA; pagina++) {
+    descritor_t *descritor = tabpag__descritor_valido(self, pagina);
+    if (descritor == NULL) continue;
+    if (!inst_escreve_int(arq, pagina)
+        || !inst_escreve_int(arq, descritor->quadro)
+        || !inst_escreve_int(arq, descritor->acessada)
+        || !inst_escreve_int(arq, descritor->alterada)
+        || !inst_escreve_int(arq, descritor->protegida)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool tabpag_restaura(tabpag_t *self, FILE *arq)
+{
+  int n_validas;
+  if (!inst_confere_marca(arq, "TABP") || !inst_le_int(arq, &n_validas)) {
+    return false;
+  }
+  for (int i = 0; i < n_validas; i++) {
+    int pagina, quadro, acessada, alterada, protegida;
+    if (!inst_le_int(arq, &pagina) || pagina < 0
+        || !inst_le_int(arq, &quadro)
+        || !inst_le_int(arq, &acessada)
+        || !inst_le_int(arq, &alterada)
+        || !inst_le_int(arq, &protegida)) {
+      return false;
+    }
+    tabpag_define_quadro(self, pagina, quadro);
+    descritor_t *descritor = tabpag__descritor(self, pagina);
+    descritor->acessada = acessada;
+    descritor->alterada = alterada;
+    descritor->protegida = protegida;
+  }
+  return true;
+}
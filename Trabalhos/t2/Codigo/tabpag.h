@@ -10,10 +10,15 @@
 // realiza a tradução de números de páginas do espaço de endereçamento
 //   de um processo em números de quadros da memória principal onde essas
 //   páginas estão mapeadas
-// mantém para cada página mapeada um bit de acesso e um bit de alteração
+// mantém para cada página mapeada um bit de acesso e um bit de alteração, e
+//   um bit de proteção contra escrita
+// a tabela tem dois níveis, com os descritores em folhas alocadas só quando
+//   alguma página delas é definida, então um espaço de endereçamento esparso
+//   (páginas altas, buracos) ocupa memória só para as regiões usadas
 
 #include "err.h"
 #include <stdbool.h>
+#include <stdio.h>
 
 // tipo opaco que representa a tabela de páginas
 typedef struct tabpag_t tabpag_t;
@@ -30,8 +35,8 @@ tabpag_t *tabpag_cria(void);
 void tabpag_destroi(tabpag_t *self);
 
 // define que a tradução da página 'pagina' deve resultar no quadro 'quadro'
-// essa página é marcada como válida, e os bits de acesso e alteração para essa
-//   página são zerados
+// essa página é marcada como válida, e os bits de acesso, alteração e proteção
+//   para essa página são zerados
 // páginas sem quadro definido são consideradas inválidas
 void tabpag_define_quadro(tabpag_t *self, int pagina, int quadro);
 
@@ -56,9 +61,25 @@ bool tabpag_bit_acesso(tabpag_t *self, int pagina);
 // retorna false se a página for inválida
 bool tabpag_bit_alteracao(tabpag_t *self, int pagina);
 
+// altera o bit de proteção da página; uma escrita numa página protegida
+//   causa ERR_PAG_PROTEGIDA na MMU (a leitura é permitida)
+// não faz nada se a página for inválida
+void tabpag_protege_pagina(tabpag_t *self, int pagina, bool protegida);
+
+// retorna o valor do bit de proteção da página
+// retorna false se a página for inválida
+bool tabpag_pagina_protegida(tabpag_t *self, int pagina);
+
 // traduz a página 'pagina'; coloca o quadro correspondente na posição apontada
 //   por 'pquadro'
 // retorna ERR_PAG_AUSENTE (e não altera '*pquadro') se a página for inválida
 err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro);
 
+// grava no arquivo 'arq' as páginas válidas da tabela, com os seus bits
+//   (ver instantaneo.h)
+bool tabpag_salva(tabpag_t *self, FILE *arq);
+
+// recupera as páginas gravadas por tabpag_salva numa tabela vazia
+bool tabpag_restaura(tabpag_t *self, FILE *arq);
+
 #endif // TABPAG_H
@@ -4,6 +4,7 @@
 // so24b
 
 #include "terminal.h"
+#include "instantaneo.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,8 @@ struct terminal_t {
   enum { normal, rolando, limpando } estado_saida;
   // posicao do caractere que está sendo movido durante uma rolagem
   int pos_rolagem;
+  // se não for NULL, recebe uma cópia de tudo que é impresso
+  FILE *arq_saida;
 };
 
 
@@ -45,9 +48,12 @@ terminal_t *terminal_cria(int tam_linha)
   assert(self->saida != NULL && self->entrada != NULL);
 
   self->tam_linha = tam_linha;
-  strcpy(self->entrada, "");
-  strcpy(self->saida, "");
+  // as linhas são gravadas inteiras nos instantâneos, não só até o '\0'
+  memset(self->entrada, 0, tam_linha + 1);
+  memset(self->saida, 0, tam_linha + 1);
   self->estado_saida = normal;
+  self->pos_rolagem = 0;
+  self->arq_saida = NULL;
 
   return self;
 }
@@ -92,6 +98,7 @@ static bool terminal_pode_imprimir(terminal_t *self)
 static void terminal_imprime(terminal_t *self, char ch)
 {
   if (terminal_pode_imprimir(self)) {
+    if (self->arq_saida != NULL) fputc(ch, self->arq_saida);
     if (ch == '\n') {
       self->estado_saida = limpando;
       return;
@@ -111,6 +118,12 @@ void terminal_limpa_saida(terminal_t *self)
 {
   self->saida[0] = '\0';
   self->estado_saida = normal;
+  self->pos_rolagem = 0;
+}
+
+void terminal_define_arq_saida(terminal_t *self, FILE *arq)
+{
+  self->arq_saida = arq;
 }
 
 static void terminal_atualiza_rolagem(terminal_t *self)
@@ -153,6 +166,15 @@ void terminal_tictac(terminal_t *self)
   }
 }
 
+void terminal_tictac_n(terminal_t *self, int n)
+{
+  // quando a saída está normal, o tempo não altera nada
+  while (n > 0 && self->estado_saida != normal) {
+    terminal_tictac(self);
+    n--;
+  }
+}
+
 char *terminal_txt_entrada(terminal_t *self)
 {
   return self->entrada;
@@ -216,3 +238,28 @@ err_t terminal_escrita(void *disp, int id, int valor)
   }
   return ERR_OK;
 }
+
+bool terminal_salva(terminal_t *self, FILE *arq)
+{
+  return inst_escreve_marca(arq, "TERM")
+         && inst_escreve_int(arq, self->tam_linha)
+         && inst_escreve(arq, self->entrada, self->tam_linha + 1)
+         && inst_escreve(arq, self->saida, self->tam_linha + 1)
+         && inst_escreve_int(arq, self->estado_saida)
+         && inst_escreve_int(arq, self->pos_rolagem);
+}
+
+bool terminal_restaura(terminal_t *self, FILE *arq)
+{
+  int estado_saida;
+  if (!inst_confere_marca(arq, "TERM")
+      || !inst_confere_int(arq, self->tam_linha)
+      || !inst_le(arq, self->entrada, self->tam_linha + 1)
+      || !inst_le(arq, self->saida, self->tam_linha + 1)
+      || !inst_le_int(arq, &estado_saida)
+      || !inst_le_int(arq, &self->pos_rolagem)) {
+    return false;
+  }
+  self->estado_saida = estado_saida;
+  return true;
+}
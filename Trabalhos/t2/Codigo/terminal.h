@@ -32,6 +32,7 @@
 //   linha de saída com terminal_limpa_saida.
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "es.h"
 
 typedef struct terminal_t terminal_t;
@@ -54,9 +55,22 @@ void terminal_insere_char(terminal_t *self, char ch);
 // limpa a linha de saída (para uso pela console)
 void terminal_limpa_saida(terminal_t *self);
 
+// define um arquivo onde será copiado cada caractere impresso no terminal
+//   (para uso pela console quando executa sem tela); NULL desliga a cópia
+void terminal_define_arq_saida(terminal_t *self, FILE *arq);
+
+// grava no arquivo 'arq' as linhas de entrada e saída e o estado da saída
+//   (ver instantaneo.h); o arquivo de cópia da saída não é gravado
+bool terminal_salva(terminal_t *self, FILE *arq);
+// recupera o estado gravado por terminal_salva, num terminal de mesmo tamanho
+bool terminal_restaura(terminal_t *self, FILE *arq);
+
 // esta função deve ser chamada periodicamente
 void terminal_tictac(terminal_t *self);
 
+// equivalente a 'n' chamadas a terminal_tictac
+void terminal_tictac_n(terminal_t *self, int n);
+
 // Funções para implementar o protocolo de acesso a um dispositivo pelo
 //   controlador de E/S
 // Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h